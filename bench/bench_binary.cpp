@@ -0,0 +1,54 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// binary codec benchmarks, same args as json ones to be compared with
+
+#include "benchmark/benchmark.h"
+#include "model_binary.h"
+#include "bench_common.h"
+
+namespace rellaf {
+namespace bench {
+
+// arg : items in list members, nested owner if not 0
+static void BM_model_to_binary(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), state.range(1) != 0);
+    std::string buf;
+    for (auto _ : state) {
+        buf.clear();
+        model_to_binary(&model, buf);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_model_to_binary)->Args({0, 0})->Args({0, 1})->Args({100, 1});
+
+static void BM_binary_to_model(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), state.range(1) != 0);
+    std::string buf;
+    model_to_binary(&model, buf);
+    for (auto _ : state) {
+        BenchModel parsed;
+        benchmark::DoNotOptimize(binary_to_model(buf, &parsed));
+    }
+    state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK(BM_binary_to_model)->Args({0, 0})->Args({0, 1})->Args({100, 1});
+
+}
+}
@@ -0,0 +1,82 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// models shared by benchmarks
+
+#pragma once
+
+#include <string>
+#include "model.h"
+
+namespace rellaf {
+namespace bench {
+
+class BenchItem : public Object {
+rellaf_model_dcl(BenchItem);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_str(name, "");
+};
+
+rellaf_model_def(BenchItem);
+
+class BenchModel : public Object {
+rellaf_model_dcl(BenchModel);
+
+rellaf_model_def_int64(id, 0);
+rellaf_model_def_int(count, 0);
+rellaf_model_def_uint32(flags, 0);
+rellaf_model_def_bool(valid, false);
+rellaf_model_def_double(score, 0);
+rellaf_model_def_str(name, "");
+rellaf_model_def_str(email, "");
+rellaf_model_def_str(desc, "");
+rellaf_model_def_list(tags, Plain<std::string>);
+rellaf_model_def_list(items, BenchItem);
+rellaf_model_def_object(owner, BenchItem);
+};
+
+rellaf_model_def(BenchModel);
+
+/**
+ * @brief plain members set, `items` items in list members, owner set if nested
+ */
+inline void fill_model(BenchModel& model, int items, bool nested) {
+    model.set_id(1234567890123L);
+    model.set_count(42);
+    model.set_flags(0x5a5a);
+    model.set_valid(true);
+    model.set_score(98.25);
+    model.set_name("rellaf bench");
+    model.set_email("bench@rellaf.org");
+    model.set_desc(std::string(64, 'd'));
+    for (int i = 0; i < items; ++i) {
+        model.tags().push_back(Plain<std::string>("tag_" + std::to_string(i)));
+        BenchItem item;
+        item.set_id(i);
+        item.set_name("item_" + std::to_string(i));
+        model.items().push_back(item);
+    }
+    if (nested) {
+        BenchItem owner;
+        owner.set_id(7);
+        owner.set_name("owner");
+        model.set_owner(&owner);
+    }
+}
+
+}
+}
@@ -0,0 +1,68 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// json benchmarks, built WITH_JSON only
+
+#include "benchmark/benchmark.h"
+#include "json/json_to_model.h"
+#include "bench_common.h"
+
+namespace rellaf {
+namespace bench {
+
+// arg : items in list members, nested owner if not 0
+static void BM_model_to_json(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), state.range(1) != 0);
+    std::string json;
+    for (auto _ : state) {
+        model_to_json(&model, json);
+        benchmark::DoNotOptimize(json.data());
+    }
+    state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_model_to_json)->Args({0, 0})->Args({0, 1})->Args({100, 1});
+
+static void BM_json_to_model(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), state.range(1) != 0);
+    std::string json;
+    model_to_json(&model, json);
+    for (auto _ : state) {
+        BenchModel parsed;
+        benchmark::DoNotOptimize(json_to_model(json, &parsed));
+    }
+    state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_json_to_model)->Args({0, 0})->Args({0, 1})->Args({100, 1});
+
+// one member read out of the large model
+static void BM_json_to_model_lazy(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), true);
+    std::string json;
+    model_to_json(&model, json);
+    for (auto _ : state) {
+        BenchModel parsed;
+        json_to_model_lazy(json, &parsed);
+        benchmark::DoNotOptimize(parsed.name());
+    }
+    state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_json_to_model_lazy)->Arg(100);
+
+}
+}
@@ -0,0 +1,114 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// model benchmarks
+
+#include <algorithm>
+#include <thread>
+#include "benchmark/benchmark.h"
+#include "model.h"
+#include "bench_common.h"
+
+namespace rellaf {
+namespace bench {
+
+// the same class constructed by every thread, throughput SHOULD grow with threads
+static void BM_model_construct(benchmark::State& state) {
+    for (auto _ : state) {
+        BenchModel model;
+        benchmark::DoNotOptimize(&model);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_model_construct)
+        ->ThreadRange(1, (int)std::max(1u, std::thread::hardware_concurrency()))
+        ->UseRealTime();
+
+static void BM_model_construct_reflect(benchmark::State& state) {
+    for (auto _ : state) {
+        BenchModel model;
+        model.set_plain("id", "1");
+        benchmark::DoNotOptimize(model.get_plain("name"));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_model_construct_reflect)
+        ->ThreadRange(1, (int)std::max(1u, std::thread::hardware_concurrency()))
+        ->UseRealTime();
+
+static void BM_model_copy(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), true);
+    for (auto _ : state) {
+        BenchModel copy(model);
+        benchmark::DoNotOptimize(&copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_model_copy)->Arg(0)->Arg(16);
+
+// copy then mutate every member, pays for detaching shared subtrees
+static void BM_model_copy_write(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), true);
+    for (auto _ : state) {
+        BenchModel copy(model);
+        copy.tags().push_back(Plain<std::string>("new"));
+        copy.items().at<BenchItem>(0)->set_id(0);
+        copy.owner()->set_id(0);
+        benchmark::DoNotOptimize(&copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_model_copy_write)->Arg(1)->Arg(16);
+
+static void BM_model_move(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, (int)state.range(0), true);
+    for (auto _ : state) {
+        BenchModel moved(std::move(model));
+        model = std::move(moved);
+        benchmark::DoNotOptimize(&model);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_model_move)->Arg(0)->Arg(16);
+
+static void BM_get_plain(benchmark::State& state) {
+    BenchModel model;
+    fill_model(model, 0, false);
+    static const char* names[] = {
+            "id", "count", "flags", "valid", "score", "name", "email", "desc"};
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.get_plain(names[i++ & 7]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_get_plain);
+
+static void BM_get_plain_missing(benchmark::State& state) {
+    BenchModel model;
+    std::string name = "not_a_member";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.get_plain(name));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_get_plain_missing);
+
+}
+}
@@ -0,0 +1,46 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// http routing benchmarks
+
+#include <map>
+#include "benchmark/benchmark.h"
+#include "var_pattern.h"
+
+namespace rellaf {
+namespace bench {
+
+// arg : apis registered
+static void BM_url_trie_fetch_vars(benchmark::State& state) {
+    UrlTrie trie;
+    for (int i = 0; i < state.range(0); ++i) {
+        std::string idx = std::to_string(i);
+        trie.put("/api" + idx + "/user/{uid}/info", "user_info" + idx);
+        trie.put("/api" + idx + "/user/{uid}/order/{oid}", "user_order" + idx);
+    }
+    std::string path = "/api0/user/10086/order/2018";
+    std::string name;
+    std::map<std::string, std::string> vars;
+    for (auto _ : state) {
+        vars.clear();
+        benchmark::DoNotOptimize(trie.fetch_vars(path, name, vars));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_url_trie_fetch_vars)->Arg(1)->Arg(64);
+
+}
+}
@@ -0,0 +1,117 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// sql builder and escape benchmarks
+
+#include "benchmark/benchmark.h"
+#include "sql_builder.h"
+#include "mysql_escape.h"
+
+namespace rellaf {
+namespace bench {
+
+class BenchInfo : public Object {
+rellaf_model_dcl(BenchInfo);
+
+rellaf_model_def_uint64(id, 0);
+rellaf_model_def_str(content, "");
+rellaf_model_def_uint32(create_time, 0);
+rellaf_model_def_uint32(update_time, 0);
+rellaf_model_def_int(start, 0);
+rellaf_model_def_int(limit, 0);
+};
+
+rellaf_model_def(BenchInfo);
+
+// patterns of demo CWebDao, `_sql` methods only render, nothing executed
+class BenchDao : public SqlBuilder {
+rellaf_singleton(BenchDao);
+
+rellaf_sql_insert_retid(add_info, "INSERT INTO info (content, create_time, update_time) VALUES "
+                                  "(#{content}, NOW(), NOW())");
+
+rellaf_sql_select_list(query_infos,
+        "SELECT id, content, create_time, update_time LIMIT #{start}, #{limit}", BenchInfo);
+
+rellaf_sql_delete(delete_info, "DELETE FROM info WHERE id=#{id}");
+
+rellaf_sql_update(update_info,
+        "UPDATE info SET content=#{content}, update_time=NOW() WHERE id=#{id}");
+
+rellaf_sql_update_dirty(update_info_dirty, "info", "id=#{id}");
+};
+
+static BenchInfo bench_info() {
+    BenchInfo info;
+    info.set_id(10086);
+    info.set_start(100);
+    info.set_limit(20);
+    // as loaded then content changed
+    info.clear_dirty();
+    info.set_content("it's a content of \"info\" with some quotes\n");
+    return info;
+}
+
+#define BENCH_DAO_SQL(_method_)                                     \
+static void BM_prepare_##_method_(benchmark::State& state) {        \
+    BenchInfo info = bench_info();                                  \
+    std::string sql;                                                \
+    for (auto _ : state) {                                          \
+        BenchDao::instance()._method_##_sql(sql, info);             \
+        benchmark::DoNotOptimize(sql.data());                       \
+    }                                                               \
+    state.SetItemsProcessed(state.iterations());                    \
+}                                                                   \
+BENCHMARK(BM_prepare_##_method_)
+
+BENCH_DAO_SQL(add_info);
+BENCH_DAO_SQL(query_infos);
+BENCH_DAO_SQL(delete_info);
+BENCH_DAO_SQL(update_info);
+BENCH_DAO_SQL(update_info_dirty);
+
+// arg : 0 ascii, 1 utf8, 2 gbk
+static void BM_sql_escape(benchmark::State& state) {
+    std::string unit;
+    const char* encode = "UTF8";
+    switch (state.range(0)) {
+        case 0:
+            unit = "it's a \"quoted\" line\n";
+            break;
+        case 1:
+            unit = "\xe4\xbd\xa0\xe5\xa5\xbd'\xe4\xb8\x96\xe7\x95\x8c\"";
+            break;
+        default:
+            unit = "\xc4\xe3\xba\xc3'\xca\xc0\xbd\xe7\"\xd5\x5c";
+            encode = "GBK";
+            break;
+    }
+    std::string from;
+    while (from.size() < 1024) {
+        from += unit;
+    }
+    SqlEscape& escape = SqlEscape::instance(encode);
+    std::string out;
+    for (auto _ : state) {
+        escape.escape_field(from, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(state.iterations() * from.size());
+}
+BENCHMARK(BM_sql_escape)->Arg(0)->Arg(1)->Arg(2);
+
+}
+}
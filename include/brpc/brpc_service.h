@@ -24,6 +24,8 @@
 #include "brpc/http_method.h"
 #include "common.h"
 #include "model.h"
+#include "field_binder.h"
+#include "phase_stats.h"
 #include "function_mapper.hpp"
 #include "http_arg_type.h"
 
@@ -101,6 +103,30 @@ public:
         inst->bind_api_sign(sign, api);                                                         \
         FunctionMapper::instance().reg(api, name, method, func);                                \
     }                                                                                           \
+    template<class Params, class Vars>                                                          \
+    Reg(_clazz_* inst, const std::string& sign, const std::string& api,                         \
+            const std::string& name, HttpMethod method,                                         \
+            std::function<int(HttpContext&, const std::string&, std::string&)> func,            \
+            const Params*, const Vars*) : Reg(inst, sign, api, name, method, func) {            \
+        /* build binding tables of arguments at registration, not at the first request */      \
+        FunctionMapper::instance().reg_binders(name, &FieldBinder::of<Params>(),                \
+                &FieldBinder::of<Vars>());                                                      \
+    }                                                                                           \
+};                                                                                              \
+class CacheReg {                                                                                \
+public:                                                                                         \
+    CacheReg(const std::string& name, int64_t ttl_ms, size_t max_bytes) {                      \
+        ResponseCacheOptions options;                                                           \
+        options.ttl_ms = ttl_ms;                                                                \
+        options.max_bytes = max_bytes;                                                          \
+        FunctionMapper::instance().reg_cache(name, options);                                    \
+    }                                                                                           \
+};                                                                                              \
+class LazyBodyReg {                                                                             \
+public:                                                                                         \
+    explicit LazyBodyReg(const std::string& name) {                                             \
+        FunctionMapper::instance().reg_lazy_body(name);                                         \
+    }                                                                                           \
 }
 
 // definition brpc request entry method signature fowarding call BrpcService::entry
@@ -112,24 +138,28 @@ void _sign_(RpcController* controller, const pb_req_t* request,
 }
 
 template<class T>
-void flatten_args(std::deque<Model*>& args, T& arg) {
+void flatten_args(std::deque<std::pair<Model*, const FieldBinder*>>& args, T& arg) {
     if (std::is_base_of<Model, T>::value) {
-        args.emplace_back(&arg);
+        args.emplace_back(&arg, &FieldBinder::of<T>());
     }
 }
 
 template<class ...Args>
 bool prepare_args(HttpContext& ctx, const std::string& body, Args& ... args) {
 
-    std::deque<Model*> model_args;
+    std::deque<std::pair<Model*, const FieldBinder*>> model_args;
     bool arr[] = {(flatten_args(model_args, args), true)...}; // for arguments expansion
     (void)(arr);// suppress warning
 
     bool s = false;
-    for (Model* arg : model_args) {
+    for (auto& entry : model_args) {
+        Model* arg = entry.first;
+        const FieldBinder* binder = entry.second;
         if (arg->rellaf_tag() == HttpArgTypeEnum::e().REQ_BODY.name) {
             if (is_plain(arg)) {
                 s = arg->set_parse(body);
+            } else if (ctx.lazy_body && is_object(arg)) {
+                s = json_to_model_lazy(body, (Object*)arg);
             } else {
                 s = json_to_model(body, arg);
             }
@@ -141,10 +171,10 @@ bool prepare_args(HttpContext& ctx, const std::string& body, Args& ... args) {
 
         if (arg->rellaf_tag() == HttpArgTypeEnum::e().REQ_PARAM.name) {
 
-            if (is_object(arg)) {
+            if (is_object(arg) && !binder->empty()) {
                 const brpc::URI& uri = ctx.request_header.uri();
                 for (auto iter = uri.QueryBegin(); iter != uri.QueryEnd(); ++iter) {
-                    ((Object*)arg)->set_plain(iter->first, iter->second);
+                    binder->set_plain((Object*)arg, iter->first, iter->second);
                 }
             }
             continue;
@@ -153,8 +183,10 @@ bool prepare_args(HttpContext& ctx, const std::string& body, Args& ... args) {
         if (arg->rellaf_tag() == HttpArgTypeEnum::e().PATH_VAR.name) {
             FLOG(DEBUG) << "context path vars: " << ctx.path_vars;
             if (is_object(arg)) {
-                for (const auto& entry : ctx.path_vars) {
-                    ((Object*)arg)->set_plain(entry.first, entry.second);
+                if (!binder->empty()) {
+                    for (const auto& var : ctx.path_vars) {
+                        binder->set_plain((Object*)arg, var.first, var.second);
+                    }
                 }
             } else if (is_plain(arg) && !ctx.path_vars.empty()) {
                 arg->set_parse(ctx.path_vars.begin()->second);
@@ -175,13 +207,18 @@ private:
             _Params_ p;                                                                            \
             _Vars_ v;                                                                              \
             _Body_ b;                                                                              \
-            if (!prepare_args<_Params_, _Vars_, _Body_>(ctx, body,                                 \
-                    p.tag<_Params_>(HttpArgTypeEnum::e().REQ_PARAM.name),                          \
-                    v.tag<_Vars_>(HttpArgTypeEnum::e().PATH_VAR.name),                             \
-                    b.tag<_Body_>(HttpArgTypeEnum::e().REQ_BODY.name))) {                          \
-                return -1;                                                                         \
+            {                                                                                      \
+                PhaseScope args_phase(PhaseStats::ARGS);                                           \
+                if (!prepare_args<_Params_, _Vars_, _Body_>(ctx, body,                             \
+                        p.tag<_Params_>(HttpArgTypeEnum::e().REQ_PARAM.name),                      \
+                        v.tag<_Vars_>(HttpArgTypeEnum::e().PATH_VAR.name),                         \
+                        b.tag<_Body_>(HttpArgTypeEnum::e().REQ_BODY.name))) {                      \
+                    return -1;                                                                     \
+                }                                                                                  \
             }                                                                                      \
+            PhaseScope phase(PhaseStats::HANDLER);                                                 \
             _Ret_ ret = _func_##_base(ctx, p, v, b);                                               \
+            phase.next(PhaseStats::SERIALIZE);                                                     \
             if (is_plain(&ret)) {                                                                  \
                 ret_body = ((Model*)&ret)->str();                                                  \
             } else {                                                                               \
@@ -190,7 +227,8 @@ private:
                 }                                                                                  \
             }                                                                                      \
             return 0;                                                                              \
-        }                                                                                          \
+        },                                                                                         \
+        (const _Params_*)nullptr, (const _Vars_*)nullptr                                           \
     };                                                                                             \
     _Ret_ _func_##_base(HttpContext& ctx, const _Params_& p, const _Vars_& v, const _Body_& b)
 
@@ -203,6 +241,18 @@ private:
 public:                                                                                         \
     _Ret_ _func_(HttpContext& ctx, const _Params_& p, const _Vars_& v)
 
+// cache serialized response of GET handler defined by `rellaf_brpc_http_def_get*`
+// with the same `_sign_` and `_func_`, see `FunctionMapper::reg_cache`
+#define rellaf_brpc_http_cache_get(_sign_, _func_, _ttl_ms_, _max_bytes_)                       \
+private:                                                                                        \
+    CacheReg _cache_reg_##_sign_##_func_{#_sign_"-GET-"#_func_, _ttl_ms_, _max_bytes_}
+
+// decode JSON body of POST handler defined by `rellaf_brpc_http_def_post*` with the same
+// `_sign_` and `_func_` lazily, members are decoded at first access, see `json_to_model_lazy`
+#define rellaf_brpc_http_lazy_body(_sign_, _func_)                                              \
+private:                                                                                        \
+    LazyBodyReg _lazy_body_reg_##_sign_##_func_{#_sign_"-POST-"#_func_}
+
 #define rellaf_brpc_http_def_get_param(_sign_, _api_, _func_, _Ret_, _Params_)                  \
 private:                                                                                        \
     rellaf_brpc_http_def_get(_sign_, _api_, _func_, _Ret_, _Params_, Void) {                    \
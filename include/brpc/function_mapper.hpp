@@ -20,8 +20,14 @@
 #include <functional>
 #include <unordered_map>
 #include <memory>
+#include <vector>
+#include <algorithm>
 #include "common.h"
 #include "str.hpp"
+#include "field_binder.h"
+#include "response_cache.h"
+#include "brpc/controller.h"
+#include "brpc/http_status_code.h"
 
 #include "var_pattern.h"
 #include "json/json_to_model.h"
@@ -37,6 +43,8 @@ struct HttpContext {
     const std::map<std::string, std::string>& path_vars;
     HttpHeader& response_header;
     butil::IOBuf& response_body;
+    // decode JSON body lazily, see `FunctionMapper::reg_lazy_body`
+    bool lazy_body = false;
 
     HttpContext(const HttpHeader& req_header, const butil::IOBuf& req_body,
             const std::map<std::string, std::string>& vars,
@@ -88,25 +96,75 @@ public:
      */
     int invoke(const std::string& name, const std::map<std::string, std::string>& vars,
             brpc::Controller* cntl, std::string& ret_body) {
-        auto func_entry = _funcs.find(name);
-        if (func_entry == _funcs.end()) {
+        auto route_entry = _routes.find(name);
+        if (route_entry == _routes.end()) {
             return -1;
         }
+        Route& route = route_entry->second;
+
+        std::string key;
+        bool cacheable = route.cache && cntl->http_request().method() == brpc::HTTP_METHOD_GET;
+        if (cacheable) {
+            cache_key(name, route, cntl->http_request().uri(), vars, key);
+            if (route.cache->get(key, cntl->response_attachment())) {
+                cntl->http_response().set_content_type("application/json");
+                return 0;
+            }
+        }
 
         HttpContext ctx(cntl->http_request(), cntl->request_attachment(), vars,
                 cntl->http_response(), cntl->response_attachment());
-        int ret = (func_entry->second)(ctx, cntl->request_attachment().to_string(), ret_body);
+        ctx.lazy_body = route.lazy_body;
+        int ret = (route.func)(ctx, cntl->request_attachment().to_string(), ret_body);
         cntl->http_response().set_content_type("application/json");
+
+        if (cacheable && ret == 0 &&
+                cntl->http_response().status_code() == brpc::HTTP_STATUS_OK) {
+            cntl->response_attachment().append(ret_body);
+            ret_body.clear();
+            route.cache->put(key, cntl->response_attachment());
+        }
         return ret;
     }
 
     void reg(const std::string& api, const std::string& name, HttpMethod method,
             std::function<int(HttpContext&, const std::string&, std::string&)> ctx_func) {
         reg_api(api, name);
-        FunctionMapper::instance()._funcs.emplace(name, ctx_func);
+        FunctionMapper::instance()._routes[name].func = ctx_func;
         RELLAF_DEBUG("default handler %s registered", name.c_str());
     }
 
+    /**
+     * @brief bind tables of query params and path vars of handler `name`
+     */
+    void reg_binders(const std::string& name, const FieldBinder* params, const FieldBinder* vars) {
+        Route& route = _routes[name];
+        route.params = params;
+        route.vars = vars;
+    }
+
+    /**
+     * @brief cache response of GET handler `name`, keyed by bound query params and path vars,
+     *        handlers reading query or header from context directly should not be cached
+     */
+    void reg_cache(const std::string& name, const ResponseCacheOptions& options) {
+        _routes[name].cache.reset(new ResponseCache(name, options));
+        RELLAF_DEBUG("response cache of %s registered, ttl : %ld ms, max bytes : %zu",
+                name.c_str(), options.ttl_ms, options.max_bytes);
+    }
+
+    /**
+     * @brief decode JSON body of handler `name` lazily
+     */
+    void reg_lazy_body(const std::string& name) {
+        _routes[name].lazy_body = true;
+    }
+
+    ResponseCache* fetch_cache(const std::string& name) {
+        auto entry = _routes.find(name);
+        return entry == _routes.end() ? nullptr : entry->second.cache.get();
+    }
+
 private:
     void reg_api(const std::string& api, const std::string& name) {
         // FIXME.. generalize HTTP API
@@ -123,6 +181,53 @@ private:
         }
     }
 
+private:
+    struct Route {
+        std::function<int(HttpContext&, const std::string&, std::string&)> func;
+        const FieldBinder* params = nullptr;
+        const FieldBinder* vars = nullptr;
+        std::unique_ptr<ResponseCache> cache;
+        bool lazy_body = false;
+    };
+
+    static void append_key(std::string& key, const std::string& str) {
+        key += std::to_string(str.size());
+        key += ':';
+        key += str;
+    }
+
+    /**
+     * key is handler name with query params bound to members of params model in order of name,
+     * then all path vars, each one length prefixed
+     */
+    static void cache_key(const std::string& name, const Route& route, const brpc::URI& uri,
+            const std::map<std::string, std::string>& vars, std::string& key) {
+        key = name;
+        if (route.params != nullptr && !route.params->empty()) {
+            std::vector<std::pair<const std::string*, const std::string*>> params;
+            for (auto iter = uri.QueryBegin(); iter != uri.QueryEnd(); ++iter) {
+                if (route.params->contains(iter->first)) {
+                    params.emplace_back(&iter->first, &iter->second);
+                }
+            }
+            std::sort(params.begin(), params.end(),
+                    [](const std::pair<const std::string*, const std::string*>& l,
+                            const std::pair<const std::string*, const std::string*>& r) {
+                        return *l.first < *r.first;
+                    });
+            key += '?';
+            for (auto& param : params) {
+                append_key(key, *param.first);
+                append_key(key, *param.second);
+            }
+        }
+        key += '/';
+        for (auto& var : vars) {
+            append_key(key, var.first);
+            append_key(key, var.second);
+        }
+    }
+
 private:
 
     // <api, name>
@@ -130,11 +235,11 @@ private:
 
     UrlTrie _path_vars;
 
+    // <name, route>
     // request body as json string parsing to model,
     // return value as model convert json string as well
     // function with http context
-    std::unordered_map<std::string,
-            std::function<int(HttpContext&, const std::string&, std::string&)>> _funcs;
+    std::unordered_map<std::string, Route> _routes;
 };
 
-}
\ No newline at end of file
+}
@@ -17,18 +17,137 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <string>
 #include <map>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "brpc/channel.h"
 #include "brpc/controller.h"
+#include "common.h"
+#include "model.h"
 
 namespace rellaf {
 
+struct HttpRequest {
+    std::string api;
+    brpc::HttpMethod method = brpc::HTTP_METHOD_GET;
+    std::map<std::string, std::string> params;
+    std::map<std::string, std::string> headers;
+    std::string content_type;
+    std::string body;
+};
+
 struct HttpResponse {
     butil::IOBuf body;
     int status;
     std::string content_type;
     std::string reason_phrase;
     brpc::CompressType compress_type;
+    // 0 if the call succeeded, otherwise error code of brpc, e.g. ERPCTIMEDOUT, ECANCELED
+    int error_code = 0;
+    std::string error_text;
+};
+
+struct HttpClientOptions {
+    // default timeout of each call, -1 means no timeout,
+    // could be overwritten by `timeout` argument of calls
+    int timeout_ms = -1;
+    int connect_timeout_ms = 200;
+    int max_retry = 3;
+    // CONNECTION_TYPE_POOLED or CONNECTION_TYPE_SINGLE
+    brpc::ConnectionType connection_type = brpc::CONNECTION_TYPE_POOLED;
+
+    // if set, e.g. "list://127.0.0.1:8080,127.0.0.1:8081" or "http://domain.com",
+    // all calls are load balanced over the naming service with `load_balancer`,
+    // host of the api is ignored, only path and query are used.
+    std::string naming_service_url;
+    std::string load_balancer = "rr";
+};
+
+/**
+ * http client caching channels by scheme://host:port (or naming service),
+ * thread safe, channels are initialized at the first call and reused since then.
+ */
+class HttpClient {
+RELLAF_AVOID_COPY(HttpClient)
+
+public:
+    explicit HttpClient(const HttpClientOptions& options = HttpClientOptions());
+
+    virtual ~HttpClient();
+
+    /**
+     * default client, `http_get`, `http_post` and `http_request` forward to it
+     */
+    static HttpClient& instance();
+
+    int request(const std::string& api, brpc::HttpMethod method,
+            const std::map<std::string, std::string>& params,
+            const std::map<std::string, std::string>& headers,
+            const std::string& content_type, const std::string& request_body,
+            HttpResponse& response, int timeout = -1);
+
+    int get(const std::string& api, const std::map<std::string, std::string>& params,
+            HttpResponse& response, int timeout = -1);
+
+    int post(const std::string& api, const std::map<std::string, std::string>& params,
+            const std::string& request_body, HttpResponse& response, int timeout = -1);
+
+    /**
+     * @brief model binding version, `request_model` is serialized into request body directly,
+     *        response body is decoded into `response_model` directly.
+     *        Plain model as raw string, others as json.
+     * @param request_model     nullptr if no request body
+     * @param response_model    nullptr if response body ignored, `response.body` keeps the raw
+     * @return -1 if call failed or response body could not be decoded
+     */
+    int request(const std::string& api, brpc::HttpMethod method,
+            const std::map<std::string, std::string>& params,
+            const std::map<std::string, std::string>& headers,
+            const Model* request_model, Model* response_model,
+            HttpResponse& response, int timeout = -1);
+
+    int get(const std::string& api, const std::map<std::string, std::string>& params,
+            Model* response_model, HttpResponse& response, int timeout = -1);
+
+    int post(const std::string& api, const std::map<std::string, std::string>& params,
+            const Model* request_model, Model* response_model, HttpResponse& response,
+            int timeout = -1);
+
+    const HttpClientOptions& options() const {
+        return _options;
+    }
+
+    /**
+     * @brief issue all `requests` concurrently, `responses` are in the same order of requests
+     * @param timeout   deadline shared by all calls, -1 use default timeout of options
+     * @param min_done  return once `min_done` calls succeeded, unfinished calls are canceled
+     *                  with ECANCELED, 0 means waiting for all calls
+     * @return count of succeeded calls
+     */
+    int batch(const std::vector<HttpRequest>& requests, std::vector<HttpResponse>& responses,
+            int timeout = -1, size_t min_done = 0);
+
+    size_t channel_count();
+
+protected:
+    /**
+     * @brief parse `api` to `uri` then fetch the cached channel of it, create if not exist
+     * @return nullptr if failed
+     */
+    brpc::Channel* fetch_channel(const std::string& api, brpc::URI& uri);
+
+    int call(brpc::Channel* channel, brpc::Controller& controller, const std::string& api,
+            HttpResponse& response);
+
+private:
+    HttpClientOptions _options;
+
+    pthread_rwlock_t _lock = PTHREAD_RWLOCK_INITIALIZER;
+    // <scheme://host:port or naming service url, channel>
+    std::unordered_map<std::string, std::unique_ptr<brpc::Channel>> _channels;
 };
 
 int http_request(const std::string& api, brpc::HttpMethod method,
@@ -43,4 +162,4 @@ int http_get(const std::string& api, const std::map<std::string, std::string>& p
 int http_post(const std::string& api, const std::map<std::string, std::string>& params,
         const std::string& request_body, HttpResponse& response, int timeout = -1);
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,49 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// converter between model object and protobuf message
+
+#pragma once
+
+#include "google/protobuf/message.h"
+#include "model.h"
+
+namespace rellaf {
+
+/**
+ * Members are mapped to message fields of the same name by the Descriptor, the mapping
+ * is built at the first conversion of each <model class, descriptor> pair and cached.
+ * Type of both sides must be compatible, otherwise the member is skipped:
+ *   integer plains <-> int32, int64, uint32, uint64, enum number (cast)
+ *   bool <-> bool, float/double <-> float/double, str <-> string/bytes
+ *   object <-> message, list <-> repeated field of compatible item type
+ */
+
+/**
+ * @brief write members of `model` to fields of `msg`, repeated fields replaced,
+ *        null object member clears the field
+ * @return false if `model` is not Object
+ */
+bool model_to_pb(const Model* model, google::protobuf::Message* msg);
+
+/**
+ * @brief read fields of `msg` to members of `model`, lists replaced,
+ *        object member is reset to nullptr if field not set
+ * @return false if `model` is not Object
+ */
+bool pb_to_model(const google::protobuf::Message& msg, Model* model);
+
+}
@@ -0,0 +1,33 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#pragma once
+
+#include "phase_stats.h"
+
+namespace rellaf {
+
+/**
+ * @brief expose PhaseStats as bvar, once, called by `BrpcDispatcher::reg_http_serivces`.
+ *        `rellaf_phase_<phase>_<count|cpu_ns|wall_ns|allocs|alloc_bytes>` are cumulative
+ *        numbers of each phase, `rellaf_phase_stats` is the json dump of all.
+ *        Reloadable flag `rellaf_phase_stats` toggles PhaseStats at runtime,
+ *        e.g. by builtin service `/flags/rellaf_phase_stats?setvalue=true`.
+ */
+void expose_phase_stats();
+
+}
@@ -0,0 +1,106 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include "butil/iobuf.h"
+#include "bvar/bvar.h"
+#include "common.h"
+
+namespace rellaf {
+
+struct ResponseCacheOptions {
+    // entry expired after `ttl_ms` since stored
+    int64_t ttl_ms = 1000;
+    // total bytes of cached bodies, least recently used evicted beyond it
+    size_t max_bytes = 64 * 1024 * 1024;
+    size_t shard_num = 16;
+};
+
+/**
+ * serialized response body cache of one route, LRU per shard, thread safe.
+ * Bodies are kept as IOBuf, a hit appends shared blocks without copying.
+ * bvar `rellaf_response_cache_<name>_hit` and `..._miss` are exposed.
+ */
+class ResponseCache {
+RELLAF_AVOID_COPY(ResponseCache)
+
+public:
+    ResponseCache(const std::string& name, const ResponseCacheOptions& options);
+
+    virtual ~ResponseCache();
+
+    /**
+     * @brief append cached body of `key` to `body`
+     * @return false if not exist or expired
+     */
+    bool get(const std::string& key, butil::IOBuf& body);
+
+    void put(const std::string& key, const butil::IOBuf& body);
+
+    void clear();
+
+    size_t bytes();
+
+    inline int64_t hit_count() const {
+        return _hit.get_value();
+    }
+
+    inline int64_t miss_count() const {
+        return _miss.get_value();
+    }
+
+    inline const ResponseCacheOptions& options() const {
+        return _options;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        butil::IOBuf body;
+        int64_t expire_us;
+    };
+
+    struct Shard {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        // front is the most recently used
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shard_of(const std::string& key);
+
+    // caller holds lock of `shard`
+    static void erase(Shard& shard, std::list<Entry>::iterator iter);
+
+private:
+    ResponseCacheOptions _options;
+    size_t _shard_max_bytes;
+    std::unique_ptr<Shard[]> _shards;
+
+    bvar::Adder<int64_t> _hit;
+    bvar::Adder<int64_t> _miss;
+};
+
+}
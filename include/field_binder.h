@@ -0,0 +1,123 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// binding table from plain member name to member slot of a model class
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "model.h"
+
+namespace rellaf {
+
+/**
+ * Plain members defined by `rellaf_model_def_xxx` are data members of the class,
+ * so the address of each one relative to the object is fixed per class.
+ * The binder records <name, offset> of a prototype into a perfect hash table,
+ * binding a member of any instance of the same class is one hash probe
+ * plus `set_parse` on the member in place, no map lookup and no `create()`.
+ */
+class FieldBinder {
+public:
+    FieldBinder() = default;
+
+    /**
+     * @brief build table from `prototype`, every instance bound later must be the same class
+     */
+    explicit FieldBinder(const Object* prototype);
+
+    /**
+     * @brief binder of class T built once at the first call, empty if T is not Object
+     */
+    template<class T>
+    static const FieldBinder& of() {
+        static FieldBinder binder(build<T>(std::is_base_of<Object, T>()));
+        return binder;
+    }
+
+    /**
+     * @return plain member of `obj` named `key`, nullptr if not exist
+     */
+    Model* field(Object* obj, const char* key, size_t len) const;
+
+    Model* field(Object* obj, const std::string& key) const {
+        return field(obj, key.data(), key.size());
+    }
+
+    /**
+     * @return if `key` is a plain member of the class
+     */
+    bool contains(const char* key, size_t len) const {
+        return find(key, len) != nullptr;
+    }
+
+    bool contains(const std::string& key) const {
+        return find(key.data(), key.size()) != nullptr;
+    }
+
+    /**
+     * @brief parse `val` into plain member of `obj` named `key`, marked dirty as `Object::set_plain`
+     * @return false if not a plain member or parse failed
+     */
+    bool set_plain(Object* obj, const std::string& key, const std::string& val) const;
+
+    inline size_t size() const {
+        return _size;
+    }
+
+    inline bool empty() const {
+        return _size == 0;
+    }
+
+private:
+    struct Slot {
+        std::string name;
+        // offset of member from Object*, -1 means empty slot
+        ptrdiff_t offset = -1;
+        // index of member in `rellaf_meta().plains()`, bit of dirty flags
+        size_t index = 0;
+    };
+
+    template<class T>
+    static FieldBinder build(std::true_type) {
+        T prototype;
+        return FieldBinder(&prototype);
+    }
+
+    template<class T>
+    static FieldBinder build(std::false_type) {
+        return FieldBinder();
+    }
+
+    const Slot* find(const char* key, size_t len) const;
+
+    static uint64_t hash(const char* key, size_t len, uint64_t seed);
+
+    // try to place all names without collision in `capacity` slots with `seed`
+    bool place(const std::vector<Slot>& slots, size_t capacity, uint64_t seed);
+
+private:
+    std::vector<Slot> _table;
+    uint64_t _seed = 0;
+    size_t _mask = 0;
+    size_t _size = 0;
+};
+
+}
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <ostream>
 #include "model.h"
 
 namespace rellaf {
@@ -29,6 +30,14 @@ namespace rellaf {
  */
 bool model_to_json(const Model* model, std::string& json_str, bool is_format = false);
 
+/**
+ * @brief write json of model object to stream directly, without intermediate string
+ * @param model
+ * @param os output
+ * @param is_format
+ */
+bool model_to_json(const Model* model, std::ostream& os, bool is_format = false);
+
 /**
  * @brief convert json string to model object
  * @param json_str
@@ -36,4 +45,22 @@ bool model_to_json(const Model* model, std::string& json_str, bool is_format = f
  */
 bool json_to_model(const std::string& json_str, Model* model);
 
+/**
+ * @brief convert json buffer to model object, buffer need not be null terminated
+ * @param json_buf
+ * @param len
+ * @param model
+ */
+bool json_to_model(const char* json_buf, size_t len, Model* model);
+
+/**
+ * @brief index json object keys of `model` members only, each member is decoded
+ *        at its first access, see `Object::set_lazy_source`.
+ *        Values never accessed are not validated.
+ * @return false if not a well formed json object
+ */
+bool json_to_model_lazy(const std::string& json_str, Object* model);
+
+bool json_to_model_lazy(const char* json_buf, size_t len, Object* model);
+
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// load generator, calls from threads with latency percentiles
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "common.h"
+
+namespace rellaf {
+
+/**
+ * log linear histogram of latencies in nanoseconds, values below 128 exact,
+ * others in 64 sub buckets of each power of 2, error within 1.6%. Not thread safe,
+ * one per thread then merged.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void add(uint64_t ns);
+
+    void merge(const LatencyHistogram& o);
+
+    void clear();
+
+    inline uint64_t count() const {
+        return _count;
+    }
+
+    inline uint64_t max() const {
+        return _max;
+    }
+
+    inline uint64_t min() const {
+        return _count == 0 ? 0 : _min;
+    }
+
+    inline double mean() const {
+        return _count == 0 ? 0 : (double)_sum / _count;
+    }
+
+    /**
+     * @brief upper bound of bucket `ratio` of samples fall in, such as 0.99, 0 if empty
+     */
+    uint64_t percentile(double ratio) const;
+
+private:
+    static size_t index_of(uint64_t ns);
+
+    static uint64_t upper_of(size_t idx);
+
+private:
+    std::vector<uint64_t> _buckets;
+    uint64_t _count = 0;
+    uint64_t _sum = 0;
+    uint64_t _min = UINT64_MAX;
+    uint64_t _max = 0;
+};
+
+/**
+ * calls a function from threads for a while, measures every call
+ */
+class LoadRunner {
+RELLAF_AVOID_COPY(LoadRunner)
+
+public:
+    /**
+     * one call made by thread `idx`, false if failed
+     */
+    typedef std::function<bool(int idx)> Call;
+
+    struct Report {
+        int threads = 0;
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        double seconds = 0;
+        double qps = 0;
+        // latencies in microseconds
+        double mean_us = 0;
+        double p50_us = 0;
+        double p99_us = 0;
+        double p999_us = 0;
+        double max_us = 0;
+
+        std::string str() const;
+
+        std::string json() const;
+    };
+
+    /**
+     * @param threads       threads calling concurrently
+     * @param duration_ms   run until elapsed
+     * @param max_calls     stop earlier once made by each thread, 0 unlimited
+     */
+    LoadRunner(int threads, uint32_t duration_ms, uint64_t max_calls = 0);
+
+    virtual ~LoadRunner() = default;
+
+    /**
+     * @brief calls made before measuring, not reported
+     */
+    void set_warmup_ms(uint32_t warmup_ms) {
+        _warmup_ms = warmup_ms;
+    }
+
+    Report run(const Call& call);
+
+    /**
+     * @brief merged latencies of last run
+     */
+    inline const LatencyHistogram& histogram() const {
+        return _histogram;
+    }
+
+private:
+    int _threads;
+    uint32_t _duration_ms;
+    uint64_t _max_calls;
+    uint32_t _warmup_ms = 0;
+    LatencyHistogram _histogram;
+};
+
+}
@@ -1,239 +1,300 @@
-// Copyright 2018 Fankux
-//
-// Licensed under the Apache License, Version 2.0 (the "License");
-// you may not use this file except in compliance with the License.
-// You may obtain a copy of the License at
-//
-//     http://www.apache.org/licenses/LICENSE-2.0
-//
-// Unless required by applicable law or agreed to in writing, software
-// distributed under the License is distributed on an "AS IS" BASIS,
-// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-// See the License for the specific language governing permissions and
-// limitations under the License.
-//
-// Author: Fankux (fankux@gmail.com)
-//
-
-#pragma once
-
-#include <vector>
-#include <deque>
-#include <map>
-#include <unordered_map>
-#include <set>
-#include <unordered_set>
-#include <sstream>
-#include <iostream>
-
-namespace rellaf {
-
-class LogStream {
-public:
-    // TODO.. time
-    explicit LogStream(int level, const std::string& file, const int line) :
-            _level(level), _file(file), _line(line) {
-#ifndef NDEBUG
-        if (_level == 0) {
-            _pre_str = "D [" + file + ":" + std::to_string(line) + "] ";
-            return;
-        }
-#endif
-        if (_level == 1) {
-            _pre_str = "I [" + file + ":" + std::to_string(line) + "] ";
-        } else if (_level == 2) {
-            _pre_str = "W [" + file + ":" + std::to_string(line) + "] ";
-        } else if (_level == 3) {
-            _pre_str = "E [" + file + ":" + std::to_string(line) + "] ";
-        } else if (_level == 4) {
-            _pre_str = "F [" + file + ":" + std::to_string(line) + "] ";
-        }
-    }
-
-    ~LogStream() {
-        flush();
-    }
-
-    inline LogStream& operator<<(int16_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(int val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(int64_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(uint16_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(uint32_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(uint64_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(float val) {
-        _ss << val;
-        return *this;
-    }
-
-#ifdef __APPLE__
-
-    inline LogStream& operator<<(size_t val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(ssize_t val) {
-        _ss << val;
-        return *this;
-    }
-
-#endif
-
-    inline LogStream& operator<<(double val) {
-        _ss << val;
-        return *this;
-    }
-
-    inline LogStream& operator<<(const std::string& val) {
-        _ss << val;
-        return *this;
-    }
-
-    template<typename T>
-    inline LogStream& operator<<(const std::vector<T>& t) {
-        iter_list(t);
-        return *this;
-    }
-
-    template<typename T>
-    inline LogStream& operator<<(const std::deque<T>& t) {
-        iter_list(t);
-        return *this;
-    }
-
-#if __cplusplus >= 201703L
-    template<typename T>
-    inline LogStream& operator<<(const std::list<T>& t) {
-        iter_list(t);
-        return *this;
-    }
-#endif
-
-    template<typename T>
-    inline LogStream& operator<<(const std::set<T>& t) {
-        iter_list(t);
-        return *this;
-    }
-
-    template<typename T>
-    inline LogStream& operator<<(const std::unordered_set<T>& t) {
-        iter_list(t);
-        return *this;
-    }
-
-    template<typename K, typename V>
-    inline LogStream& operator<<(const std::map<K, V>& t) {
-        iter_kv(t);
-        return *this;
-    }
-
-    template<typename K, typename V>
-    inline LogStream& operator<<(const std::unordered_map<K, V>& t) {
-        iter_kv(t);
-        return *this;
-    }
-
-    template<typename K, typename V>
-    inline LogStream& operator<<(const std::pair<K, V>& t) {
-        *this << "<" << t.first << "," << t.second << ">";
-        return *this;
-    }
-
-    template<typename T>
-    void iter_list(const T& t) {
-        *this << "[";
-        size_t i = 0;
-        for (auto iter = t.begin(); iter != t.end(); ++iter) {
-            *this << *iter;
-            if (i++ != t.size() - 1) {
-                *this << ",";
-            }
-        }
-        *this << "]";
-    }
-
-    template<typename T>
-    void iter_kv(const T& t) {
-        *this << "{";
-        size_t i = 0;
-        for (auto iter = t.begin(); iter != t.end(); ++iter) {
-            *this << "(" << iter->first << ":" << iter->second << ")";
-            if (i++ != t.size() - 1) {
-                *this << ",";
-            }
-        }
-        *this << "}";
-    }
-
-    void flush() {
-        std::cout << _pre_str << _ss.str() << std::endl;
-        _ss.clear();
-    }
-
-private:
-    std::stringstream _ss;
-    int _level;
-    const std::string& _file;
-    const int _line;
-    std::string _pre_str;
-};
-
-template<typename T>
-class LogMessage {
-public:
-    explicit LogMessage(int level, const std::string& file, const int line) {
-        if (_stream == nullptr) {
-            _stream = new T(level, file, line);
-        }
-    }
-
-    ~LogMessage() {
-        if (_stream != nullptr) {
-            _stream->flush();
-        }
-    }
-
-    T& stream() {
-        return *_stream;
-    }
-
-private:
-    T* _stream = nullptr;
-};
-
-}
-
-#ifdef NDEBUG
-#define FLOG_DEBUG
-#else
-#ifndef FLOG_DEBUG
-#define FLOG_DEBUG rellaf::LogMessage<rellaf::LogStream>(0, __FILE__, __LINE__).stream()
-#endif
-#endif
-
-#define FLOG_INFO rellaf::LogMessage<rellaf::LogStream>(1, __FILE__, __LINE__).stream()
-#define FLOG(level)  FLOG_##level
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// asynchronous level filtered logger
+//
+// FLOG(INFO) << "id: " << id;
+//
+// Statements below `RELLAF_LOG_MIN_LEVEL` are compiled out, statements below runtime level
+// `Logger::set_level` cost one load, arguments of filtered statements are never evaluated.
+// Lines are formatted into a thread local buffer, pushed to a lock free queue and written
+// in batches by a background thread, to stdout or to a file rotated by size.
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <unordered_set>
+#include <type_traits>
+
+#define RELLAF_LOG_LEVEL_DEBUG 0
+#define RELLAF_LOG_LEVEL_INFO 1
+#define RELLAF_LOG_LEVEL_WARNING 2
+#define RELLAF_LOG_LEVEL_ERROR 3
+#define RELLAF_LOG_LEVEL_FATAL 4
+
+#ifndef RELLAF_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define RELLAF_LOG_MIN_LEVEL RELLAF_LOG_LEVEL_INFO
+#else
+#define RELLAF_LOG_MIN_LEVEL RELLAF_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+namespace rellaf {
+
+struct LoggerOptions {
+    // file written, empty for stdout
+    std::string path;
+    // `path` renamed to `path`.1, `path`.1 to `path`.2 ... beyond, 0 never rotated
+    size_t rotate_bytes = 256 * 1024 * 1024;
+    // rotated files kept
+    int max_files = 5;
+    // lines queued but not written yet beyond are dropped
+    size_t max_pending = 1024 * 1024;
+};
+
+class Logger {
+public:
+    /**
+     * lives until process exit, the queue is drained at exit
+     */
+    static Logger& instance();
+
+    static inline bool enabled(int level) {
+        return level >= _s_level.load(std::memory_order_relaxed);
+    }
+
+    static void set_level(int level);
+
+    static inline int level() {
+        return _s_level.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief write to another destination since now, lines queued before may go either
+     */
+    bool open(const LoggerOptions& options);
+
+    /**
+     * @brief queue a formatted line, written as is
+     */
+    void submit(const std::string& line);
+
+    /**
+     * @brief block until lines queued before are written
+     */
+    void flush();
+
+    inline uint64_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Node {
+        std::string line;
+        Node* next = nullptr;
+        // flush marker if not null, owned by flushing thread
+        bool* done = nullptr;
+    };
+
+    Logger();
+
+    Logger(const Logger&) = delete;
+
+    Logger& operator=(const Logger&) = delete;
+
+    static void* run(void* arg);
+
+    static void stop_at_exit();
+
+    // drained by the pushing thread itself once stopped
+    void push(Node* node);
+
+    // write and free all nodes queued
+    void drain();
+
+    // write lines of nodes reversed from stack, mark flushes done, free nodes
+    void consume(Node* head, std::string& batch);
+
+    void write_batch(const std::string& batch);
+
+    void rotate();
+
+private:
+    static std::atomic<int> _s_level;
+
+    std::atomic<Node*> _head{nullptr};
+    std::atomic<size_t> _pending{0};
+    std::atomic<size_t> _max_pending{1024 * 1024};
+    std::atomic<uint64_t> _dropped{0};
+    std::atomic<bool> _stopped{false};
+    pthread_t _writer;
+    bool _stop = false;
+    pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t _cond = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t _flush_cond = PTHREAD_COND_INITIALIZER;
+
+    // guards destination
+    pthread_mutex_t _io_lock = PTHREAD_MUTEX_INITIALIZER;
+    LoggerOptions _options;
+    int _fd = 1;
+    size_t _file_bytes = 0;
+};
+
+/**
+ * one log line, formatted into thread local buffer, queued to Logger at destruction
+ */
+class LogStream {
+public:
+    LogStream(int level, const char* file, int line);
+
+    ~LogStream();
+
+    LogStream(const LogStream&) = delete;
+
+    LogStream& operator=(const LogStream&) = delete;
+
+    inline LogStream& operator<<(const std::string& val) {
+        _buf->append(val);
+        return *this;
+    }
+
+    inline LogStream& operator<<(const char* val) {
+        _buf->append(val == nullptr ? "(null)" : val);
+        return *this;
+    }
+
+    inline LogStream& operator<<(char val) {
+        _buf->push_back(val);
+        return *this;
+    }
+
+    template<typename T>
+    inline typename std::enable_if<
+            (std::is_integral<T>::value || std::is_enum<T>::value) && !std::is_same<T, char>::value,
+            LogStream&>::type operator<<(T val) {
+        if (std::is_signed<T>::value || std::is_enum<T>::value) {
+            append_int((int64_t)val);
+        } else {
+            append_uint((uint64_t)val);
+        }
+        return *this;
+    }
+
+    LogStream& operator<<(double val);
+
+    LogStream& operator<<(const void* val);
+
+    template<typename T>
+    inline LogStream& operator<<(const std::vector<T>& t) {
+        iter_list(t);
+        return *this;
+    }
+
+    template<typename T>
+    inline LogStream& operator<<(const std::deque<T>& t) {
+        iter_list(t);
+        return *this;
+    }
+
+    template<typename T>
+    inline LogStream& operator<<(const std::set<T>& t) {
+        iter_list(t);
+        return *this;
+    }
+
+    template<typename T>
+    inline LogStream& operator<<(const std::unordered_set<T>& t) {
+        iter_list(t);
+        return *this;
+    }
+
+    template<typename K, typename V>
+    inline LogStream& operator<<(const std::map<K, V>& t) {
+        iter_kv(t);
+        return *this;
+    }
+
+    template<typename K, typename V>
+    inline LogStream& operator<<(const std::unordered_map<K, V>& t) {
+        iter_kv(t);
+        return *this;
+    }
+
+    template<typename K, typename V>
+    inline LogStream& operator<<(const std::pair<K, V>& t) {
+        *this << "<" << t.first << "," << t.second << ">";
+        return *this;
+    }
+
+    template<typename T>
+    void iter_list(const T& t) {
+        *this << "[";
+        size_t i = 0;
+        for (auto iter = t.begin(); iter != t.end(); ++iter) {
+            *this << *iter;
+            if (i++ != t.size() - 1) {
+                *this << ",";
+            }
+        }
+        *this << "]";
+    }
+
+    template<typename T>
+    void iter_kv(const T& t) {
+        *this << "{";
+        size_t i = 0;
+        for (auto iter = t.begin(); iter != t.end(); ++iter) {
+            *this << "(" << iter->first << ":" << iter->second << ")";
+            if (i++ != t.size() - 1) {
+                *this << ",";
+            }
+        }
+        *this << "}";
+    }
+
+private:
+    void append_int(int64_t val);
+
+    void append_uint(uint64_t val);
+
+private:
+    int _level;
+    // thread local buffer, or `_own` if logging while formatting another line of this thread
+    std::string* _buf;
+    std::string _own;
+};
+
+// lower precedence than <<, makes the conditional of FLOG a void expression
+class LogVoidify {
+public:
+    inline void operator&(const LogStream&) {}
+};
+
+}
+
+#define RELLAF_LOG_IF(_level_)                                                                  \
+    !(RELLAF_LOG_LEVEL_##_level_ >= RELLAF_LOG_MIN_LEVEL &&                                     \
+            rellaf::Logger::enabled(RELLAF_LOG_LEVEL_##_level_)) ? (void)0 :                    \
+    rellaf::LogVoidify() & rellaf::LogStream(RELLAF_LOG_LEVEL_##_level_, __FILE__, __LINE__)
+
+#ifndef FLOG_DEBUG
+#define FLOG_DEBUG RELLAF_LOG_IF(DEBUG)
+#endif
+#define FLOG_INFO RELLAF_LOG_IF(INFO)
+#define FLOG_WARNING RELLAF_LOG_IF(WARNING)
+#define FLOG_ERROR RELLAF_LOG_IF(ERROR)
+// flushed before statement returns
+#define FLOG_FATAL RELLAF_LOG_IF(FATAL)
+#define FLOG(level)  FLOG_##level
@@ -20,9 +20,13 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include <set>
 #include <map>
 #include <deque>
+#include <vector>
+#include <atomic>
+#include <memory>
 #include <functional>
 #include <type_traits>
 #include "cast.hpp"
@@ -51,7 +55,7 @@ _clazz_& operator=(const _clazz_& o) {
 _clazz_& operator=(_clazz_&& o) noexcept {                                              \
     _type = o._type;                                                                    \
     assign(&o);                                                                         \
-    clear();                                                                            \
+    o.clear();                                                                          \
     return *this;                                                                       \
 }                                                                                       \
 inline std::string rellaf_name() const override { return #_clazz_; }                    \
@@ -65,103 +69,44 @@ inline void assign(const Model* val) override {
     if (rellaf_type() != val->rellaf_type()) {                                          \
         return;                                                                         \
     }                                                                                   \
-    _clazz_* ptr = (_clazz_*)val;                                                       \
-    _tag = ptr->rellaf_tag();                                                           \
-    for (auto& entry : _plains) {                                                       \
-        entry.second->assign(ptr->_plains[entry.first]);                                \
-    }                                                                                   \
-    for (auto& entry : _objects) {                                                      \
-        entry.second->assign(ptr->_objects[entry.first]);                               \
-    }                                                                                   \
-    for (auto& entry : _lists) {                                                        \
-        entry.second.assign(&(ptr->_lists[entry.first]));                               \
-    }                                                                                   \
+    assign_members((const Object*)val);                                                 \
 }                                                                                       \
 inline void clear() override {                                                          \
-    for (auto& entry : _plains) {                                                       \
-        entry.second->clear();                                                          \
-    }                                                                                   \
-    for (auto& entry : _objects) {                                                      \
-        entry.second->clear();                                                          \
-    }                                                                                   \
-    _objects.clear();                                                                   \
-    for (auto& entry : _lists) {                                                        \
-        entry.second.clear();                                                           \
-    }                                                                                   \
-    _lists.clear();                                                                     \
+    clear_members();                                                                    \
+}                                                                                       \
+static const ModelMeta& rellaf_class_meta() {                                           \
+    static const ModelMeta* meta = ModelMeta::build<_clazz_>();                         \
+    return *meta;                                                                       \
 }                                                                                       \
-static const std::map<std::string, Model*>& plain_names() {                             \
-    return _s_plain_names;                                                              \
+inline const ModelMeta& rellaf_meta() const override {                                  \
+    return rellaf_class_meta();                                                         \
+}                                                                                       \
+static MemberMap<Model*> plain_names() {                                                \
+    return rellaf_class_meta().defaults();                                              \
 }                                                                                       \
 static bool plain_concern(const std::string& key) {                                     \
-    return _s_plain_names.count(key) == 1;                                              \
+    return rellaf_class_meta().plain(key) != nullptr;                                   \
 }                                                                                       \
 static bool is_plain_default(const std::string& key, const std::string& val) {          \
-    auto entry = _s_plain_names.find(key);                                              \
-    if (entry != _s_plain_names.end()) {                                                \
-        return entry->second->equal_parse(val);                                         \
+    const ModelMeta& meta = rellaf_class_meta();                                        \
+    const ModelMeta::Member* member = meta.plain(key);                                  \
+    if (member != nullptr) {                                                            \
+        return ModelMeta::plain_of(meta.prototype(), *member)->equal_parse(val);        \
     }                                                                                   \
     return false;                                                                       \
 }                                                                                       \
-inline bool is_plain_member(const std::string& key) const override {                    \
-    return plain_concern(key);                                                          \
-}                                                                                       \
-inline bool set_plain(const std::string& key, const std::string& val_str) override {    \
-    auto entry = _s_plain_names.find(key);                                              \
-    if (entry == _s_plain_names.end()) { return false; }                                \
-    auto val_entry = _plains.find(key);                                                 \
-    if (val_entry != _plains.end()) {                                                   \
-        val_entry->second->set_parse(val_str);                                          \
-        return true;                                                                    \
-    }                                                                                   \
-    Model* plain = entry->second->create();                                             \
-    plain->set_parse(val_str);                                                          \
-    _plains.emplace(key, plain);                                                        \
-    return true;                                                                        \
-}                                                                                       \
-protected:                                                                              \
-static std::map<std::string, Model*> _s_plain_names;                                    \
 private:                                                                                \
-class Reg {                                                                             \
-public:                                                                                 \
-Reg(const std::string& name, _clazz_* inst, Model* val, Model* dft) {                   \
-    _clazz_::_s_plain_names.emplace(name, dft);                                         \
-    inst->_plains.emplace(name, val);                                                   \
-}                                                                                       \
-}
+typedef _clazz_ rellaf_self
 
 /////////////////////// type declaration //////////////////////
 
 #define rellaf_model_dcl(_clazz_)                                                       \
-RELLAF_MODEL_DCL_PLAIN(_clazz_);                                                        \
-private:                                                                                \
-class RegList {                                                                         \
-public:                                                                                 \
-    RegList(const std::string& name, _clazz_* inst) {                                   \
-        _clazz_::_s_list_names.emplace(name);                                           \
-        inst->_lists.emplace(name, List());                                             \
-    }                                                                                   \
-};                                                                                      \
-class RegObject {                                                                       \
-public:                                                                                 \
-    explicit RegObject(const std::string& name, _clazz_* inst) {                        \
-        _clazz_::_s_object_names.emplace(name);                                         \
-        inst->_objects.emplace(name, nullptr);                                          \
-    }                                                                                   \
-};                                                                                      \
-static std::set<std::string> _s_list_names;                                             \
-static std::set<std::string> _s_object_names
-
-/////////////////////// type definition without complex model ////////////////////
-#define RELLAF_MODEL_DEF_PLAIN(_clazz_)                                                 \
-std::map<std::string, Model*> _clazz_::_s_plain_names;                                  \
-static volatile _clazz_ _s_force_init_##_clazz_
+RELLAF_MODEL_DCL_PLAIN(_clazz_)
 
 /////////////////////// type definition ////////////////////
+// members are recorded at the first use of the class, nothing to define out of class
 #define rellaf_model_def(_clazz_)                                                       \
-std::set<std::string> _clazz_::_s_list_names;                                           \
-std::set<std::string> _clazz_::_s_object_names;                                         \
-RELLAF_MODEL_DEF_PLAIN(_clazz_)
+static_assert(std::is_base_of<rellaf::Object, _clazz_>::value, #_clazz_ " not Object")
 
 /////////////////////// basic ////////////////////
 // plain default
@@ -219,6 +164,19 @@ protected:
     std::string _tag;
 };
 
+/**
+ * @brief new a T, nullptr if T is abstract, used as creator of list items and object members
+ */
+template<class T>
+typename std::enable_if<!std::is_abstract<T>::value, Model*>::type create_model() {
+    return (Model*)new(std::nothrow) T;
+}
+
+template<class T>
+typename std::enable_if<std::is_abstract<T>::value, Model*>::type create_model() {
+    return nullptr;
+}
+
 class Void : public Model {
 public:
     Void() {
@@ -472,8 +430,74 @@ protected:
 };
 
 /////////////////////// model list ////////////////////
+/**
+ * Items are shared by copies of the list and by other lists they are pushed into,
+ * copy-on-write : the item storage is copied by the first mutation of a sharing list,
+ * an item is cloned by the first non-const access (`at`, `front`, `back`, iterator) while shared.
+ * Pointer got by non-const access is invalidated by copying the list.
+ */
 class List : public Model {
 public:
+    typedef std::deque<std::shared_ptr<Model>> Items;
+
+    /**
+     * read only iterator, item presented as const Model*, nullptr if item is null
+     */
+    class ConstIterator {
+    public:
+        explicit ConstIterator(Items::const_iterator iter) : _iter(iter) {}
+
+        inline const Model* operator*() const {
+            return _iter->get();
+        }
+
+        inline ConstIterator& operator++() {
+            ++_iter;
+            return *this;
+        }
+
+        inline bool operator==(const ConstIterator& o) const {
+            return _iter == o._iter;
+        }
+
+        inline bool operator!=(const ConstIterator& o) const {
+            return _iter != o._iter;
+        }
+
+    private:
+        Items::const_iterator _iter;
+    };
+
+    /**
+     * iterator of non-const list, item presented as Model*, nullptr if item is null,
+     * an item still shared is cloned when dereferenced, same as `at`
+     */
+    class Iterator {
+    public:
+        Iterator(List* list, size_t idx) : _list(list), _idx(idx) {}
+
+        inline Model* operator*() const {
+            return _list->mutable_item(_idx);
+        }
+
+        inline Iterator& operator++() {
+            ++_idx;
+            return *this;
+        }
+
+        inline bool operator==(const Iterator& o) const {
+            return _idx == o._idx;
+        }
+
+        inline bool operator!=(const Iterator& o) const {
+            return _idx != o._idx;
+        }
+
+    private:
+        List* _list;
+        size_t _idx;
+    };
+
     ~List() override;
 
     List();
@@ -496,17 +520,14 @@ public:
         return inst;
     }
 
+    /**
+     * @brief share items of `val`, O(1)
+     */
     inline void assign(const Model* val) override {
         if (rellaf_type() != val->rellaf_type()) {
             return;
         }
-
-        List* ptr = (List*) val;
-        clear();
-        for (auto& entry : ptr->_items) {
-            Model* m = entry->clone();
-            _items.push_back(m);
-        }
+        _items = ((const List*) val)->_items;
     }
 
     std::string debug_str() const override;
@@ -520,18 +541,26 @@ public:
     void push_front(Model* model);
 
     template<class T>
-    void push_front(const T& model) {
-        static_assert(std::is_base_of<Model, T>::value, "type not Model");
-        _items.push_front(model.clone());
+    typename std::enable_if<std::is_base_of<Model, T>::value>::type push_front(const T& model) {
+        mutable_items().emplace_front(model.clone());
     }
 
     // FIXME.. mac compile over write
     void push_back(Model* model);
 
+    /**
+     * @brief append `model` without clone, list takes the ownership
+     */
+    void emplace_back(Model* model);
+
+    /**
+     * @brief append `model` shared without clone, it MUST NOT be mutated by others after
+     */
+    void push_back(const std::shared_ptr<const Model>& model);
+
     template<class T>
-    void push_back(const T& model) {
-        static_assert(std::is_base_of<Model, T>::value, "type not Model");
-        _items.push_back(model.clone());
+    typename std::enable_if<std::is_base_of<Model, T>::value>::type push_back(const T& model) {
+        mutable_items().emplace_back(model.clone());
     }
 
     void pop_front();
@@ -541,25 +570,25 @@ public:
     template<class T=Model>
     T* front() {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        return (T*) (_items.front());
+        return (T*) mutable_item(0);
     }
 
     template<class T=Model>
     const T* front() const {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        return (T*) (_items.front());
+        return (T*) (_items->front().get());
     }
 
     template<class T=Model>
     T* back() {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        return (T*) _items.back();
+        return (T*) mutable_item(size() - 1);
     }
 
     template<class T=Model>
     const T* back() const {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        return (T*) _items.back();
+        return (T*) (_items->back().get());
     }
 
     void set(size_t idx, Model* model);
@@ -567,29 +596,50 @@ public:
     template<class T=Model>
     T* at(size_t idx) {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        if (idx >= _items.size()) {
+        if (idx >= size()) {
             return nullptr;
         }
-        return (T*) (_items.at(idx));
+        return (T*) mutable_item(idx);
     }
 
     template<class T=Model>
     const T* at(size_t idx) const {
         static_assert(std::is_base_of<Model, T>::value, "class not model");
-        if (idx >= _items.size()) {
+        if (idx >= size()) {
             return nullptr;
         }
-        return (T*) (_items.at(idx));
+        return (T*) ((*_items)[idx].get());
     }
 
+    /**
+     * @brief item shared without clone, to be pushed into another list
+     */
+    std::shared_ptr<const Model> share(size_t idx) const;
+
     const Model* operator[](size_t idx) const;
 
-    std::deque<Model*>::const_iterator begin() const;
+    ConstIterator begin() const;
 
-    std::deque<Model*>::const_iterator end() const;
+    ConstIterator end() const;
+
+    inline Iterator begin() {
+        return Iterator(this, 0);
+    }
+
+    inline Iterator end() {
+        return Iterator(this, size());
+    }
 
 private:
-    std::deque<Model*> _items;
+    // items owned by this list only, copied if shared
+    Items& mutable_items();
+
+    // item owned by this list only, cloned if shared
+    Model* mutable_item(size_t idx);
+
+private:
+    // nullptr if empty
+    std::shared_ptr<Items> _items;
 
 private:
     // hide method
@@ -608,6 +658,313 @@ private:
     }
 };
 
+class Object;
+
+template<class S>
+class MemberMap;
+
+/**
+ * source of members of an object not decoded yet, see `Object::set_lazy_source`
+ */
+class LazySource {
+public:
+    virtual ~LazySource() = default;
+
+    /**
+     * @brief decode member `name` into `obj` if it is pending
+     */
+    virtual void load(Object* obj, const std::string& name) = 0;
+
+    virtual void load_all(Object* obj) = 0;
+
+    /**
+     * @brief forget pending member `name` without decoding, it is overwritten
+     */
+    virtual void drop(const std::string& name) = 0;
+
+    /**
+     * @return if no member pending
+     */
+    virtual bool empty() const = 0;
+};
+
+/**
+ * members of a model class, recorded once from a prototype at the first use of the class
+ * and immutable then, so it is read without lock. Members are data members of the class,
+ * each one kept as offset from Object*, instances carry no member table.
+ */
+class ModelMeta {
+RELLAF_AVOID_COPY(ModelMeta)
+
+public:
+    struct Member {
+        std::string name;
+        ptrdiff_t offset;
+        // creator of list item or object member, nullptr for plain
+        Model* (*creator)();
+        // field id in binary codec, hashed from name, unique in the class, see model_binary.h
+        uint32_t id;
+    };
+
+    /**
+     * @brief record members of T from a prototype, which is kept for default values
+     */
+    template<class T>
+    static const ModelMeta* build() {
+        ModelMeta* meta = new ModelMeta;
+        void* mem = ::operator new(sizeof(T));
+        begin_record(meta, mem);
+        T* prototype = new(mem) T;
+        end_record(prototype);
+        return meta;
+    }
+
+    // members sorted by name
+    inline const std::vector<Member>& plains() const {
+        return _plains;
+    }
+
+    inline const std::vector<Member>& lists() const {
+        return _lists;
+    }
+
+    inline const std::vector<Member>& objects() const {
+        return _objects;
+    }
+
+    /**
+     * @return member named `name`, nullptr if not exist
+     */
+    inline const Member* plain(const std::string& name) const {
+        return find(_plains, name);
+    }
+
+    inline const Member* list(const std::string& name) const {
+        return find(_lists, name);
+    }
+
+    inline const Member* object(const std::string& name) const {
+        return find(_objects, name);
+    }
+
+    /**
+     * @return index of plain member `name` in `plains()`, -1 if not exist
+     */
+    inline int plain_index(const std::string& name) const {
+        const Member* member = plain(name);
+        return member == nullptr ? -1 : (int)(member - _plains.data());
+    }
+
+    /**
+     * @brief instance holding default values of members
+     */
+    inline const Object* prototype() const {
+        return _prototype;
+    }
+
+    MemberMap<Model*> defaults() const;
+
+    /**
+     * @return member named `name` in sorted `members`, nullptr if not exist
+     */
+    static const Member* find(const std::vector<Member>& members, const std::string& name);
+
+    static inline Model* plain_of(const Object* obj, const Member& member) {
+        return (Model*)((const char*)obj + member.offset);
+    }
+
+    static inline List* list_of(const Object* obj, const Member& member) {
+        return (List*)((const char*)obj + member.offset);
+    }
+
+    static inline std::shared_ptr<Object>* object_of(const Object* obj, const Member& member) {
+        return (std::shared_ptr<Object>*)((const char*)obj + member.offset);
+    }
+
+private:
+    friend class MemberReg;
+
+    ModelMeta() = default;
+
+    static void begin_record(ModelMeta* meta, const void* prototype);
+
+    static void end_record(Object* prototype);
+
+    static inline bool recording(const void* inst) {
+        return _s_recording.load(std::memory_order_relaxed) == inst;
+    }
+
+    static void record(std::vector<Member> ModelMeta::* members, const Object* inst,
+            const char* name, const void* member, Model* (*creator)());
+
+private:
+    std::vector<Member> _plains;
+    std::vector<Member> _lists;
+    std::vector<Member> _objects;
+    Object* _prototype = nullptr;
+
+    // address of prototype under construction, members of it are recorded into `_s_building`
+    static std::atomic<const void*> _s_recording;
+    static ModelMeta* _s_building;
+};
+
+/**
+ * declared beside each member by `rellaf_model_def_xxx`, records the member
+ * only while the prototype of class is constructed, otherwise does nothing
+ */
+class MemberReg {
+public:
+    template<class C>
+    MemberReg(C* inst, const char* name, Model* plain) {
+        if (ModelMeta::recording(inst)) {
+            ModelMeta::record(&ModelMeta::_plains, inst, name, plain, nullptr);
+        }
+    }
+
+    template<class C>
+    MemberReg(C* inst, const char* name, List* list, Model* (*creator)()) {
+        if (ModelMeta::recording(inst)) {
+            ModelMeta::record(&ModelMeta::_lists, inst, name, list, creator);
+        }
+    }
+
+    template<class C>
+    MemberReg(C* inst, const char* name, std::shared_ptr<Object>* object, Model* (*creator)()) {
+        if (ModelMeta::recording(inst)) {
+            ModelMeta::record(&ModelMeta::_objects, inst, name, object, creator);
+        }
+    }
+};
+
+// value of member at `addr` presented by MemberMap
+template<class S>
+struct MemberCast;
+
+template<>
+struct MemberCast<Model*> {
+    static inline Model* get(const char* addr) {
+        return (Model*)addr;
+    }
+};
+
+template<>
+struct MemberCast<List&> {
+    static inline List& get(const char* addr) {
+        return *(List*)addr;
+    }
+};
+
+template<>
+struct MemberCast<const List&> {
+    static inline const List& get(const char* addr) {
+        return *(const List*)addr;
+    }
+};
+
+template<>
+struct MemberCast<const Object*> {
+    static inline const Object* get(const char* addr) {
+        return ((const std::shared_ptr<Object>*)addr)->get();
+    }
+};
+
+// object still shared is cloned, defined after Object
+template<>
+struct MemberCast<Object*> {
+    static inline Object* get(const char* addr);
+};
+
+/**
+ * read only map like view of one kind of members of an instance, in name order,
+ * entry is {first : name, second : member}. An entry got from iterator is valid
+ * until the iterator moves.
+ */
+template<class S>
+class MemberMap {
+public:
+    struct Entry {
+        const std::string& first;
+        S second;
+    };
+
+    class Iterator {
+    public:
+        Iterator(const ModelMeta::Member* member, const char* base) :
+                _member(member), _base(base) {}
+
+        Iterator(const Iterator& o) : _member(o._member), _base(o._base) {}
+
+        Iterator& operator=(const Iterator& o) {
+            _member = o._member;
+            _base = o._base;
+            return *this;
+        }
+
+        inline const Entry& operator*() const {
+            new(&_entry) Entry{_member->name, MemberCast<S>::get(_base + _member->offset)};
+            return *(const Entry*)&_entry;
+        }
+
+        inline const Entry* operator->() const {
+            return &(operator*());
+        }
+
+        inline Iterator& operator++() {
+            ++_member;
+            return *this;
+        }
+
+        inline bool operator==(const Iterator& o) const {
+            return _member == o._member;
+        }
+
+        inline bool operator!=(const Iterator& o) const {
+            return _member != o._member;
+        }
+
+    private:
+        const ModelMeta::Member* _member;
+        const char* _base;
+        mutable typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type _entry;
+    };
+
+    typedef std::string key_type;
+    typedef Iterator iterator;
+    typedef Iterator const_iterator;
+
+    MemberMap(const std::vector<ModelMeta::Member>& members, const Object* base) :
+            _members(members), _base((const char*)base) {}
+
+    inline Iterator begin() const {
+        return Iterator(_members.data(), _base);
+    }
+
+    inline Iterator end() const {
+        return Iterator(_members.data() + _members.size(), _base);
+    }
+
+    inline Iterator find(const std::string& name) const {
+        const ModelMeta::Member* member = ModelMeta::find(_members, name);
+        return member == nullptr ? end() : Iterator(member, _base);
+    }
+
+    inline size_t count(const std::string& name) const {
+        return find(name) == end() ? 0 : 1;
+    }
+
+    inline size_t size() const {
+        return _members.size();
+    }
+
+    inline bool empty() const {
+        return _members.empty();
+    }
+
+private:
+    const std::vector<ModelMeta::Member>& _members;
+    const char* _base;
+};
+
 /////////////////////// base model class ////////////////////
 class Object : public Model {
 public:
@@ -629,66 +986,206 @@ public:
 
     virtual std::string debug_str() const override;
 
-    virtual bool is_plain_member(const std::string& key) const = 0;
+    /**
+     * @brief members of class, built at the first call
+     */
+    virtual const ModelMeta& rellaf_meta() const = 0;
+
+    inline bool is_plain_member(const std::string& key) const {
+        return rellaf_meta().plain(key) != nullptr;
+    }
+
+    /**
+     * @brief parse `val_str` into plain member `key`
+     * @return false if `key` not a plain member
+     */
+    bool set_plain(const std::string& key, const std::string& val_str);
 
-    virtual bool set_plain(const std::string& key, const std::string& val_str) = 0;
+    /**
+     * @brief new an item of list member `name`, nullptr if not exist
+     */
+    Model* create_list_item(const std::string& name) const;
+
+    /**
+     * @brief new an object of object member `name`, nullptr if not exist
+     */
+    Object* create_object(const std::string& name) const;
 
     template<class T>
     Plain<T>* get_plain(const std::string& key) {
-        if (!is_plain_member(key)) {
-            return nullptr;
-        }
-        return (Plain<T>*) (_plains.find(key)->second);
+        return (Plain<T>*)get_plain(key);
     }
 
     template<class T>
     const Plain<T>* get_plain(const std::string& key) const {
-        if (!is_plain_member(key)) {
-            return nullptr;
-        }
-        return (Plain<T>*) (_plains.find(key)->second);
+        return (const Plain<T>*)get_plain(key);
     }
 
     Model* get_plain(const std::string& key);
 
     const Model* get_plain(const std::string& key) const;
 
-    inline const std::map<std::string, Model*>& get_plains() const {
-        return _plains;
+    /**
+     * @brief if plain member `key` changed by its setter or `set_plain`
+     *        since constructed, cleared or `clear_dirty`, copied along with values
+     */
+    bool is_dirty(const std::string& key) const;
+
+    /**
+     * @brief dirty flag of plain member at `idx` of `rellaf_meta().plains()`
+     */
+    inline bool is_dirty(size_t idx) const {
+        if (idx < 64) {
+            return (_dirty & (1ULL << idx)) != 0;
+        }
+        idx -= 64;
+        return idx / 64 < _dirty_more.size() &&
+               (_dirty_more[idx / 64] & (1ULL << (idx % 64))) != 0;
+    }
+
+    inline void mark_dirty(size_t idx) {
+        if (idx < 64) {
+            _dirty |= 1ULL << idx;
+        } else {
+            mark_dirty_more(idx - 64);
+        }
+    }
+
+    bool has_dirty() const;
+
+    void clear_dirty();
+
+    inline MemberMap<Model*> get_plains() const {
+        lazy_load_all();
+        return MemberMap<Model*>(rellaf_meta().plains(), this);
     }
 
     inline bool is_object_member(const std::string& name) const {
-        return _objects.count(name) != 0;
+        return rellaf_meta().object(name) != nullptr;
     }
 
-    inline const std::map<std::string, Object*>& get_objects() const {
-        return _objects;
+    /**
+     * @brief an object member still shared is cloned when got from the map, same as accessors
+     */
+    inline MemberMap<Object*> get_objects() {
+        lazy_load_all();
+        return MemberMap<Object*>(rellaf_meta().objects(), this);
+    }
+
+    inline MemberMap<const Object*> get_objects() const {
+        lazy_load_all();
+        return MemberMap<const Object*>(rellaf_meta().objects(), this);
     }
 
     Object* get_object(const std::string& name);
 
     const Object* get_object(const std::string& name) const;
 
+    /**
+     * @brief replace object member `name` by `val`, which is owned then, old one deleted
+     * @return false if `name` not a object member
+     */
+    bool reset_object(const std::string& name, Object* val);
+
     inline bool is_list_member(const std::string& name) const {
-        return _lists.count(name) != 0;
+        return rellaf_meta().list(name) != nullptr;
     }
 
-    inline std::map<std::string, List>& get_lists() {
-        return _lists;
+    inline MemberMap<List&> get_lists() {
+        lazy_load_all();
+        return MemberMap<List&>(rellaf_meta().lists(), this);
     }
 
-    inline const std::map<std::string, List>& get_lists() const {
-        return _lists;
+    inline MemberMap<const List&> get_lists() const {
+        lazy_load_all();
+        return MemberMap<const List&>(rellaf_meta().lists(), this);
     }
 
+    /**
+     * @brief list member `name`, throw std::out_of_range if not exist
+     */
     List& get_list(const std::string& name);
 
     const List& get_list(const std::string& name) const;
 
+    /**
+     * @brief members are decoded from `source` at their first access, such as accessors,
+     *        `get_plain` or `get_plains`, `source` is owned then and released once all decoded.
+     *        Lazy object is not thread safe until all members loaded.
+     */
+    void set_lazy_source(LazySource* source);
+
+    inline bool is_lazy() const {
+        return _lazy != nullptr;
+    }
+
 protected:
-    std::map<std::string, Model*> _plains;
-    std::map<std::string, List> _lists;
-    std::map<std::string, Object*> _objects;
+    inline void lazy_load(const std::string& name) const {
+        if (_lazy) {
+            lazy_load_member(name);
+        }
+    }
+
+    // overloads for member names of accessors, no string built unless lazy
+    inline void lazy_load(const char* name) const {
+        if (_lazy) {
+            lazy_load_member(name);
+        }
+    }
+
+    inline void lazy_drop(const char* name) const {
+        if (_lazy) {
+            lazy_drop_member(name);
+        }
+    }
+
+    inline void lazy_load_all() const {
+        if (_lazy) {
+            lazy_load_members();
+        }
+    }
+
+    inline void lazy_drop(const std::string& name) const {
+        if (_lazy) {
+            lazy_drop_member(name);
+        }
+    }
+
+    // copy members from `val` of the same class, objects and lists are shared
+    void assign_members(const Object* val);
+
+    void clear_members();
+
+    /**
+     * @brief object owned by this only, cloned if shared
+     */
+    static inline Object* mutable_object(std::shared_ptr<Object>& object) {
+        if (object != nullptr && object.use_count() > 1) {
+            object.reset((Object*)object->clone());
+        }
+        return object.get();
+    }
+
+protected:
+    // nullptr unless lazy, detached while loading so accessors called by source do not recurse
+    mutable std::unique_ptr<LazySource> _lazy;
+
+private:
+    friend struct MemberCast<Object*>;
+    friend class FieldBinder;
+
+    void lazy_load_member(const std::string& name) const;
+
+    void lazy_load_members() const;
+
+    void lazy_drop_member(const std::string& name) const;
+
+    void mark_dirty_more(size_t idx);
+
+private:
+    // bit i for plain member i of `rellaf_meta().plains()`, members from the 64th in `_dirty_more`
+    uint64_t _dirty = 0;
+    std::vector<uint64_t> _dirty_more;
 
 private:
     // hide method
@@ -707,22 +1204,30 @@ private:
     }
 };
 
+inline Object* MemberCast<Object*>::get(const char* addr) {
+    return Object::mutable_object(*(std::shared_ptr<Object>*)addr);
+}
+
 /////////////////////// definition method ////////////////////
 #define RELLAF_MODEL_DEF_type(_type_, _sign_, _name_, _dft_)                            \
 public:                                                                                 \
     _type_ _name_() const {                                                             \
+        lazy_load(#_name_);                                                             \
         return _plain_##_name_.value();                                                 \
     }                                                                                   \
     void set_##_name_(const _type_& val) {                                              \
+        lazy_drop(#_name_);                                                             \
+        static const int idx = rellaf_class_meta().plain_index(#_name_);                \
+        mark_dirty((size_t)idx);                                                        \
         return _plain_##_name_.set(val);                                                \
     }                                                                                   \
     _type_ _name_##_default() const {                                                   \
-        return ((Plain<_type_>*)(_s_plain_names[#_name_]))->value();                    \
+        return ((const rellaf_self*)rellaf_class_meta().prototype())                    \
+                ->_plain_##_name_.value();                                              \
     }                                                                                   \
 private:                                                                                \
     Plain<_type_> _plain_##_name_{_dft_};                                               \
-    Plain<_type_> _plain_##_name_##_dft{_dft_};                                         \
-    Reg _reg_##_name_{#_name_, this, (Model*)(&_plain_##_name_), (Model*)(&_plain_##_name_##_dft)}
+    MemberReg _reg_##_name_{this, #_name_, &_plain_##_name_}
 
 #define rellaf_model_def_char(_name_, _dft_) RELLAF_MODEL_DEF_type(char, char, _name_, _dft_)
 #define rellaf_model_def_int16(_name_, _dft_) RELLAF_MODEL_DEF_type(int16_t, int16, _name_, _dft_)
@@ -739,42 +1244,51 @@ private:
 #define rellaf_model_def_object(_name_, _type_)                         \
 public:                                                                 \
     inline _type_* _name_() {                                           \
-        return (_type_*)get_object(#_name_);                            \
+        lazy_load(#_name_);                                             \
+        return (_type_*)mutable_object(_object_##_name_);               \
+    }                                                                   \
+    inline const _type_* _name_() const {                               \
+        lazy_load(#_name_);                                             \
+        return (const _type_*)_object_##_name_.get();                   \
     }                                                                   \
-    inline _type_* _name_() const {                                     \
-        return (_type_*)get_object(#_name_);                            \
+    inline std::shared_ptr<const _type_> _name_##_shared() const {      \
+        lazy_load(#_name_);                                             \
+        return std::static_pointer_cast<const _type_>(_object_##_name_);\
     }                                                                   \
     inline void set_##_name_(_type_* val) {                             \
-        auto entry = _objects.find(#_name_);                            \
-        if (entry != _objects.end()) {                                  \
-            delete entry->second;                                       \
-            entry->second = nullptr;                                    \
-            if (val != nullptr) {                                       \
-                entry->second = (Object*)val->clone();                  \
-            }                                                           \
-        } else {                                                        \
-            if (val != nullptr) {                                       \
-                _objects.emplace(#_name_, (Object*)val->clone());       \
-            } else {                                                    \
-                _objects.emplace(#_name_, nullptr);                     \
-            }                                                           \
-        }                                                               \
+        lazy_drop(#_name_);                                             \
+        Object* obj = val == nullptr ? nullptr : (Object*)val->clone(); \
+        _object_##_name_.reset(obj);                                    \
+    }                                                                   \
+    inline void set_##_name_(const std::shared_ptr<const _type_>& val) {\
+        lazy_drop(#_name_);                                             \
+        _object_##_name_ = std::static_pointer_cast<Object>(           \
+                std::const_pointer_cast<_type_>(val));                  \
     }                                                                   \
 private:                                                                \
-    RegObject _reg_##_name_##_object{#_name_, this}
+    std::shared_ptr<Object> _object_##_name_;                           \
+    MemberReg _reg_##_name_##_object{this, #_name_, &_object_##_name_,  \
+            &create_model<_type_>}
 
 
 #define rellaf_model_def_list(_name_, _type_)                           \
 public:                                                                 \
     inline List& _name_() {                                             \
-        return get_list(#_name_);                                       \
+        lazy_load(#_name_);                                             \
+        return _list_##_name_;                                          \
+    }                                                                   \
+    inline const List& _name_() const {                                 \
+        lazy_load(#_name_);                                             \
+        return _list_##_name_;                                          \
     }                                                                   \
     inline const ModelType& _name_##_list_type() const {                \
-        return _name_##_type.rellaf_type();                             \
+        static const _type_ item;                                       \
+        return item.rellaf_type();                                      \
     }                                                                   \
 private:                                                                \
-    RegList _reg_##_name_##_list{#_name_, this};                        \
-    _type_ _name_##_type
+    List _list_##_name_;                                                \
+    MemberReg _reg_##_name_##_list{this, #_name_, &_list_##_name_,      \
+            &create_model<_type_>}
 
 bool is_plain(const Model* model);
 
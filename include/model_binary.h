@@ -0,0 +1,54 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// compact binary codec of model
+//
+// Object is a sequence of fields, each one is a varint key `(field id << 3) | wire type`
+// followed by the value, in member name order, plains first, then lists, then objects.
+// Field ids are 18 bits hashed from member names (`ModelMeta::Member::id`), so members
+// added or removed on one side do not renumber others, unknown fields are skipped and
+// missing ones keep their values. Member renamed is another field, type changed to
+// another wire type fails the decoding.
+// wire types:
+//   0 varint, unsigned, zigzag signed, bool, also marks null object member
+//   1 fixed 64 bits, double
+//   2 length prefixed, string, list, object
+//   5 fixed 32 bits, float
+// List is varint count of items, each item is varint (length + 1) then item value,
+// length 0 means null item.
+
+#pragma once
+
+#include <string>
+#include "model.h"
+
+namespace rellaf {
+
+/**
+ * @brief encode model, `buf` is appended
+ */
+bool model_to_binary(const Model* model, std::string& buf);
+
+/**
+ * @brief decode into `model`, which has the same class of encoded one,
+ *        members present in buffer are overwritten, lists replaced
+ * @return false if buffer malformed, `model` may be partially decoded
+ */
+bool binary_to_model(const std::string& buf, Model* model);
+
+bool binary_to_model(const char* buf, size_t len, Model* model);
+
+}
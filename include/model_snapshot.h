@@ -0,0 +1,188 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// columnar snapshot file of models of one class
+//
+// File layout, all integers in host byte order, every region 8 bytes aligned:
+//   header     magic "RLFSNAP1", uint32 version, uint32 column count,
+//              uint64 row count, uint64 directory offset
+//   columns    fixed width column : row count values
+//              str column : uint64 offsets[row count + 1], then bytes of all values
+//   directory  per column : uint16 name length, name, uint8 type code,
+//              uint64 data offset, uint64 data length, uint64 bytes offset, uint64 bytes length
+// Only plain members are stored, one column each, in name order.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <typeinfo>
+#include "common.h"
+#include "model.h"
+
+namespace rellaf {
+
+/**
+ * writes models of one class into a snapshot file, row by row.
+ * Each column is spooled to its own unlinked temporary file beside `path`,
+ * so memory used does not grow with rows, columns are concatenated by `finish`,
+ * then the file is renamed to `path`, readers never see a partial snapshot.
+ */
+class SnapshotWriter {
+RELLAF_AVOID_COPY(SnapshotWriter)
+
+public:
+    SnapshotWriter() = default;
+
+    virtual ~SnapshotWriter();
+
+    /**
+     * @brief start a snapshot of class of `prototype`
+     */
+    bool open(const std::string& path, const Object* prototype);
+
+    /**
+     * @brief append a row, `obj` MUST be the same class of prototype
+     */
+    bool append(const Object* obj);
+
+    /**
+     * @brief append all non-null items of `list`
+     */
+    bool append(const List& list);
+
+    /**
+     * @brief write file and rename to path
+     */
+    bool finish();
+
+    inline uint64_t row_count() const {
+        return _row_count;
+    }
+
+private:
+    struct Column {
+        std::string name;
+        int code = 0;
+        size_t width = 0;
+        // fixed width values, or end offsets of str values
+        FILE* data = nullptr;
+        // bytes of str values
+        FILE* bytes = nullptr;
+        uint64_t bytes_len = 0;
+    };
+
+    FILE* spool(size_t idx, const char* kind);
+
+    void reset();
+
+private:
+    std::string _path;
+    const std::type_info* _type = nullptr;
+    std::vector<Column> _columns;
+    uint64_t _row_count = 0;
+    bool _failed = false;
+};
+
+/**
+ * read only view of a snapshot file mapped into memory, values are read in place,
+ * nothing is deserialized until asked. Thread safe after opened.
+ */
+class SnapshotView {
+RELLAF_AVOID_COPY(SnapshotView)
+
+public:
+    SnapshotView() = default;
+
+    virtual ~SnapshotView();
+
+    bool open(const std::string& path);
+
+    void close();
+
+    inline uint64_t row_count() const {
+        return _row_count;
+    }
+
+    inline size_t column_count() const {
+        return _columns.size();
+    }
+
+    /**
+     * @return index of column, -1 if not exist
+     */
+    int column(const std::string& name) const;
+
+    inline const std::string& column_name(size_t col) const {
+        return _columns[col].name;
+    }
+
+    /**
+     * @return ModelTypeEnum code of column
+     */
+    inline int column_code(size_t col) const {
+        return _columns[col].code;
+    }
+
+    /**
+     * @return contiguous values of a fixed width column, nullptr if type of column not T
+     */
+    template<class T>
+    const T* values(size_t col) const {
+        if (col >= _columns.size() || _columns[col].code != code_of<T>()) {
+            return nullptr;
+        }
+        return (const T*)(_base + _columns[col].data_off);
+    }
+
+    /**
+     * @brief value of a str column in place, `len` bytes from `data`, not null terminated
+     */
+    bool str(size_t col, uint64_t row, const char*& data, size_t& len) const;
+
+    /**
+     * @brief copy a row into plain members of `obj` with the same name and type
+     */
+    bool to_model(uint64_t row, Object* obj) const;
+
+private:
+    struct Column {
+        std::string name;
+        int code = 0;
+        uint64_t data_off = 0;
+        uint64_t data_len = 0;
+        uint64_t bytes_off = 0;
+        uint64_t bytes_len = 0;
+    };
+
+    template<class T>
+    static int code_of() {
+        static const int code = Plain<T>().rellaf_type().code;
+        return code;
+    }
+
+    bool parse();
+
+private:
+    const char* _base = nullptr;
+    size_t _size = 0;
+    uint64_t _row_count = 0;
+    std::vector<Column> _columns;
+};
+
+}
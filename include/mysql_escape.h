@@ -35,9 +35,16 @@ typedef size_t (* mbcharlen_func)(unsigned char c);
 
 class SqlEscape {
 public:
+    /**
+     * @brief one instance per encoding
+     */
     static SqlEscape& instance(const std::string& encode) {
-        static SqlEscape sqlescape(encode);
-        return sqlescape;
+        if (strcasecmp(encode.c_str(), "GBK") == 0) {
+            static SqlEscape gbk(encode);
+            return gbk;
+        }
+        static SqlEscape utf8(encode);
+        return utf8;
     }
 
     /**
@@ -54,8 +61,7 @@ public:
     size_t escape_field(const std::string& from, char* to);
 
     /**
-     * auto detect string length version
-     * TODO... test
+     * auto detect string length version, `out` MUST NOT be `field`
      */
     bool escape_field(const std::string& field, std::string& out);
 
@@ -0,0 +1,178 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// cpu time, wall time and heap allocations of request phases
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "common.h"
+
+namespace rellaf {
+
+/**
+ * cost of each phase of requests, accounted by thread local counters without lock,
+ * summed over threads by `snapshot`. Disabled by default, a disabled scope costs one load.
+ * Phases nest, e.g. sql phases are also accounted in the enclosing handler phase.
+ * Heap allocations are counted only if built with `RELLAF_ALLOC_STATS`(cmake WITH_ALLOC_STATS),
+ * which replaces global operator new and delete.
+ */
+class PhaseStats {
+public:
+    enum Phase {
+        // path to handler
+        ROUTE = 0,
+        // query params, path vars and body decoded
+        ARGS,
+        HANDLER,
+        // return model to body
+        SERIALIZE,
+        // sql rendered from pattern and models
+        SQL_RENDER,
+        // executor called, including result cache and single flight
+        DB_WAIT,
+        // rows to models
+        RESULT_DECODE,
+        PHASE_COUNT
+    };
+
+    struct Snapshot {
+        uint64_t count[PHASE_COUNT] = {0};
+        uint64_t cpu_ns[PHASE_COUNT] = {0};
+        uint64_t wall_ns[PHASE_COUNT] = {0};
+        uint64_t allocs[PHASE_COUNT] = {0};
+        uint64_t alloc_bytes[PHASE_COUNT] = {0};
+
+        std::string str() const;
+
+        std::string json() const;
+    };
+
+    // begin of a measured scope
+    struct Mark {
+        pthread_t thread{};
+        uint64_t cpu_ns = 0;
+        uint64_t cycles = 0;
+        uint64_t allocs = 0;
+        uint64_t alloc_bytes = 0;
+    };
+
+    static const char* name(Phase phase);
+
+    static inline bool enabled() {
+        return _s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static void set_enabled(bool enabled);
+
+    /**
+     * @brief if heap allocations are counted
+     */
+    static bool alloc_tracked();
+
+    static void begin(Mark& mark);
+
+    /**
+     * @brief account cost since `mark` into `phase`, dropped if called on another thread
+     */
+    static void end(Phase phase, const Mark& mark);
+
+    static void snapshot(Snapshot& snapshot);
+
+    static void reset();
+
+    /**
+     * @brief snapshot of all phases, as text lines or json
+     */
+    static std::string dump(bool json = false);
+
+    /**
+     * @brief cpu time of calling thread
+     */
+    static inline uint64_t thread_cpu_ns() {
+        struct timespec tspec;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tspec);
+        return (uint64_t)tspec.tv_sec * 1000000000 + tspec.tv_nsec;
+    }
+
+    /**
+     * @brief time stamp counter, monotonic ns if not x86
+     */
+    static inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec tspec;
+        clock_gettime(CLOCK_MONOTONIC, &tspec);
+        return (uint64_t)tspec.tv_sec * 1000000000 + tspec.tv_nsec;
+#endif
+    }
+
+    /**
+     * @brief calibrated once against CLOCK_MONOTONIC
+     */
+    static double cycles_per_ns();
+
+private:
+    static std::atomic<bool> _s_enabled;
+};
+
+/**
+ * accounts cost of calling thread from construction to destruction into `phase`,
+ * dropped if the scope resumed on another thread, such as a bthread switched worker.
+ */
+class PhaseScope {
+RELLAF_AVOID_COPY(PhaseScope)
+
+public:
+    explicit PhaseScope(PhaseStats::Phase phase) : _phase(phase), _on(PhaseStats::enabled()) {
+        if (_on) {
+            PhaseStats::begin(_mark);
+        }
+    }
+
+    ~PhaseScope() {
+        if (_on) {
+            PhaseStats::end(_phase, _mark);
+        }
+    }
+
+    /**
+     * @brief account cost so far into current phase, then measure `phase`
+     */
+    void next(PhaseStats::Phase phase) {
+        if (_on) {
+            PhaseStats::end(_phase, _mark);
+            PhaseStats::begin(_mark);
+        }
+        _phase = phase;
+    }
+
+private:
+    PhaseStats::Phase _phase;
+    bool _on;
+    PhaseStats::Mark _mark;
+};
+
+}
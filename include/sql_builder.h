@@ -21,6 +21,7 @@
 #pragma once
 
 #include <string.h>
+#include <set>
 #include <map>
 #include <deque>
 #include <memory>
@@ -33,6 +34,10 @@
 #include "model_type.h"
 #include "mysql_escape.h"
 #include "mysql/sql_executor.h"
+#include "sql_single_flight.h"
+#include "sql_sharded_executor.h"
+#include "sql_result_cache.h"
+#include "phase_stats.h"
 
 // TODO... basic type as args
 
@@ -41,8 +46,30 @@ namespace rellaf {
 class SqlBuilder {
 
 public:
+    /**
+     * @brief executor of all builders not bound to their own
+     */
     static void set_executor(SqlExecutor* executor);
 
+    /**
+     * @brief executor of this builder only, nullptr to follow `set_executor`
+     */
+    void bind_executor(SqlExecutor* executor) {
+        _bound_executor = executor;
+    }
+
+    SqlExecutor* executor() const {
+        return _bound_executor != nullptr ? _bound_executor : _executor;
+    }
+
+    /**
+     * @brief member of bound models as key of `ShardedExecutor`, sections like placeholders,
+     *        e.g. `id`, or `user.id` if more than one model
+     */
+    void set_shard_key(const std::string& section) {
+        _shard_key = section;
+    }
+
     class Charset : public Enum {
     rellaf_enum_dcl(Charset);
 
@@ -56,6 +83,21 @@ public:
         _charset = charset;
     }
 
+    /**
+     * @brief if enabled, concurrent selects with the same rendered sql share one query,
+     *        every caller still gets its own decoded models
+     */
+    void set_single_flight(bool enable) {
+        _single_flight = enable;
+    }
+
+    /**
+     * @brief if enabled, selects of this builder skip replicas of `ReadWriteExecutor`
+     */
+    void set_force_primary(bool enable) {
+        _force_primary = enable;
+    }
+
 protected:
     class Reg {
     public:
@@ -70,6 +112,22 @@ protected:
 
             inst->_patterns.emplace(method, pattern);
             inst->_pices.emplace(method, pices);
+            parse_tables(pattern, inst->_tables[method]);
+        }
+    };
+
+    class UpdateReg {
+    public:
+        UpdateReg(SqlBuilder* inst, const std::string& method, const std::string& table) {
+            inst->_update_tables.emplace(method, table);
+            parse_tables("UPDATE " + table, inst->_tables[method]);
+        }
+    };
+
+    class CacheReg {
+    public:
+        CacheReg(SqlBuilder* inst, const std::string& method, SqlResultCache* cache) {
+            inst->_caches[method].reset(cache);
         }
     };
 
@@ -81,6 +139,42 @@ protected:
         models.emplace(arg.rellaf_tag(), &arg);
     }
 
+    /**
+     * @return value of shard key member of `args`, empty if not set or not found
+     */
+    template<class ...Args>
+    std::string shard_value(const Args& ...args) {
+        if (_shard_key.empty()) {
+            return "";
+        }
+        std::map<std::string, const Model*> models;
+        bool arr[] = {(collect_models(models, args), true)...}; // for arguments expansion
+        (void) (arr);// suppress warning
+
+        std::deque<std::string> sections;
+        split_section(_shard_key, sections);
+        if (sections.empty() || models.empty()) {
+            return "";
+        }
+        const Model* model = models.begin()->second;
+        if (sizeof...(args) > 1) {
+            auto entry = models.find(sections.front());
+            if (entry == models.end()) {
+                RELLAF_DEBUG("no shard key model name : %s", sections.front().c_str());
+                return "";
+            }
+            model = entry->second;
+            sections.pop_front();
+        }
+        std::string val;
+        bool need_quote = false;
+        bool need_escape = false;
+        if (!get_plain_val(model, sections, val, need_quote, need_escape)) {
+            return "";
+        }
+        return val;
+    }
+
     template<class ...Args>
     bool prepare_statement(const std::string& method, std::string& sql, const Args& ...args) {
         sql.clear();
@@ -169,16 +263,20 @@ protected:
         if (sql == nullptr) {
             sql = &sql_inner;
         }
+        PhaseScope phase(PhaseStats::SQL_RENDER);
         if (!prepare_statement(method, *sql, args...)) {
             return -1;
         }
-        if (sql == &sql_inner && _executor != nullptr) {
-            std::unique_ptr<SqlResult> res(_executor->select(*sql));
+        if (sql == &sql_inner && executor() != nullptr) {
+            phase.next(PhaseStats::DB_WAIT);
+            ShardedExecutor::ShardKey shard(shard_value(args...));
+            std::unique_ptr<SqlResult> res(select_result(method, *sql));
             if (res == nullptr) {
                 RELLAF_DEBUG("select impl action failed");
                 return -1;
             }
 
+            phase.next(PhaseStats::RESULT_DECODE);
             if (res->next()) {
                 if (!res->to_model((Model*) &ret)) {
                     return -1;
@@ -194,16 +292,20 @@ protected:
             std::is_base_of<Model, Ret>::value || std::is_same<std::string, Ret>::value, int>::type
     select_list_impl(const std::string& method, RetList& ret_list, const Args& ...args) {
         std::string sql;
+        PhaseScope phase(PhaseStats::SQL_RENDER);
         if (!prepare_statement(method, sql, args...)) {
             return -1;
         }
-        if (_executor != nullptr) {
-            std::unique_ptr<SqlResult> res(_executor->select(sql));
+        if (executor() != nullptr) {
+            phase.next(PhaseStats::DB_WAIT);
+            ShardedExecutor::ShardKey shard(shard_value(args...));
+            std::unique_ptr<SqlResult> res(select_result(method, sql));
             if (res == nullptr) {
                 RELLAF_DEBUG("select impl action failed");
                 return -1;
             }
 
+            phase.next(PhaseStats::RESULT_DECODE);
             while (res->next()) {
                 Ret ret;
                 if (!res->to_model((Model*) &ret)) {
@@ -220,16 +322,20 @@ protected:
     typename std::enable_if<std::is_arithmetic<Ret>::value, int>::type
     select_list_impl(const std::string& method, RetList& ret_list, const Args& ...args) {
         std::string sql;
+        PhaseScope phase(PhaseStats::SQL_RENDER);
         if (!prepare_statement(method, sql, args...)) {
             return -1;
         }
-        if (_executor != nullptr) {
-            std::unique_ptr<SqlResult> res(_executor->select(sql));
+        if (executor() != nullptr) {
+            phase.next(PhaseStats::DB_WAIT);
+            ShardedExecutor::ShardKey shard(shard_value(args...));
+            std::unique_ptr<SqlResult> res(select_result(method, sql));
             if (res == nullptr) {
                 RELLAF_DEBUG("select impl action failed");
                 return -1;
             }
 
+            phase.next(PhaseStats::RESULT_DECODE);
             while (res->next()) {
                 Plain<Ret> ret;
                 if (!res->to_model((Model*) &ret)) {
@@ -244,6 +350,7 @@ protected:
 
     template<class ...Args>
     int select_list_impl_sql(const std::string& method, std::string& sql, const Args& ...args) {
+        PhaseScope phase(PhaseStats::SQL_RENDER);
         if (!prepare_statement(method, sql, args...)) {
             return -1;
         }
@@ -256,17 +363,87 @@ protected:
         if (sql == nullptr) {
             sql = &sql_inner;
         }
+        PhaseScope phase(PhaseStats::SQL_RENDER);
         if (!prepare_statement(method, *sql, args...)) {
             return -1;
         }
 
-        if (sql == &sql_inner && _executor != nullptr) {
-            return _executor->execute(*sql, key_id);
+        if (sql == &sql_inner && executor() != nullptr) {
+            phase.next(PhaseStats::DB_WAIT);
+            ShardedExecutor::ShardKey shard(shard_value(args...));
+            int ret = executor()->execute(*sql, key_id);
+            if (ret >= 0) {
+                invalidate_caches(method);
+            }
+            return ret;
+        }
+        return 0;
+    }
+
+    template<class ...Args>
+    int update_dirty_impl(const std::string& method, std::string* sql, Object& model,
+            Args& ...args) {
+        std::string sql_inner;
+        if (sql == nullptr) {
+            sql = &sql_inner;
+        }
+        PhaseScope phase(PhaseStats::SQL_RENDER);
+        if (!prepare_update_set(method, model, *sql)) {
+            return -1;
+        }
+        if (sql->empty()) {
+            return 0;
+        }
+        // where rendered by `model` itself if no more arguments
+        std::string where;
+        bool ok = sizeof...(args) == 0 ? prepare_statement(method, where, model) :
+                  prepare_statement(method, where, args...);
+        if (!ok || where.empty()) {
+            RELLAF_DEBUG("update dirty without where condition : %s", method.c_str());
+            sql->clear();
+            return -1;
+        }
+        *sql += " WHERE ";
+        *sql += where;
+
+        if (sql == &sql_inner && executor() != nullptr) {
+            phase.next(PhaseStats::DB_WAIT);
+            ShardedExecutor::ShardKey shard(sizeof...(args) == 0 ? shard_value(model) :
+                                            shard_value(args...));
+            uint64_t key_id = 0;
+            int ret = executor()->execute(*sql, key_id);
+            if (ret >= 0) {
+                model.clear_dirty();
+                invalidate_caches(method);
+            }
+            return ret;
         }
         return 0;
     }
 
 protected:
+    /**
+     * @brief render `UPDATE table SET` of dirty plain members of `model` into `sql`,
+     *        empty if nothing dirty
+     */
+    bool prepare_update_set(const std::string& method, const Object& model, std::string& sql);
+
+    /**
+     * @brief select through result cache of `method` if declared,
+     *        then executor, coalesced if single flight enabled
+     */
+    SqlResult* select_result(const std::string& method, const std::string& sql);
+
+    /**
+     * @brief clear result caches of selects sharing tables with `method`
+     */
+    void invalidate_caches(const std::string& method);
+
+    /**
+     * @brief collect table names following FROM, JOIN, UPDATE, INSERT and INTO
+     */
+    static void parse_tables(const std::string& pattern, std::set<std::string>& tables);
+
     void split_section(const std::string& section_str, std::deque<std::string>& sections);
 
     bool get_plain_val_str(const Model* model, std::string& val,
@@ -285,6 +462,17 @@ protected:
 
 private:
     CharsetType _charset = Charset::e().UTF8;
+    bool _single_flight = false;
+    bool _force_primary = false;
+    SqlExecutor* _bound_executor = nullptr;
+    std::string _shard_key;
+    SqlSingleFlight _flight;
+    // <method, tables in pattern>
+    std::map<std::string, std::set<std::string>> _tables;
+    // <select method, result cache>
+    std::map<std::string, std::unique_ptr<SqlResultCache>> _caches;
+    // <update dirty method, table>
+    std::map<std::string, std::string> _update_tables;
     std::map<std::string, std::string> _patterns;
     std::map<std::string, std::deque<SqlPattern::Stub>> _pices;
 
@@ -313,6 +501,17 @@ template<class ...Args> int _method_##_sql(std::string& sql, Args& ...args) {
 private:                                                                            \
 Reg _reg_##_method_{this, #_method_, _pattern_}
 
+// read through result cache of select method `_method_`, declared after its `rellaf_sql_select*`,
+// cleared by any insert, update or delete method of the same builder writing the same tables
+#define rellaf_sql_cache(_method_, _ttl_ms_, _max_bytes_)                           \
+private:                                                                            \
+CacheReg _cache_reg_##_method_{this, #_method_, new SqlLruCache(_ttl_ms_, _max_bytes_)}
+
+// same as rellaf_sql_cache, with custom cache implementation, owned by builder
+#define rellaf_sql_cache_by(_method_, _cache_)                                      \
+private:                                                                            \
+CacheReg _cache_reg_##_method_{this, #_method_, _cache_}
+
 #define rellaf_sql_insert(_method_, _pattern_)                                      \
 public:                                                                             \
 template<class ...Args> int _method_(Args& ...args) {                               \
@@ -343,4 +542,20 @@ Reg _reg_##_method_{this, #_method_, _pattern_}
 
 #define rellaf_sql_delete(_method_, _pattern_) rellaf_sql_insert(_method_, _pattern_)
 
+// update dirty plain members of the model only, `_where_pattern_` follows WHERE and is rendered
+// by the model if no more arguments. Returns 0 and executes nothing if no member dirty,
+// dirty flags of the model are cleared once executed.
+#define rellaf_sql_update_dirty(_method_, _table_, _where_pattern_)                 \
+public:                                                                             \
+template<class T, class ...Args> int _method_(T& model, Args& ...args) {            \
+    return update_dirty_impl(#_method_, nullptr, (Object&)model, args...);          \
+}                                                                                   \
+template<class T, class ...Args>                                                    \
+int _method_##_sql(std::string& sql, T& model, Args& ...args) {                     \
+    return update_dirty_impl(#_method_, &sql, (Object&)model, args...);             \
+}                                                                                   \
+private:                                                                            \
+Reg _reg_##_method_{this, #_method_, _where_pattern_};                              \
+UpdateReg _update_reg_##_method_{this, #_method_, _table_}
+
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// deadline of sql calls
+
+#pragma once
+
+#include <stdint.h>
+#include "common.h"
+
+namespace rellaf {
+
+/**
+ * deadline of sql calls made by current thread while alive, executors fail calls past it
+ * instead of waiting. Nested ones never extend the outer deadline.
+ * A source, such as remaining time of current rpc, may shorten it further.
+ * Kept by SqlScope, in a bthread it goes with the bthread.
+ */
+class SqlDeadline {
+RELLAF_AVOID_COPY(SqlDeadline)
+
+public:
+    /**
+     * @return us left of deadline given from outside, -1 if none
+     */
+    typedef int64_t (*Source)();
+
+    /**
+     * @brief `timeout_ms` from now, 0 no deadline of its own
+     */
+    explicit SqlDeadline(uint32_t timeout_ms);
+
+    ~SqlDeadline();
+
+    static void set_source(Source source);
+
+    /**
+     * @return deadline of current thread in us of monotonic clock, 0 if none
+     */
+    static uint64_t deadline_us();
+
+    /**
+     * @return ms left to `deadline_us`, at least 1, 0 if no deadline
+     */
+    static uint32_t timeout_ms(uint64_t deadline_us);
+
+    static uint64_t now_us();
+
+private:
+    uint64_t _prev;
+};
+
+}
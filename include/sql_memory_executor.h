@@ -0,0 +1,112 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// in process stand-in of mysql for load testing
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+
+#include "common.h"
+#include "mysql/sql_executor.h"
+#include "sql_single_flight.h"
+#include "sql_deadline.h"
+
+namespace rellaf {
+
+/**
+ * executor over tables in memory, drives builders, result decoding and pool scheduling
+ * without a server. A select returns all rows of the table following FROM, shared
+ * without copy, unknown table fails. Writes are counted, not applied.
+ * Latency of each call is injected by sleeping fixed plus random jitter microseconds,
+ * a call whose latency passes SqlDeadline sleeps until the deadline, then fails.
+ * Thread safe.
+ */
+class MemoryExecutor : public SqlExecutor {
+RELLAF_AVOID_COPY(MemoryExecutor)
+
+public:
+    /**
+     * fill `row` of index `idx`, one value for each field
+     */
+    typedef std::function<void(size_t idx, std::vector<std::string>& row)> RowGenerator;
+
+    MemoryExecutor();
+
+    virtual ~MemoryExecutor();
+
+    /**
+     * @brief add or replace table `name` of `row_count` rows built by `generator`
+     */
+    void add_table(const std::string& name, const std::deque<std::string>& fields,
+            size_t row_count, const RowGenerator& generator);
+
+    void add_table(const std::string& name, const std::shared_ptr<const SqlRows>& rows);
+
+    void set_select_latency(uint32_t fixed_us, uint32_t jitter_us);
+
+    void set_execute_latency(uint32_t fixed_us, uint32_t jitter_us);
+
+    SqlResult* select(const std::string& sql) override;
+
+    /**
+     * @return 1 affected, `key_id` increases from 1 by every call, -1 if deadline exceeded
+     */
+    int execute(const std::string& sql, uint64_t& key_id) override;
+
+    inline uint64_t select_count() const {
+        return _select_count.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t execute_count() const {
+        return _execute_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief lower case table name following FROM in `sql`, empty if not found
+     */
+    static std::string table_of(const std::string& sql);
+
+private:
+    struct Latency {
+        std::atomic<uint32_t> fixed_us{0};
+        std::atomic<uint32_t> jitter_us{0};
+    };
+
+    /**
+     * @return false if deadline exceeded
+     */
+    static bool inject(const Latency& latency);
+
+private:
+    pthread_rwlock_t _lock;
+    // <lower case name, rows>
+    std::unordered_map<std::string, std::shared_ptr<const SqlRows>> _tables;
+    Latency _select_latency;
+    Latency _execute_latency;
+    std::atomic<uint64_t> _select_count{0};
+    std::atomic<uint64_t> _execute_count{0};
+};
+
+}
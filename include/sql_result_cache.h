@@ -0,0 +1,115 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// read through cache of select results
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include "common.h"
+#include "sql_single_flight.h"
+
+namespace rellaf {
+
+/**
+ * cache of one select method, keyed by rendered sql.
+ * `clear` is the invalidation hook, fired by writes to the same tables,
+ * it also bumps `version`, rows queried before that are not stored by `put`.
+ */
+class SqlResultCache {
+public:
+    virtual ~SqlResultCache() = default;
+
+    /**
+     * @return nullptr if not exist or expired
+     */
+    virtual std::shared_ptr<const SqlRows> get(const std::string& key) = 0;
+
+    /**
+     * @param version   `version()` fetched before querying `rows`
+     */
+    virtual void put(const std::string& key, const SqlRows& rows, uint64_t version) = 0;
+
+    virtual void clear() = 0;
+
+    virtual uint64_t version() const = 0;
+};
+
+/**
+ * rows serialized as one compact buffer, LRU per shard bounded by bytes, expired by TTL
+ */
+class SqlLruCache : public SqlResultCache {
+RELLAF_AVOID_COPY(SqlLruCache)
+
+public:
+    SqlLruCache(int64_t ttl_ms, size_t max_bytes, size_t shard_num = 16);
+
+    ~SqlLruCache() override;
+
+    std::shared_ptr<const SqlRows> get(const std::string& key) override;
+
+    void put(const std::string& key, const SqlRows& rows, uint64_t version) override;
+
+    void clear() override;
+
+    uint64_t version() const override {
+        return _version;
+    }
+
+    size_t bytes();
+
+    /**
+     * @brief <field count><fields><row count><values>, each count and length as varint
+     */
+    static void serialize(const SqlRows& rows, std::string& buf);
+
+    static bool parse(const std::string& buf, SqlRows& rows);
+
+private:
+    struct Entry {
+        std::string key;
+        std::string buf;
+        int64_t expire_ms;
+    };
+
+    struct Shard {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        // front is the most recently used
+        std::list<Entry> lru;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shard_of(const std::string& key);
+
+    // caller holds lock of `shard`
+    static void erase(Shard& shard, std::list<Entry>::iterator iter);
+
+private:
+    int64_t _ttl_ms;
+    size_t _shard_num;
+    size_t _shard_max_bytes;
+    std::unique_ptr<Shard[]> _shards;
+    volatile uint64_t _version = 0;
+};
+
+}
@@ -0,0 +1,161 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// read write splitting over a primary and its replicas
+
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "common.h"
+#include "mysql/sql_executor.h"
+
+namespace rellaf {
+
+struct ReadWriteOptions {
+    // replicas lagging behind primary longer than this are skipped, 0 no limit
+    int64_t max_lag_ms = 1000;
+    // interval of lag probing by background thread, 0 no probing
+    uint32_t probe_interval_ms = 1000;
+    // reads go to primary if no replica available, otherwise fail
+    bool fallback_to_primary = true;
+};
+
+/**
+ * executor routing selects to replicas, everything else to primary.
+ * The replica with least outstanding selects is picked, ties are rotated,
+ * replicas failed by probe or lagging over `max_lag_ms` are skipped.
+ * Reads MUST see own writes or locking reads (FOR UPDATE, LOCK IN SHARE MODE) go to primary,
+ * force them by `ForcePrimary` for a call, or by `SqlBuilder::set_force_primary` for a DAO.
+ * Transactions are taken on the primary pool directly.
+ * Replicas are added before `start`, thread safe after.
+ */
+class ReadWriteExecutor : public SqlExecutor {
+RELLAF_AVOID_COPY(ReadWriteExecutor)
+
+public:
+    /**
+     * @return lag of `replica` in milliseconds, -1 if unavailable
+     */
+    typedef std::function<int64_t(SqlExecutor* replica)> LagProbe;
+
+    /**
+     * @brief while alive, all routed calls of current thread go to primary, nestable
+     */
+    class ForcePrimary {
+    RELLAF_AVOID_COPY(ForcePrimary)
+
+    public:
+        explicit ForcePrimary(bool enable = true);
+
+        ~ForcePrimary();
+
+        static bool active();
+
+    private:
+        bool _enable;
+    };
+
+    explicit ReadWriteExecutor(SqlExecutor* primary,
+            const ReadWriteOptions& options = ReadWriteOptions());
+
+    virtual ~ReadWriteExecutor();
+
+    void add_replica(SqlExecutor* replica);
+
+    void set_lag_probe(const LagProbe& probe);
+
+    /**
+     * @brief probe once, then start probing thread if both interval and probe set
+     */
+    bool start();
+
+    void stop();
+
+    /**
+     * @brief probe lag of all replicas once
+     */
+    void probe();
+
+    SqlResult* select(const std::string& sql) override;
+
+    int execute(const std::string& sql, uint64_t& key_id) override;
+
+    inline SqlExecutor* primary() {
+        return _primary;
+    }
+
+    inline size_t replica_count() const {
+        return _replicas.size();
+    }
+
+    inline int64_t replica_lag_ms(size_t idx) const {
+        return _replicas[idx]->lag_ms.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t replica_reads(size_t idx) const {
+        return _replicas[idx]->reads.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t primary_reads() const {
+        return _primary_reads.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief lag probe of mysql, Seconds_Behind_Master of SHOW SLAVE STATUS,
+     *        -1 if not a replica or replication stopped
+     */
+    static int64_t mysql_lag_probe(SqlExecutor* replica);
+
+    /**
+     * @brief if `sql` is a select without locking clause
+     */
+    static bool is_replica_read(const std::string& sql);
+
+private:
+    struct Replica {
+        SqlExecutor* executor = nullptr;
+        std::atomic<int> outstanding{0};
+        std::atomic<int64_t> lag_ms{0};
+        std::atomic<uint64_t> reads{0};
+    };
+
+    Replica* pick();
+
+    static void* probe_routine(void* arg);
+
+private:
+    SqlExecutor* _primary;
+    ReadWriteOptions _options;
+    std::vector<std::unique_ptr<Replica>> _replicas;
+    LagProbe _probe;
+    std::atomic<uint64_t> _rotate{0};
+    std::atomic<uint64_t> _primary_reads{0};
+
+    pthread_t _probe_tid;
+    bool _probing = false;
+    bool _stopping = false;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
+};
+
+}
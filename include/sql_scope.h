@@ -0,0 +1,55 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// storage of per call sql scopes
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "common.h"
+
+namespace rellaf {
+
+/**
+ * state of SqlDeadline, ShardedExecutor::ShardKey and ReadWriteExecutor::ForcePrimary
+ * of current execution context
+ */
+struct SqlScopeState {
+    // us of monotonic clock, 0 if none
+    uint64_t deadline_us = 0;
+    const std::string* shard_key = nullptr;
+    int force_primary = 0;
+};
+
+/**
+ * scopes are kept in thread local storage by default. Coroutines moving between threads,
+ * such as bthread, register a provider of storage of the running coroutine,
+ * then a scope stays with its coroutine across yields.
+ */
+class SqlScope {
+public:
+    /**
+     * @return state of running coroutine, nullptr if not in one
+     */
+    typedef SqlScopeState* (*Provider)();
+
+    static void set_provider(Provider provider);
+
+    static SqlScopeState& current();
+};
+
+}
@@ -0,0 +1,103 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// executor over shards, each a database of its own
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "common.h"
+#include "mysql/sql_executor.h"
+
+namespace rellaf {
+
+/**
+ * executor routing each call to one of shards by shard key of current thread.
+ * The key is set by `ShardKey` for a call, or by `SqlBuilder::set_shard_key` from
+ * a member of bound models. Calls without key fail unless only one shard.
+ * Shards are added before use, thread safe after.
+ */
+class ShardedExecutor : public SqlExecutor {
+RELLAF_AVOID_COPY(ShardedExecutor)
+
+public:
+    /**
+     * @return index of shard of `key` in [0, `shard_count`)
+     */
+    typedef std::function<size_t(const std::string& key, size_t shard_count)> Selector;
+
+    /**
+     * @brief while alive, routed calls of current thread go to shard of `key`,
+     *        nestable, empty key keeps the outer one
+     */
+    class ShardKey {
+    RELLAF_AVOID_COPY(ShardKey)
+
+    public:
+        explicit ShardKey(const std::string& key);
+
+        ~ShardKey();
+
+        /**
+         * @return key of current thread, nullptr if none
+         */
+        static const std::string* current();
+
+    private:
+        std::string _key;
+        const std::string* _prev;
+        bool _set;
+    };
+
+    ShardedExecutor() = default;
+
+    virtual ~ShardedExecutor() = default;
+
+    void add_shard(SqlExecutor* shard);
+
+    /**
+     * @brief default integer key modulo shard count, FNV-1a hash of other keys
+     */
+    void set_selector(const Selector& selector);
+
+    /**
+     * @return shard of `key`, nullptr if no shard
+     */
+    SqlExecutor* shard(const std::string& key) const;
+
+    inline size_t shard_count() const {
+        return _shards.size();
+    }
+
+    SqlResult* select(const std::string& sql) override;
+
+    int execute(const std::string& sql, uint64_t& key_id) override;
+
+    static size_t default_selector(const std::string& key, size_t shard_count);
+
+private:
+    SqlExecutor* current_shard() const;
+
+private:
+    std::vector<SqlExecutor*> _shards;
+    Selector _selector;
+};
+
+}
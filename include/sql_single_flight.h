@@ -0,0 +1,124 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// coalescing identical select statements in flight
+
+#pragma once
+
+#include <pthread.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "common.h"
+#include "model.h"
+#include "mysql/sql_executor.h"
+
+namespace rellaf {
+
+/**
+ * all rows of a result set materialized, immutable once built, shared between readers
+ */
+struct SqlRows {
+    std::deque<std::string> fields;
+    std::deque<std::vector<std::string>> rows;
+
+    /**
+     * @brief drain all rows left of `result`
+     */
+    static std::shared_ptr<SqlRows> drain(SqlResult* result);
+};
+
+/**
+ * result over shared rows, each reader has its own cursor
+ */
+class SqlRowsResult : public SqlResult {
+RELLAF_AVOID_COPY(SqlRowsResult)
+
+public:
+    explicit SqlRowsResult(const std::shared_ptr<const SqlRows>& rows) : _rows(rows) {}
+
+    ~SqlRowsResult() override = default;
+
+    size_t row_count() const override;
+
+    size_t field_count() const override;
+
+    std::string field_name(size_t index) const override;
+
+    bool next() override;
+
+    std::string fetch(size_t index) const override;
+
+    bool to_model(Model* model) const override;
+
+private:
+    std::shared_ptr<const SqlRows> _rows;
+    // index of next row
+    size_t _next = 0;
+};
+
+/**
+ * concurrent selects of the same sql share one query to executor,
+ * the first caller queries, others wait and read the same rows by their own cursors.
+ * A waiter fails when its SqlDeadline passes, the query goes on for the rest.
+ */
+class SqlSingleFlight {
+RELLAF_AVOID_COPY(SqlSingleFlight)
+
+public:
+    SqlSingleFlight() = default;
+
+    virtual ~SqlSingleFlight() = default;
+
+    /**
+     * @return result set, memory resource MUST be clean after using by caller, nullptr if failed
+     */
+    SqlResult* select(SqlExecutor* executor, const std::string& sql);
+
+    /**
+     * @brief flights told apart by `key` instead of sql
+     */
+    SqlResult* select(SqlExecutor* executor, const std::string& sql, const std::string& key);
+
+    /**
+     * @return rows shared by all callers of the flight, nullptr if failed
+     */
+    std::shared_ptr<const SqlRows> select_rows(SqlExecutor* executor, const std::string& sql);
+
+    std::shared_ptr<const SqlRows> select_rows(SqlExecutor* executor, const std::string& sql,
+            const std::string& key);
+
+    size_t in_flight();
+
+private:
+    struct Call {
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+        bool done = false;
+        // nullptr if query failed
+        std::shared_ptr<const SqlRows> rows;
+    };
+
+private:
+    pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+    // <key, call in flight>
+    std::unordered_map<std::string, std::shared_ptr<Call>> _calls;
+};
+
+}
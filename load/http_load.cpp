@@ -0,0 +1,188 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// end to end load of http services: brpc::Server with BrpcDispatcher on loopback,
+// driven by brpc client from threads, full path of parsing, routing, arguments,
+// handler and json, reports QPS, latency percentiles, cpu, wall time and heap allocations
+// (built with WITH_ALLOC_STATS) of each phase.
+//
+// rellaf_http_load --api=echo --concurrency=32 --duration_ms=10000 --payload_items=100
+
+#include <sys/resource.h>
+#include <stdio.h>
+#include <algorithm>
+#include "gflags/gflags.h"
+#include "brpc/server.h"
+#include "brpc_dispatcher.h"
+#include "http_client.h"
+#include "load_runner.h"
+#include "phase_stats.h"
+#include "json/json_to_model.h"
+#include "test_service.pb.h"
+
+DEFINE_int32(port, 8765, "loopback port of server");
+DEFINE_int32(server_threads, 0, "bthread workers of server, 0 default of brpc");
+DEFINE_int32(concurrency, 16, "client threads calling concurrently");
+DEFINE_int32(duration_ms, 10000, "measured duration");
+DEFINE_int32(warmup_ms, 1000, "calls made before measuring");
+DEFINE_string(api, "echo", "echo : POST body decoded and encoded back, item : GET path var");
+DEFINE_int32(payload_items, 10, "items of list in echo body");
+DEFINE_int32(payload_bytes, 256, "bytes of string member in echo body");
+DEFINE_int32(timeout_ms, 1000, "timeout of each call");
+DEFINE_bool(json, false, "report as json");
+
+namespace rellaf {
+namespace load {
+
+class LoadItem : public Object {
+rellaf_model_dcl(LoadItem);
+
+rellaf_model_def_int64(id, 0);
+rellaf_model_def_str(name, "");
+rellaf_model_def_double(price, 0);
+};
+
+rellaf_model_def(LoadItem);
+
+class Payload : public Object {
+rellaf_model_dcl(Payload);
+
+rellaf_model_def_int64(id, 0);
+rellaf_model_def_str(data, "");
+rellaf_model_def_list(items, LoadItem);
+rellaf_model_def_object(owner, LoadItem);
+};
+
+rellaf_model_def(Payload);
+
+class ItemVars : public Object {
+rellaf_model_dcl(ItemVars);
+
+rellaf_model_def_int64(id, 0);
+};
+
+rellaf_model_def(ItemVars);
+
+class LoadServiceImpl : public BrpcService, public TestService {
+rellaf_brpc_http_dcl(LoadServiceImpl, TestRequest, TestResponse);
+
+rellaf_brpc_http_def_post_body(echo, "/load/echo", echo_payload, Payload, Payload) {
+        Payload ret = b;
+        ret.set_id(b.id() + 1);
+        return ret;
+    }
+
+rellaf_brpc_http_def_get_pathvar(hello, "/load/item/{id}", get_item, LoadItem, ItemVars) {
+        LoadItem item;
+        item.set_id(v.id());
+        item.set_name("item_" + std::to_string(v.id()));
+        item.set_price(v.id() * 0.5);
+        return item;
+    }
+};
+
+rellaf_brpc_http_def(LoadServiceImpl);
+
+static std::string build_body() {
+    Payload payload;
+    payload.set_id(1);
+    payload.set_data(std::string((size_t)std::max(0, FLAGS_payload_bytes), 'x'));
+    for (int i = 0; i < FLAGS_payload_items; ++i) {
+        LoadItem item;
+        item.set_id(i);
+        item.set_name("item_" + std::to_string(i));
+        item.set_price(i * 0.5);
+        payload.items().push_back(item);
+    }
+    LoadItem owner;
+    owner.set_id(7);
+    payload.set_owner(&owner);
+    std::string body;
+    model_to_json(&payload, body);
+    return body;
+}
+
+static double cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+}
+}
+
+using namespace rellaf;
+using namespace rellaf::load;
+
+int main(int argc, char* argv[]) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    brpc::Server server;
+    brpc::ServerOptions options;
+    options.has_builtin_services = false;
+    options.num_threads = FLAGS_server_threads;
+    BrpcDispatcher::instance().reg_http_serivces(server);
+    std::string addr = "127.0.0.1:" + std::to_string(FLAGS_port);
+    if (server.Start(addr.c_str(), &options) != 0) {
+        fprintf(stderr, "start server on %s failed\n", addr.c_str());
+        return -1;
+    }
+
+    HttpClientOptions client_options;
+    client_options.timeout_ms = FLAGS_timeout_ms;
+    client_options.max_retry = 0;
+    HttpClient client(client_options);
+
+    std::string body = build_body();
+    bool echo = FLAGS_api == "echo";
+    LoadRunner::Call call = [&](int idx) {
+        HttpResponse response;
+        int ret = echo ? client.post(addr + "/load/echo", {}, body, response) :
+                  client.get(addr + "/load/item/" + std::to_string(idx), {}, response);
+        return ret == 0 && response.status == 200;
+    };
+
+    if (FLAGS_warmup_ms > 0) {
+        LoadRunner(FLAGS_concurrency, (uint32_t)FLAGS_warmup_ms).run(call);
+    }
+    PhaseStats::set_enabled(true);
+    PhaseStats::reset();
+    double cpu_begin = cpu_seconds();
+    LoadRunner runner(FLAGS_concurrency, (uint32_t)FLAGS_duration_ms);
+    LoadRunner::Report report = runner.run(call);
+    double cpu = cpu_seconds() - cpu_begin;
+    PhaseStats::set_enabled(false);
+    PhaseStats::Snapshot phases;
+    PhaseStats::snapshot(phases);
+
+    // cpu of client and server together, phases are server side only
+    double cpu_us_per_call = report.calls == 0 ? 0 : cpu * 1e6 / report.calls;
+    if (FLAGS_json) {
+        printf(R"({"api":"%s","body_bytes":%zu,"report":%s,"cpu_us_per_call":%.1f,)"
+               R"("phases":%s})" "\n",
+                FLAGS_api.c_str(), echo ? body.size() : 0, report.json().c_str(),
+                cpu_us_per_call, phases.json().c_str());
+    } else {
+        printf("api=%s body_bytes=%zu\n%s\nprocess cpu_us per call=%.1f\n%s\n",
+                FLAGS_api.c_str(), echo ? body.size() : 0, report.str().c_str(),
+                cpu_us_per_call, phases.str().c_str());
+    }
+
+    server.Stop(0);
+    server.Join();
+    return report.errors == 0 ? 0 : -1;
+}
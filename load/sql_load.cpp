@@ -0,0 +1,170 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// load of DAO methods over MemoryExecutor, no database needed
+//
+// rellaf_sql_load [-t threads] [-d duration_ms] [-r rows] [-l latency_us] [-j jitter_us]
+//                 [-s single flight 0|1] [-f json]
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "sql_builder.h"
+#include "sql_memory_executor.h"
+#include "load_runner.h"
+
+namespace rellaf {
+namespace load {
+
+class LoadInfo : public Object {
+rellaf_model_dcl(LoadInfo);
+
+rellaf_model_def_uint64(id, 0);
+rellaf_model_def_str(content, "");
+rellaf_model_def_uint32(create_time, 0);
+rellaf_model_def_uint32(update_time, 0);
+};
+
+rellaf_model_def(LoadInfo);
+
+class LoadDao : public SqlBuilder {
+rellaf_singleton(LoadDao);
+
+rellaf_sql_select(get_info, "SELECT id, content, create_time, update_time FROM info "
+                            "WHERE id=#{id}", LoadInfo);
+
+rellaf_sql_select_list(query_infos, "SELECT id, content, create_time, update_time FROM info "
+                                    "LIMIT #{start}, #{limit}", LoadInfo);
+
+rellaf_sql_insert_retid(add_info, "INSERT INTO info (content, create_time, update_time) VALUES "
+                                  "(#{content}, NOW(), NOW())");
+
+rellaf_sql_update(update_info,
+        "UPDATE info SET content=#{content}, update_time=NOW() WHERE id=#{id}");
+};
+
+class Page : public Object {
+rellaf_model_dcl(Page);
+
+rellaf_model_def_int(start, 0);
+rellaf_model_def_int(limit, 20);
+};
+
+rellaf_model_def(Page);
+
+}
+}
+
+using namespace rellaf;
+using namespace rellaf::load;
+
+int main(int argc, char* argv[]) {
+    int threads = 8;
+    uint32_t duration_ms = 5000;
+    size_t rows = 20;
+    uint32_t latency_us = 0;
+    uint32_t jitter_us = 0;
+    bool single_flight = false;
+    bool json = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "t:d:r:l:j:s:f:")) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'd':
+                duration_ms = (uint32_t)atoi(optarg);
+                break;
+            case 'r':
+                rows = (size_t)atoi(optarg);
+                break;
+            case 'l':
+                latency_us = (uint32_t)atoi(optarg);
+                break;
+            case 'j':
+                jitter_us = (uint32_t)atoi(optarg);
+                break;
+            case 's':
+                single_flight = atoi(optarg) != 0;
+                break;
+            case 'f':
+                json = strcmp(optarg, "json") == 0;
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-t threads] [-d duration_ms] [-r rows] "
+                                "[-l latency_us] [-j jitter_us] [-s 0|1] [-f json]\n", argv[0]);
+                return -1;
+        }
+    }
+
+    MemoryExecutor executor;
+    executor.add_table("info", {"id", "content", "create_time", "update_time"}, rows,
+            [](size_t idx, std::vector<std::string>& row) {
+                row.emplace_back(std::to_string(idx + 1));
+                row.emplace_back("content of info " + std::to_string(idx + 1));
+                row.emplace_back("1546272000");
+                row.emplace_back("1546272000");
+            });
+    executor.set_select_latency(latency_us, jitter_us);
+    executor.set_execute_latency(latency_us, jitter_us);
+    SqlBuilder::set_executor(&executor);
+    LoadDao& dao = LoadDao::instance();
+    dao.set_single_flight(single_flight);
+
+    struct Case {
+        const char* name;
+        LoadRunner::Call call;
+    };
+    std::vector<Case> cases = {
+            {"get_info", [&](int idx) {
+                LoadInfo info;
+                Plain<uint64_t> id(1);
+                return dao.get_info(info, id) >= 0;
+            }},
+            {"query_infos", [&](int idx) {
+                std::vector<LoadInfo> infos;
+                Page page;
+                return dao.query_infos(infos, page) >= 0;
+            }},
+            {"add_info", [&](int idx) {
+                LoadInfo info;
+                info.set_content("it's a new content");
+                uint64_t key_id = 0;
+                return dao.add_info(key_id, info) >= 0;
+            }},
+            {"update_info", [&](int idx) {
+                LoadInfo info;
+                info.set_id(1);
+                info.set_content("it's an updated content");
+                return dao.update_info(info) >= 0;
+            }},
+    };
+
+    for (auto& c : cases) {
+        LoadRunner runner(threads, duration_ms);
+        runner.set_warmup_ms(duration_ms / 10);
+        LoadRunner::Report report = runner.run(c.call);
+        if (json) {
+            printf(R"({"case":"%s","report":%s})" "\n", c.name, report.json().c_str());
+        } else {
+            printf("%-12s %s\n", c.name, report.str().c_str());
+        }
+    }
+    SqlBuilder::set_executor(nullptr);
+    return 0;
+}
@@ -16,6 +16,7 @@
 //
 
 #include "brpc/brpc_dispatcher.h"
+#include "brpc/phase_stats_bvar.h"
 
 namespace rellaf {
 
@@ -27,6 +28,7 @@ int BrpcDispatcher::reg_http_serivces(brpc::Server& server) {
     if (_services.empty()) {
         return -1;
     }
+    expose_phase_stats();
 
     for (auto& entry : _services) {
         BrpcService* service = entry.second;
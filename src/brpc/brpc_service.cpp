@@ -15,12 +15,82 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <pthread.h>
+#include "bthread/bthread.h"
+#include "butil/time.h"
 #include "common.h"
+#include "sql_deadline.h"
+#include "sql_scope.h"
 #include "brpc/http_status_code.h"
 #include "brpc/brpc_service.h"
 
 namespace rellaf {
 
+// deadline of request in us of realtime clock, kept per bthread since bthreads migrate pthreads
+static bthread_key_t s_deadline_key;
+// sql scopes of each bthread
+static bthread_key_t s_scope_key;
+static pthread_once_t s_bthread_once = PTHREAD_ONCE_INIT;
+
+static int64_t rpc_deadline_left_us() {
+    const int64_t* deadline = (const int64_t*)bthread_getspecific(s_deadline_key);
+    if (deadline == nullptr || *deadline < 0) {
+        return -1;
+    }
+    int64_t left_us = *deadline - butil::gettimeofday_us();
+    return left_us > 0 ? left_us : 0;
+}
+
+static void delete_scope_state(void* state) {
+    delete (SqlScopeState*) state;
+}
+
+static SqlScopeState* bthread_scope_state() {
+    if (bthread_self() == 0) {
+        return nullptr;
+    }
+    SqlScopeState* state = (SqlScopeState*) bthread_getspecific(s_scope_key);
+    if (state == nullptr) {
+        state = new(std::nothrow) SqlScopeState;
+        if (state == nullptr || bthread_setspecific(s_scope_key, state) != 0) {
+            delete state;
+            return nullptr;
+        }
+    }
+    return state;
+}
+
+static void init_bthread_scopes() {
+    if (bthread_key_create(&s_scope_key, delete_scope_state) == 0) {
+        SqlScope::set_provider(bthread_scope_state);
+    } else {
+        RELLAF_DEBUG("create sql scope key failed");
+    }
+    if (bthread_key_create(&s_deadline_key, nullptr) != 0) {
+        RELLAF_DEBUG("create rpc deadline key failed");
+        return;
+    }
+    SqlDeadline::set_source(rpc_deadline_left_us);
+}
+
+// sql calls made while alive inherit remaining timeout of request
+class RpcDeadlineScope {
+RELLAF_AVOID_COPY(RpcDeadlineScope)
+
+public:
+    explicit RpcDeadlineScope(const brpc::Controller* cntl) : _deadline_us(cntl->deadline_us()) {
+        pthread_once(&s_bthread_once, init_bthread_scopes);
+        bthread_setspecific(s_deadline_key, &_deadline_us);
+    }
+
+    ~RpcDeadlineScope() {
+        bthread_setspecific(s_deadline_key, nullptr);
+    }
+
+private:
+    int64_t _deadline_us;
+};
+
 void BrpcService::entry(RpcController* controller, Message* req, Message* resp,
         Closure* done) {
     RELLAF_UNUSED(req);
@@ -30,7 +100,11 @@ void BrpcService::entry(RpcController* controller, Message* req, Message* resp,
     brpc::Controller* cntl = dynamic_cast<brpc::Controller*>(controller);
 
     std::map<std::string, std::string> vars;
-    std::string name = FunctionMapper::instance().fetch_name(cntl->http_request(), vars);
+    std::string name;
+    {
+        PhaseScope phase(PhaseStats::ROUTE);
+        name = FunctionMapper::instance().fetch_name(cntl->http_request(), vars);
+    }
     if (name.empty()) {
         cntl->http_response().set_status_code(brpc::HTTP_STATUS_NOT_FOUND);
         return_response(cntl, "");
@@ -38,7 +112,11 @@ void BrpcService::entry(RpcController* controller, Message* req, Message* resp,
     }
 
     std::string ret_body;
-    int status = FunctionMapper::instance().invoke(name, vars, cntl, ret_body);
+    int status;
+    {
+        RpcDeadlineScope deadline(cntl);
+        status = FunctionMapper::instance().invoke(name, vars, cntl, ret_body);
+    }
     if (status == -1) {
         cntl->http_request().set_status_code(brpc::HTTP_STATUS_INTERNAL_SERVER_ERROR);
     }
@@ -75,9 +153,8 @@ void BrpcService::bind_api_sign(const std::string& sign, const std::string& api)
 }
 
 void BrpcService::return_response(brpc::Controller* cntl, const std::string& raw) {
-    butil::IOBufBuilder os;
-    os << raw;
-    os.move_to(cntl->response_attachment());
+    // appended, body of a cached route is already in attachment
+    cntl->response_attachment().append(raw);
 }
 
 }
\ No newline at end of file
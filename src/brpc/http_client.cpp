@@ -15,34 +15,116 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <errno.h>
+#include <deque>
+#include "bthread/countdown_event.h"
 #include "brpc/channel.h"
 #include "common.h"
+#include "json/json_to_model.h"
 #include "brpc/http_client.h"
 
 namespace rellaf {
 
-int http_request(const std::string& api, brpc::HttpMethod method,
-        const std::map<std::string, std::string>& params,
-        const std::map<std::string, std::string>& headers,
-        const std::string& content_type, const std::string& request_body,
-        HttpResponse& response, int timeout) {
-    brpc::Controller controller;
+HttpClient::HttpClient(const HttpClientOptions& options) : _options(options) {}
+
+HttpClient::~HttpClient() {
+    pthread_rwlock_wrlock(&_lock);
+    _channels.clear();
+    pthread_rwlock_unlock(&_lock);
+    pthread_rwlock_destroy(&_lock);
+}
+
+HttpClient& HttpClient::instance() {
+    static HttpClient client;
+    return client;
+}
+
+size_t HttpClient::channel_count() {
+    pthread_rwlock_rdlock(&_lock);
+    size_t count = _channels.size();
+    pthread_rwlock_unlock(&_lock);
+    return count;
+}
+
+brpc::Channel* HttpClient::fetch_channel(const std::string& api, brpc::URI& uri) {
+    if (uri.SetHttpURL(api) != 0) {
+        RELLAF_DEBUG("invalid api : %s", api.c_str());
+        return nullptr;
+    }
+
+    std::string key;
+    if (!_options.naming_service_url.empty()) {
+        key = _options.naming_service_url;
+    } else {
+        if (uri.host().empty()) {
+            RELLAF_DEBUG("no host in api : %s", api.c_str());
+            return nullptr;
+        }
+        key = uri.scheme().empty() ? "http" : uri.scheme();
+        key += "://" + uri.host();
+        if (uri.port() > 0) {
+            key += ":" + std::to_string(uri.port());
+        }
+    }
+
+    pthread_rwlock_rdlock(&_lock);
+    auto entry = _channels.find(key);
+    brpc::Channel* channel = (entry == _channels.end()) ? nullptr : entry->second.get();
+    pthread_rwlock_unlock(&_lock);
+    if (channel != nullptr) {
+        return channel;
+    }
+
+    pthread_rwlock_wrlock(&_lock);
+    entry = _channels.find(key);
+    if (entry != _channels.end()) { // initialized by others
+        channel = entry->second.get();
+        pthread_rwlock_unlock(&_lock);
+        return channel;
+    }
+
+    std::unique_ptr<brpc::Channel> new_channel(new(std::nothrow) brpc::Channel);
+    if (new_channel == nullptr) {
+        pthread_rwlock_unlock(&_lock);
+        return nullptr;
+    }
+
     brpc::ChannelOptions options;
-    brpc::Channel channel;
     options.protocol = brpc::PROTOCOL_HTTP;
-    options.timeout_ms = timeout;
-    options.connect_timeout_ms = 600000;
+    options.connection_type = _options.connection_type;
+    options.timeout_ms = _options.timeout_ms;
+    options.connect_timeout_ms = _options.connect_timeout_ms;
+    options.max_retry = _options.max_retry;
 
-    brpc::URI uri;
-    uri.SetHttpURL(api);
+    int ret;
+    if (!_options.naming_service_url.empty()) {
+        ret = new_channel->Init(key.c_str(), _options.load_balancer.c_str(), &options);
+    } else {
+        ret = new_channel->Init(key.c_str(), &options);
+    }
+    if (ret != 0) {
+        RELLAF_DEBUG("fail to initialize baidu_rpc channel : %s", key.c_str());
+        pthread_rwlock_unlock(&_lock);
+        return nullptr;
+    }
 
-    if (channel.Init(api.c_str(), &options) != 0) {
-        RELLAF_DEBUG("fail to initialize baidu_rpc channel, api : %s", api.c_str());
-        return -1;
+    channel = new_channel.get();
+    _channels.emplace(key, std::move(new_channel));
+    pthread_rwlock_unlock(&_lock);
+    RELLAF_DEBUG("baidu_rpc channel initialized : %s", key.c_str());
+    return channel;
+}
+
+static void build_request(brpc::Controller& controller, const brpc::URI& uri,
+        brpc::HttpMethod method, const std::map<std::string, std::string>& params,
+        const std::map<std::string, std::string>& headers,
+        const std::string& content_type, int timeout) {
+    if (timeout > 0) {
+        controller.set_timeout_ms(timeout);
     }
 
     controller.http_request().set_method(method);
-    controller.http_request().uri() = api;
+    controller.http_request().uri() = uri;
     if (!content_type.empty()) {
         controller.http_request().set_content_type(content_type);
     }
@@ -54,46 +136,267 @@ int http_request(const std::string& api, brpc::HttpMethod method,
     for (auto& entry : params) {
         controller.http_request().uri().SetQuery(entry.first, entry.second);
     }
+}
 
-    if (!request_body.empty()) {
-        butil::IOBufBuilder os;
-        os << request_body;
-        os.move_to(controller.request_attachment());
+static bool write_model(const Model* model, brpc::Controller& controller) {
+    if (is_plain(model)) {
+        controller.request_attachment().append(model->str());
+        return true;
     }
+    if (controller.http_request().content_type().empty()) {
+        controller.http_request().set_content_type("application/json");
+    }
+    butil::IOBufBuilder os;
+    if (!model_to_json(model, os)) {
+        return false;
+    }
+    os.move_to(controller.request_attachment());
+    return true;
+}
 
-    std::string port_sign = (uri.port() <= 0) ? "" : ":" + std::to_string(uri.port());
-    const std::string& request_url = uri.host();
-    const std::string& request_query = uri.path() + "?" + uri.query();
-    RELLAF_DEBUG("http %s request : http://%s%s%s, payload : %s", brpc::HttpMethod2Str(method),
-            request_url.c_str(), port_sign.c_str(), request_query.c_str(),
-            request_body.c_str());
+static bool read_model(const butil::IOBuf& body, Model* model) {
+    if (body.empty()) {
+        return true;
+    }
+    if (is_plain(model)) {
+        return model->set_parse(body.to_string());
+    }
+    // parse in place if body is contiguous, which is the most case of small body
+    if (body.backing_block_num() == 1) {
+        butil::StringPiece block = body.backing_block(0);
+        return json_to_model(block.data(), block.size(), model);
+    }
+    return json_to_model(body.to_string(), model);
+}
 
-    channel.CallMethod(nullptr, &controller, nullptr, nullptr, nullptr);
+static void fill_response(brpc::Controller& controller, HttpResponse& response) {
     response.status = controller.http_response().status_code();
     response.body.swap(controller.response_attachment());
     response.content_type = controller.http_response().content_type();
     response.reason_phrase = controller.http_response().reason_phrase();
     response.compress_type = controller.response_compress_type();
+    response.error_code = controller.ErrorCode();
+    response.error_text = controller.ErrorText();
+}
+
+int HttpClient::call(brpc::Channel* channel, brpc::Controller& controller,
+        const std::string& api, HttpResponse& response) {
+    brpc::HttpMethod method = controller.http_request().method();
+    RELLAF_DEBUG("http %s request : %s, payload size : %zu", brpc::HttpMethod2Str(method),
+            api.c_str(), controller.request_attachment().size());
+
+    channel->CallMethod(nullptr, &controller, nullptr, nullptr, nullptr);
+    fill_response(controller, response);
 
     if (controller.Failed() || controller.IsCanceled()) {
-        RELLAF_DEBUG("invoke %s failed, api : http://%s%s%s, message : %s",
-                brpc::HttpMethod2Str(method), request_url.c_str(), port_sign.c_str(),
-                request_query.c_str(), controller.ErrorText().c_str());
+        RELLAF_DEBUG("invoke %s failed, api : %s, message : %s", brpc::HttpMethod2Str(method),
+                api.c_str(), controller.ErrorText().c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+int HttpClient::request(const std::string& api, brpc::HttpMethod method,
+        const std::map<std::string, std::string>& params,
+        const std::map<std::string, std::string>& headers,
+        const std::string& content_type, const std::string& request_body,
+        HttpResponse& response, int timeout) {
+    brpc::URI uri;
+    brpc::Channel* channel = fetch_channel(api, uri);
+    if (channel == nullptr) {
+        response.error_code = EINVAL;
+        return -1;
+    }
+
+    brpc::Controller controller;
+    build_request(controller, uri, method, params, headers, content_type, timeout);
+    if (!request_body.empty()) {
+        controller.request_attachment().append(request_body);
+    }
+    return call(channel, controller, api, response);
+}
+
+int HttpClient::request(const std::string& api, brpc::HttpMethod method,
+        const std::map<std::string, std::string>& params,
+        const std::map<std::string, std::string>& headers,
+        const Model* request_model, Model* response_model,
+        HttpResponse& response, int timeout) {
+    brpc::URI uri;
+    brpc::Channel* channel = fetch_channel(api, uri);
+    if (channel == nullptr) {
+        response.error_code = EINVAL;
         return -1;
     }
 
+    brpc::Controller controller;
+    build_request(controller, uri, method, params, headers, "", timeout);
+    if (request_model != nullptr && !write_model(request_model, controller)) {
+        RELLAF_DEBUG("serialize request model failed, api : %s", api.c_str());
+        return -1;
+    }
+    if (call(channel, controller, api, response) != 0) {
+        return -1;
+    }
+    if (response_model != nullptr && !read_model(response.body, response_model)) {
+        RELLAF_DEBUG("decode response model failed, api : %s", api.c_str());
+        return -1;
+    }
     return 0;
 }
 
+/**
+ * shared by all calls of one batch,
+ * wake up the waiter once `expect` calls succeeded or all calls finished
+ */
+class BatchContext {
+public:
+    BatchContext(uint32_t total, uint32_t expect) : _total(total), _expect(expect) {}
+
+    void finish(bool success) {
+        uint32_t succeeded = success ? RELLAF_ATOMIC_INC(_succeeded) : _succeeded;
+        uint32_t finished = RELLAF_ATOMIC_INC(_finished);
+        if (succeeded >= _expect || finished >= _total) {
+            if (RELLAF_ATOMIC_CAS(_notified, false, true)) {
+                _event.signal();
+            }
+        }
+    }
+
+    void wait() {
+        _event.wait();
+    }
+
+private:
+    const uint32_t _total;
+    const uint32_t _expect;
+    volatile uint32_t _succeeded = 0;
+    volatile uint32_t _finished = 0;
+    volatile bool _notified = false;
+    bthread::CountdownEvent _event{1};
+};
+
+class BatchDone : public google::protobuf::Closure {
+public:
+    BatchDone(BatchContext* context, brpc::Controller* controller) :
+            _context(context), _controller(controller) {}
+
+    void Run() override {
+        _context->finish(!_controller->Failed());
+    }
+
+private:
+    BatchContext* _context;
+    brpc::Controller* _controller;
+};
+
+int HttpClient::batch(const std::vector<HttpRequest>& requests,
+        std::vector<HttpResponse>& responses, int timeout, size_t min_done) {
+    responses.clear();
+    responses.resize(requests.size());
+    if (requests.empty()) {
+        return 0;
+    }
+
+    if (min_done == 0 || min_done > requests.size()) {
+        min_done = requests.size();
+    }
+    BatchContext context((uint32_t)requests.size(), (uint32_t)min_done);
+
+    // deque never relocates elements, controllers and closures MUST be stable during calls
+    std::deque<brpc::Controller> controllers;
+    std::deque<BatchDone> dones;
+    std::vector<brpc::CallId> call_ids;
+    std::vector<bool> issued(requests.size(), false);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const HttpRequest& req = requests[i];
+        controllers.emplace_back();
+        brpc::Controller& controller = controllers.back();
+        dones.emplace_back(&context, &controller);
+        call_ids.emplace_back(controller.call_id());
+
+        brpc::URI uri;
+        brpc::Channel* channel = fetch_channel(req.api, uri);
+        if (channel == nullptr) {
+            responses[i].error_code = EINVAL;
+            responses[i].error_text = "invalid api : " + req.api;
+            context.finish(false);
+            continue;
+        }
+
+        build_request(controller, uri, req.method, req.params, req.headers, req.content_type,
+                timeout);
+        if (!req.body.empty()) {
+            controller.request_attachment().append(req.body);
+        }
+        RELLAF_DEBUG("http batch %s request : %s", brpc::HttpMethod2Str(req.method),
+                req.api.c_str());
+        issued[i] = true;
+        channel->CallMethod(nullptr, &controller, nullptr, nullptr, &dones.back());
+    }
+
+    context.wait();
+
+    // cancel calls not finished yet, then join all to ensure all closures done
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (issued[i]) {
+            brpc::StartCancel(call_ids[i]);
+        }
+    }
+    int succeeded = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!issued[i]) {
+            continue;
+        }
+        brpc::Join(call_ids[i]);
+        fill_response(controllers[i], responses[i]);
+        if (!controllers[i].Failed()) {
+            ++succeeded;
+        }
+    }
+    return succeeded;
+}
+
+int HttpClient::get(const std::string& api, const std::map<std::string, std::string>& params,
+        HttpResponse& response, int timeout) {
+    return request(api, brpc::HTTP_METHOD_GET, params, {}, "", "", response, timeout);
+}
+
+int HttpClient::post(const std::string& api, const std::map<std::string, std::string>& params,
+        const std::string& request_body, HttpResponse& response, int timeout) {
+    return request(api, brpc::HTTP_METHOD_POST, params, {}, "", request_body, response, timeout);
+}
+
+int HttpClient::get(const std::string& api, const std::map<std::string, std::string>& params,
+        Model* response_model, HttpResponse& response, int timeout) {
+    return request(api, brpc::HTTP_METHOD_GET, params, {}, nullptr, response_model,
+            response, timeout);
+}
+
+int HttpClient::post(const std::string& api, const std::map<std::string, std::string>& params,
+        const Model* request_model, Model* response_model, HttpResponse& response,
+        int timeout) {
+    return request(api, brpc::HTTP_METHOD_POST, params, {}, request_model, response_model,
+            response, timeout);
+}
+
+int http_request(const std::string& api, brpc::HttpMethod method,
+        const std::map<std::string, std::string>& params,
+        const std::map<std::string, std::string>& headers,
+        const std::string& content_type, const std::string& request_body,
+        HttpResponse& response, int timeout) {
+    return HttpClient::instance().request(api, method, params, headers, content_type,
+            request_body, response, timeout);
+}
+
 int http_get(const std::string& api, const std::map<std::string, std::string>& params,
         HttpResponse& response, int timeout) {
-    return http_request(api, brpc::HTTP_METHOD_GET, params, {}, "", "", response, timeout);
+    return HttpClient::instance().get(api, params, response, timeout);
 }
 
 int http_post(const std::string& api, const std::map<std::string, std::string>& params,
         const std::string& request_body, HttpResponse& response, int timeout) {
-    return http_request(api, brpc::HTTP_METHOD_POST, params, {},
-            request_body, "", response, timeout);
+    return HttpClient::instance().post(api, params, request_body, response, timeout);
 }
 
 }
@@ -0,0 +1,453 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <pthread.h>
+#include <stddef.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include <typeinfo>
+#include <typeindex>
+#include "google/protobuf/descriptor.h"
+#include "brpc/pb_to_model.h"
+
+namespace rellaf {
+
+using google::protobuf::Descriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+enum ValueKind {
+    KIND_NONE = 0,
+    KIND_INT,
+    KIND_BOOL,
+    KIND_REAL,
+    KIND_STR,
+    KIND_MESSAGE
+};
+
+enum MemberKind {
+    MEMBER_PLAIN = 0,
+    MEMBER_LIST,
+    MEMBER_OBJECT
+};
+
+struct PbField {
+    const FieldDescriptor* field;
+    std::string name;
+    MemberKind member;
+    // offset of plain member from Object*
+    ptrdiff_t offset;
+};
+
+// mapping of one <model class, descriptor> pair
+struct PbMapping {
+    std::vector<PbField> fields;
+};
+
+static ValueKind plain_kind(const Model* model) {
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::CHAR_code:
+        case ModelTypeEnum::INT16_code:
+        case ModelTypeEnum::INT_code:
+        case ModelTypeEnum::INT64_code:
+        case ModelTypeEnum::UINT16_code:
+        case ModelTypeEnum::UINT32_code:
+        case ModelTypeEnum::UINT64_code:
+            return KIND_INT;
+        case ModelTypeEnum::BOOL_code:
+            return KIND_BOOL;
+        case ModelTypeEnum::FLOAT_code:
+        case ModelTypeEnum::DOUBLE_code:
+            return KIND_REAL;
+        case ModelTypeEnum::STR_code:
+            return KIND_STR;
+        default:
+            return is_object(model) ? KIND_MESSAGE : KIND_NONE;
+    }
+}
+
+static ValueKind field_kind(const FieldDescriptor* field) {
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32:
+        case FieldDescriptor::CPPTYPE_INT64:
+        case FieldDescriptor::CPPTYPE_UINT32:
+        case FieldDescriptor::CPPTYPE_UINT64:
+        case FieldDescriptor::CPPTYPE_ENUM:
+            return KIND_INT;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            return KIND_BOOL;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            return KIND_REAL;
+        case FieldDescriptor::CPPTYPE_STRING:
+            return KIND_STR;
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            return KIND_MESSAGE;
+        default:
+            return KIND_NONE;
+    }
+}
+
+static PbMapping* build_mapping(const Object* obj, const Descriptor* desc) {
+    PbMapping* mapping = new(std::nothrow) PbMapping;
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    for (int i = 0; i < desc->field_count(); ++i) {
+        const FieldDescriptor* field = desc->field(i);
+        const std::string& name = field->name();
+        ValueKind kind = field_kind(field);
+
+        auto plain = obj->get_plains().find(name);
+        if (plain != obj->get_plains().end()) {
+            if (!field->is_repeated() && kind == plain_kind(plain->second)) {
+                ptrdiff_t offset = (const char*)plain->second - (const char*)obj;
+                mapping->fields.push_back(PbField{field, name, MEMBER_PLAIN, offset});
+            }
+            continue;
+        }
+        if (obj->is_list_member(name)) {
+            std::unique_ptr<Model> item(obj->create_list_item(name));
+            if (field->is_repeated() && item != nullptr && kind == plain_kind(item.get())) {
+                mapping->fields.push_back(PbField{field, name, MEMBER_LIST, -1});
+            }
+            continue;
+        }
+        if (obj->is_object_member(name)) {
+            if (!field->is_repeated() && kind == KIND_MESSAGE) {
+                mapping->fields.push_back(PbField{field, name, MEMBER_OBJECT, -1});
+            }
+            continue;
+        }
+    }
+    return mapping;
+}
+
+/**
+ * @return mapping of class of `obj` and `desc`, built and cached at the first call
+ */
+static const PbMapping* mapping_of(const Object* obj, const Descriptor* desc) {
+    typedef std::pair<std::type_index, const Descriptor*> Key;
+    static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+    static std::map<Key, std::unique_ptr<PbMapping>> mappings;
+
+    Key key(typeid(*obj), desc);
+    pthread_rwlock_rdlock(&lock);
+    auto entry = mappings.find(key);
+    if (entry != mappings.end()) {
+        const PbMapping* mapping = entry->second.get();
+        pthread_rwlock_unlock(&lock);
+        return mapping;
+    }
+    pthread_rwlock_unlock(&lock);
+
+    std::unique_ptr<PbMapping> built(build_mapping(obj, desc));
+    if (built == nullptr) {
+        return nullptr;
+    }
+    pthread_rwlock_wrlock(&lock);
+    // may be built by others meanwhile, the first one wins
+    const PbMapping* mapping = mappings.emplace(key, std::move(built)).first->second.get();
+    pthread_rwlock_unlock(&lock);
+    return mapping;
+}
+
+static int64_t plain_int(const Model* model) {
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::CHAR_code:
+            return ((Plain<char>*)model)->value();
+        case ModelTypeEnum::INT16_code:
+            return ((Plain<int16_t>*)model)->value();
+        case ModelTypeEnum::INT_code:
+            return ((Plain<int>*)model)->value();
+        case ModelTypeEnum::INT64_code:
+            return ((Plain<int64_t>*)model)->value();
+        case ModelTypeEnum::UINT16_code:
+            return ((Plain<uint16_t>*)model)->value();
+        case ModelTypeEnum::UINT32_code:
+            return ((Plain<uint32_t>*)model)->value();
+        case ModelTypeEnum::UINT64_code:
+            return (int64_t)((Plain<uint64_t>*)model)->value();
+        default:
+            return 0;
+    }
+}
+
+static void set_plain_int(Model* model, int64_t val) {
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::CHAR_code:
+            ((Plain<char>*)model)->set((char)val);
+            break;
+        case ModelTypeEnum::INT16_code:
+            ((Plain<int16_t>*)model)->set((int16_t)val);
+            break;
+        case ModelTypeEnum::INT_code:
+            ((Plain<int>*)model)->set((int)val);
+            break;
+        case ModelTypeEnum::INT64_code:
+            ((Plain<int64_t>*)model)->set(val);
+            break;
+        case ModelTypeEnum::UINT16_code:
+            ((Plain<uint16_t>*)model)->set((uint16_t)val);
+            break;
+        case ModelTypeEnum::UINT32_code:
+            ((Plain<uint32_t>*)model)->set((uint32_t)val);
+            break;
+        case ModelTypeEnum::UINT64_code:
+            ((Plain<uint64_t>*)model)->set((uint64_t)val);
+            break;
+        default:
+            break;
+    }
+}
+
+static double plain_real(const Model* model) {
+    if (model->rellaf_type().code == ModelTypeEnum::FLOAT_code) {
+        return ((Plain<float>*)model)->value();
+    }
+    return ((Plain<double>*)model)->value();
+}
+
+static void set_plain_real(Model* model, double val) {
+    if (model->rellaf_type().code == ModelTypeEnum::FLOAT_code) {
+        ((Plain<float>*)model)->set((float)val);
+    } else {
+        ((Plain<double>*)model)->set(val);
+    }
+}
+
+static bool to_pb(const Object* obj, Message* msg);
+
+static bool from_pb(const Message& msg, Object* obj);
+
+/**
+ * @brief set singular field or add to repeated field by plain `model`
+ */
+static void put_value(const Model* model, Message* msg, const Reflection* ref,
+        const FieldDescriptor* field) {
+    bool add = field->is_repeated();
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32: {
+            int32_t val = (int32_t)plain_int(model);
+            add ? ref->AddInt32(msg, field, val) : ref->SetInt32(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_INT64: {
+            int64_t val = plain_int(model);
+            add ? ref->AddInt64(msg, field, val) : ref->SetInt64(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_UINT32: {
+            uint32_t val = (uint32_t)plain_int(model);
+            add ? ref->AddUInt32(msg, field, val) : ref->SetUInt32(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_UINT64: {
+            uint64_t val = (uint64_t)plain_int(model);
+            add ? ref->AddUInt64(msg, field, val) : ref->SetUInt64(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_ENUM: {
+            int val = (int)plain_int(model);
+            add ? ref->AddEnumValue(msg, field, val) : ref->SetEnumValue(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_BOOL: {
+            bool val = ((Plain<bool>*)model)->value();
+            add ? ref->AddBool(msg, field, val) : ref->SetBool(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_FLOAT: {
+            float val = (float)plain_real(model);
+            add ? ref->AddFloat(msg, field, val) : ref->SetFloat(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_DOUBLE: {
+            double val = plain_real(model);
+            add ? ref->AddDouble(msg, field, val) : ref->SetDouble(msg, field, val);
+            break;
+        }
+        case FieldDescriptor::CPPTYPE_STRING: {
+            const std::string& val = ((Plain<std::string>*)model)->value();
+            add ? ref->AddString(msg, field, val) : ref->SetString(msg, field, val);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief get singular field if `idx` < 0, otherwise `idx`th of repeated field, into plain `model`
+ */
+static void get_value(const Message& msg, const Reflection* ref, const FieldDescriptor* field,
+        int idx, Model* model) {
+    bool rep = idx >= 0;
+    switch (field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_INT32:
+            set_plain_int(model, rep ? ref->GetRepeatedInt32(msg, field, idx) :
+                                 ref->GetInt32(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_INT64:
+            set_plain_int(model, rep ? ref->GetRepeatedInt64(msg, field, idx) :
+                                 ref->GetInt64(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT32:
+            set_plain_int(model, rep ? ref->GetRepeatedUInt32(msg, field, idx) :
+                                 ref->GetUInt32(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_UINT64:
+            set_plain_int(model, (int64_t)(rep ? ref->GetRepeatedUInt64(msg, field, idx) :
+                                           ref->GetUInt64(msg, field)));
+            break;
+        case FieldDescriptor::CPPTYPE_ENUM:
+            set_plain_int(model, rep ? ref->GetRepeatedEnumValue(msg, field, idx) :
+                                 ref->GetEnumValue(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_BOOL:
+            ((Plain<bool>*)model)->set(rep ? ref->GetRepeatedBool(msg, field, idx) :
+                                       ref->GetBool(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_FLOAT:
+            set_plain_real(model, rep ? ref->GetRepeatedFloat(msg, field, idx) :
+                                  ref->GetFloat(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_DOUBLE:
+            set_plain_real(model, rep ? ref->GetRepeatedDouble(msg, field, idx) :
+                                  ref->GetDouble(msg, field));
+            break;
+        case FieldDescriptor::CPPTYPE_STRING:
+            ((Plain<std::string>*)model)->set(rep ? ref->GetRepeatedString(msg, field, idx) :
+                                              ref->GetString(msg, field));
+            break;
+        default:
+            break;
+    }
+}
+
+static bool to_pb(const Object* obj, Message* msg) {
+    const PbMapping* mapping = mapping_of(obj, msg->GetDescriptor());
+    if (mapping == nullptr) {
+        return false;
+    }
+    const Reflection* ref = msg->GetReflection();
+    for (const PbField& entry : mapping->fields) {
+        const FieldDescriptor* field = entry.field;
+        if (entry.member == MEMBER_PLAIN) {
+            put_value((const Model*)((const char*)obj + entry.offset), msg, ref, field);
+            continue;
+        }
+        if (entry.member == MEMBER_LIST) {
+            ref->ClearField(msg, field);
+            bool is_message = field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE;
+            for (const Model* item : obj->get_list(entry.name)) {
+                // null item is written as default value to keep indexes
+                if (is_message) {
+                    Message* sub = ref->AddMessage(msg, field);
+                    if (item != nullptr && !to_pb((const Object*)item, sub)) {
+                        return false;
+                    }
+                } else if (item != nullptr) {
+                    put_value(item, msg, ref, field);
+                } else {
+                    std::unique_ptr<Model> dft(obj->create_list_item(entry.name));
+                    put_value(dft.get(), msg, ref, field);
+                }
+            }
+            continue;
+        }
+        const Object* sub = obj->get_object(entry.name);
+        if (sub == nullptr) {
+            ref->ClearField(msg, field);
+        } else if (!to_pb(sub, ref->MutableMessage(msg, field))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool from_pb(const Message& msg, Object* obj) {
+    const PbMapping* mapping = mapping_of(obj, msg.GetDescriptor());
+    if (mapping == nullptr) {
+        return false;
+    }
+    const Reflection* ref = msg.GetReflection();
+    for (const PbField& entry : mapping->fields) {
+        const FieldDescriptor* field = entry.field;
+        if (entry.member == MEMBER_PLAIN) {
+            get_value(msg, ref, field, -1, (Model*)((char*)obj + entry.offset));
+            continue;
+        }
+        if (entry.member == MEMBER_LIST) {
+            List& list = obj->get_list(entry.name);
+            list.clear();
+            std::unique_ptr<Model> proto(obj->create_list_item(entry.name));
+            bool is_message = field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE;
+            int size = ref->FieldSize(msg, field);
+            for (int i = 0; i < size; ++i) {
+                Model* item = proto->create();
+                if (item == nullptr) {
+                    return false;
+                }
+                list.emplace_back(item);
+                if (is_message) {
+                    if (!from_pb(ref->GetRepeatedMessage(msg, field, i), (Object*)item)) {
+                        return false;
+                    }
+                } else {
+                    get_value(msg, ref, field, i, item);
+                }
+            }
+            continue;
+        }
+        if (!ref->HasField(msg, field)) {
+            obj->reset_object(entry.name, nullptr);
+            continue;
+        }
+        Object* sub = obj->get_object(entry.name);
+        if (sub == nullptr) {
+            sub = obj->create_object(entry.name);
+            if (sub == nullptr) {
+                // abstract type, could not be created
+                continue;
+            }
+            obj->reset_object(entry.name, sub);
+        }
+        if (!from_pb(ref->GetMessage(msg, field), sub)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool model_to_pb(const Model* model, Message* msg) {
+    if (model == nullptr || msg == nullptr || !is_object(model)) {
+        return false;
+    }
+    return to_pb((const Object*)model, msg);
+}
+
+bool pb_to_model(const Message& msg, Model* model) {
+    if (model == nullptr || !is_object(model)) {
+        return false;
+    }
+    return from_pb(msg, (Object*)model);
+}
+
+}
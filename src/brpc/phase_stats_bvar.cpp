@@ -0,0 +1,86 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <ostream>
+#include "gflags/gflags.h"
+#include "bvar/bvar.h"
+#include "brpc/reloadable_flags.h"
+#include "brpc/phase_stats_bvar.h"
+
+DEFINE_bool(rellaf_phase_stats, false, "account cost of request phases, see rellaf::PhaseStats");
+
+namespace rellaf {
+
+namespace {
+
+enum PhaseField {
+    COUNT = 0,
+    CPU_NS,
+    WALL_NS,
+    ALLOCS,
+    ALLOC_BYTES,
+    FIELD_COUNT
+};
+
+const char* s_field_names[FIELD_COUNT] = {"count", "cpu_ns", "wall_ns", "allocs", "alloc_bytes"};
+
+struct PhaseVar {
+    PhaseStats::Phase phase;
+    PhaseField field;
+};
+
+int64_t get_phase_var(void* arg) {
+    const PhaseVar* var = (const PhaseVar*)arg;
+    PhaseStats::Snapshot snapshot;
+    PhaseStats::snapshot(snapshot);
+    const uint64_t* values[FIELD_COUNT] = {snapshot.count, snapshot.cpu_ns, snapshot.wall_ns,
+                                           snapshot.allocs, snapshot.alloc_bytes};
+    return (int64_t)values[var->field][var->phase];
+}
+
+void print_phase_stats(std::ostream& os, void*) {
+    os << PhaseStats::dump(true);
+}
+
+bool validate_phase_stats(const char*, bool value) {
+    PhaseStats::set_enabled(value);
+    return true;
+}
+
+}
+
+void expose_phase_stats() {
+    static bool exposed = [] {
+        // live as long as process
+        for (int i = 0; i < PhaseStats::PHASE_COUNT; ++i) {
+            for (int j = 0; j < FIELD_COUNT; ++j) {
+                PhaseVar* var = new PhaseVar{(PhaseStats::Phase)i, (PhaseField)j};
+                auto* status = new bvar::PassiveStatus<int64_t>(get_phase_var, var);
+                status->expose_as("rellaf_phase", std::string(PhaseStats::name(var->phase)) +
+                                                  "_" + s_field_names[j]);
+            }
+        }
+        auto* dump = new bvar::PassiveStatus<std::string>(print_phase_stats, nullptr);
+        dump->expose("rellaf_phase_stats");
+        return true;
+    }();
+    (void)exposed;
+}
+
+}
+
+BRPC_VALIDATE_GFLAG(rellaf_phase_stats, rellaf::validate_phase_stats);
@@ -0,0 +1,121 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <functional>
+#include <iterator>
+#include "butil/time.h"
+#include "brpc/response_cache.h"
+
+namespace rellaf {
+
+ResponseCache::ResponseCache(const std::string& name, const ResponseCacheOptions& options) :
+        _options(options) {
+    if (_options.shard_num == 0) {
+        _options.shard_num = 1;
+    }
+    _shard_max_bytes = _options.max_bytes / _options.shard_num;
+    _shards.reset(new Shard[_options.shard_num]);
+
+    _hit.expose_as("rellaf_response_cache", name + "_hit");
+    _miss.expose_as("rellaf_response_cache", name + "_miss");
+}
+
+ResponseCache::~ResponseCache() {
+    clear();
+}
+
+ResponseCache::Shard& ResponseCache::shard_of(const std::string& key) {
+    return _shards[std::hash<std::string>()(key) % _options.shard_num];
+}
+
+void ResponseCache::erase(Shard& shard, std::list<Entry>::iterator iter) {
+    shard.bytes -= iter->body.size();
+    shard.index.erase(iter->key);
+    shard.lru.erase(iter);
+}
+
+bool ResponseCache::get(const std::string& key, butil::IOBuf& body) {
+    Shard& shard = shard_of(key);
+    int64_t now_us = butil::monotonic_time_us();
+
+    pthread_mutex_lock(&shard.mutex);
+    auto entry = shard.index.find(key);
+    if (entry == shard.index.end()) {
+        pthread_mutex_unlock(&shard.mutex);
+        _miss << 1;
+        return false;
+    }
+    auto iter = entry->second;
+    if (iter->expire_us <= now_us) {
+        erase(shard, iter);
+        pthread_mutex_unlock(&shard.mutex);
+        _miss << 1;
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter);
+    body.append(iter->body);
+    pthread_mutex_unlock(&shard.mutex);
+
+    _hit << 1;
+    return true;
+}
+
+void ResponseCache::put(const std::string& key, const butil::IOBuf& body) {
+    if (body.size() > _shard_max_bytes) {
+        RELLAF_DEBUG("response of %s too large to cache : %zu", key.c_str(), body.size());
+        return;
+    }
+    Shard& shard = shard_of(key);
+    int64_t expire_us = butil::monotonic_time_us() + _options.ttl_ms * 1000;
+
+    pthread_mutex_lock(&shard.mutex);
+    auto entry = shard.index.find(key);
+    if (entry != shard.index.end()) {
+        erase(shard, entry->second);
+    }
+    while (!shard.lru.empty() && shard.bytes + body.size() > _shard_max_bytes) {
+        erase(shard, std::prev(shard.lru.end()));
+    }
+    shard.lru.push_front(Entry{key, body, expire_us});
+    shard.index.emplace(key, shard.lru.begin());
+    shard.bytes += body.size();
+    pthread_mutex_unlock(&shard.mutex);
+}
+
+void ResponseCache::clear() {
+    for (size_t i = 0; i < _options.shard_num; ++i) {
+        Shard& shard = _shards[i];
+        pthread_mutex_lock(&shard.mutex);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+}
+
+size_t ResponseCache::bytes() {
+    size_t total = 0;
+    for (size_t i = 0; i < _options.shard_num; ++i) {
+        Shard& shard = _shards[i];
+        pthread_mutex_lock(&shard.mutex);
+        total += shard.bytes;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    return total;
+}
+
+}
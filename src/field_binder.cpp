@@ -0,0 +1,110 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include "field_binder.h"
+
+namespace rellaf {
+
+// seeds tried for each table size before doubling it
+static const uint64_t MAX_SEED_TRY = 64;
+
+FieldBinder::FieldBinder(const Object* prototype) {
+    std::vector<Slot> slots;
+    for (auto& entry : prototype->get_plains()) {
+        Slot slot;
+        slot.name = entry.first;
+        slot.offset = (const char*)entry.second - (const char*)prototype;
+        slot.index = slots.size();
+        slots.emplace_back(slot);
+    }
+    if (slots.empty()) {
+        return;
+    }
+
+    size_t capacity = 2;
+    while (capacity < slots.size() * 2) {
+        capacity <<= 1;
+    }
+    while (true) {
+        for (uint64_t seed = 0; seed < MAX_SEED_TRY; ++seed) {
+            if (place(slots, capacity, seed)) {
+                RELLAF_DEBUG("field binder of %s, size : %zu, capacity : %zu, seed : %lu",
+                        prototype->rellaf_name().c_str(), _size, capacity, seed);
+                return;
+            }
+        }
+        capacity <<= 1;
+    }
+}
+
+bool FieldBinder::place(const std::vector<Slot>& slots, size_t capacity, uint64_t seed) {
+    std::vector<Slot> table(capacity);
+    size_t mask = capacity - 1;
+    for (const Slot& slot : slots) {
+        Slot& pos = table[hash(slot.name.data(), slot.name.size(), seed) & mask];
+        if (pos.offset >= 0) {
+            return false;
+        }
+        pos = slot;
+    }
+    _table.swap(table);
+    _seed = seed;
+    _mask = mask;
+    _size = slots.size();
+    return true;
+}
+
+uint64_t FieldBinder::hash(const char* key, size_t len, uint64_t seed) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return h ^ (h >> 29);
+}
+
+const FieldBinder::Slot* FieldBinder::find(const char* key, size_t len) const {
+    if (_size == 0) {
+        return nullptr;
+    }
+    const Slot& slot = _table[hash(key, len, _seed) & _mask];
+    if (slot.offset < 0 || slot.name.size() != len || slot.name.compare(0, len, key, len) != 0) {
+        return nullptr;
+    }
+    return &slot;
+}
+
+Model* FieldBinder::field(Object* obj, const char* key, size_t len) const {
+    if (obj == nullptr) {
+        return nullptr;
+    }
+    const Slot* slot = find(key, len);
+    return slot == nullptr ? nullptr : (Model*)((char*)obj + slot->offset);
+}
+
+bool FieldBinder::set_plain(Object* obj, const std::string& key, const std::string& val) const {
+    const Slot* slot = obj == nullptr ? nullptr : find(key.data(), key.size());
+    if (slot == nullptr) {
+        return false;
+    }
+    obj->lazy_drop(slot->name);
+    obj->mark_dirty(slot->index);
+    return ((Model*)((char*)obj + slot->offset))->set_parse(val);
+}
+
+}
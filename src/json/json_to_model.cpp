@@ -15,7 +15,9 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <string.h>
 #include <memory>
+#include <unordered_map>
 #include "json/json.h"
 #include "json/json_to_model.h"
 
@@ -67,7 +69,7 @@ static void model_to_json_inner(const Model* model, Json::Value& json) {
 
     if (model->rellaf_type() == ModelTypeEnum::e().LIST) {
         json = Json::Value(Json::arrayValue);
-        for (auto& item : *((List*)model)) {
+        for (const Model* item : *((const List*)model)) {
             Json::Value item_node;
             model_to_json_inner(item, item_node);
             json.append(item_node);
@@ -77,17 +79,17 @@ static void model_to_json_inner(const Model* model, Json::Value& json) {
 
     if (model->rellaf_type() == ModelTypeEnum::e().OBJECT) {
         json = Json::Value(Json::objectValue);
-        for (auto& item : ((Object*)model)->get_plains()) {
+        for (auto& item : ((const Object*)model)->get_plains()) {
             Json::Value item_node;
             model_to_json_inner(item.second, item_node);
             json[item.first] = item_node;
         }
-        for (auto& item : ((Object*)model)->get_lists()) {
+        for (auto& item : ((const Object*)model)->get_lists()) {
             Json::Value item_node(Json::arrayValue);
             model_to_json_inner(&item.second, item_node);
             json[item.first] = item_node;
         }
-        for (auto& item : ((Object*)model)->get_objects()) {
+        for (auto& item : ((const Object*)model)->get_objects()) {
             Json::Value item_node;
             model_to_json_inner(item.second, item_node);
             json[item.first] = item_node;
@@ -107,6 +109,18 @@ bool model_to_json(const Model* model, std::string& json_str, bool is_format) {
     return true;
 }
 
+bool model_to_json(const Model* model, std::ostream& os, bool is_format) {
+    Json::Value node;
+    model_to_json_inner(model, node);
+    Json::StreamWriterBuilder builder;
+    if (!is_format) {
+        builder.settings_["indentation"] = "";
+    }
+    std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+    writer->write(node, &os);
+    return os.good();
+}
+
 static void json_to_model_inner(const Json::Value& json, Model* model) {
     if (model == nullptr || json.isNull()) {
         return;
@@ -160,7 +174,7 @@ static void json_to_model_inner(const Json::Value& json, Model* model) {
             return;
         case ModelTypeEnum::DOUBLE_code:
             if (json.isDouble()) {
-                ((Plain<float>*)model)->set(json.asFloat());
+                ((Plain<double>*)model)->set(json.asDouble());
             }
             return;
         case ModelTypeEnum::STR_code:
@@ -200,7 +214,11 @@ static void json_to_model_inner(const Json::Value& json, Model* model) {
 }
 
 bool json_to_model(const std::string& json_str, Model* model) {
-    if (json_str.empty()) {
+    return json_to_model(json_str.data(), json_str.size(), model);
+}
+
+bool json_to_model(const char* json_buf, size_t len, Model* model) {
+    if (json_buf == nullptr || len == 0) {
         return true;
     }
 
@@ -209,7 +227,7 @@ bool json_to_model(const std::string& json_str, Model* model) {
     Json::CharReaderBuilder builder;
     builder["collectComments"] = false;
     std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-    if (!reader->parse(json_str.data(), json_str.data() + json_str.size(), &json, &err)) {
+    if (!reader->parse(json_buf, json_buf + len, &json, &err)) {
         RELLAF_DEBUG("not json, could not parse to MODEL");
         return false;
     }
@@ -217,4 +235,287 @@ bool json_to_model(const std::string& json_str, Model* model) {
     return true;
 }
 
-}
\ No newline at end of file
+/**
+ * members of one json object indexed by key, value text is decoded at first access
+ */
+class JsonLazySource : public LazySource {
+public:
+    explicit JsonLazySource(const std::shared_ptr<const std::string>& body) : _body(body) {}
+
+    ~JsonLazySource() override = default;
+
+    /**
+     * @brief index keys of json object at [begin, end) of body which are members of `obj`
+     * @return false if not a well formed object
+     */
+    bool index(const Object* obj, size_t begin, size_t end);
+
+    void load(Object* obj, const std::string& name) override {
+        auto entry = _members.find(name);
+        if (entry == _members.end()) {
+            return;
+        }
+        Slice slice = entry->second;
+        _members.erase(entry);
+        decode(obj, name, slice);
+    }
+
+    void load_all(Object* obj) override {
+        std::unordered_map<std::string, Slice> members;
+        members.swap(_members);
+        for (auto& entry : members) {
+            decode(obj, entry.first, entry.second);
+        }
+    }
+
+    void drop(const std::string& name) override {
+        _members.erase(name);
+    }
+
+    bool empty() const override {
+        return _members.empty();
+    }
+
+private:
+    struct Slice {
+        size_t offset;
+        size_t len;
+    };
+
+    static void skip_space(const char* buf, size_t end, size_t& pos) {
+        while (pos < end && (buf[pos] == ' ' || buf[pos] == '\t' ||
+                buf[pos] == '\r' || buf[pos] == '\n')) {
+            ++pos;
+        }
+    }
+
+    // `pos` at the open quote, moved after the close quote
+    static bool skip_string(const char* buf, size_t end, size_t& pos, bool* escaped) {
+        for (++pos; pos < end; ++pos) {
+            if (buf[pos] == '\\') {
+                if (escaped != nullptr) {
+                    *escaped = true;
+                }
+                ++pos;
+            } else if (buf[pos] == '"') {
+                ++pos;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // `pos` at the first char of value, moved after the value
+    static bool skip_value(const char* buf, size_t end, size_t& pos) {
+        if (pos >= end) {
+            return false;
+        }
+        if (buf[pos] == '"') {
+            return skip_string(buf, end, pos, nullptr);
+        }
+        if (buf[pos] != '{' && buf[pos] != '[') {
+            size_t begin = pos;
+            while (pos < end && buf[pos] != ',' && buf[pos] != '}' && buf[pos] != ']' &&
+                    buf[pos] != ' ' && buf[pos] != '\t' && buf[pos] != '\r' && buf[pos] != '\n') {
+                ++pos;
+            }
+            return pos > begin;
+        }
+        std::string brackets;
+        while (pos < end) {
+            char c = buf[pos];
+            if (c == '"') {
+                if (!skip_string(buf, end, pos, nullptr)) {
+                    return false;
+                }
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                brackets += c;
+            } else if (c == '}' || c == ']') {
+                if (brackets.empty() || brackets.back() != (c == '}' ? '{' : '[')) {
+                    return false;
+                }
+                brackets.pop_back();
+                if (brackets.empty()) {
+                    ++pos;
+                    return true;
+                }
+            }
+            ++pos;
+        }
+        return false;
+    }
+
+    bool parse(const Slice& slice, Json::Value& json) {
+        if (!_reader) {
+            Json::CharReaderBuilder builder;
+            builder["collectComments"] = false;
+            builder["failIfExtra"] = true;
+            _reader.reset(builder.newCharReader());
+        }
+        const char* begin = _body->data() + slice.offset;
+        std::string err;
+        return _reader->parse(begin, begin + slice.len, &json, &err);
+    }
+
+    void decode(Object* obj, const std::string& name, const Slice& slice);
+
+private:
+    std::shared_ptr<const std::string> _body;
+    // <member name, value text> not decoded yet
+    std::unordered_map<std::string, Slice> _members;
+    std::unique_ptr<Json::CharReader> _reader;
+};
+
+bool JsonLazySource::index(const Object* obj, size_t begin, size_t end) {
+    const char* buf = _body->data();
+    size_t pos = begin;
+    skip_space(buf, end, pos);
+    if (pos >= end || buf[pos] != '{') {
+        return false;
+    }
+    ++pos;
+    skip_space(buf, end, pos);
+    if (pos < end && buf[pos] == '}') {
+        ++pos;
+    } else {
+        while (true) {
+            if (pos >= end || buf[pos] != '"') {
+                return false;
+            }
+            size_t key_begin = pos + 1;
+            bool escaped = false;
+            if (!skip_string(buf, end, pos, &escaped)) {
+                return false;
+            }
+            // escaped key never matches a member name
+            std::string key(buf + key_begin, pos - 1 - key_begin);
+            skip_space(buf, end, pos);
+            if (pos >= end || buf[pos] != ':') {
+                return false;
+            }
+            ++pos;
+            skip_space(buf, end, pos);
+            size_t value_begin = pos;
+            if (!skip_value(buf, end, pos)) {
+                return false;
+            }
+            if (!escaped && (obj->is_plain_member(key) || obj->is_list_member(key) ||
+                    obj->is_object_member(key))) {
+                // the last one wins as jsoncpp does
+                _members[key] = Slice{value_begin, pos - value_begin};
+            }
+            skip_space(buf, end, pos);
+            if (pos < end && buf[pos] == ',') {
+                ++pos;
+                skip_space(buf, end, pos);
+                continue;
+            }
+            if (pos < end && buf[pos] == '}') {
+                ++pos;
+                break;
+            }
+            return false;
+        }
+    }
+    skip_space(buf, end, pos);
+    return pos == end;
+}
+
+void JsonLazySource::decode(Object* obj, const std::string& name, const Slice& slice) {
+    const char* text = _body->data() + slice.offset;
+    // null value not converted, the same as `json_to_model`
+    if (slice.len == 4 && strncmp(text, "null", 4) == 0) {
+        return;
+    }
+
+    if (obj->is_plain_member(name)) {
+        Model* plain = obj->get_plain(name);
+        // string without escape taken in place
+        if (plain->rellaf_type() == ModelTypeEnum::e().STR && text[0] == '"' &&
+                memchr(text, '\\', slice.len) == nullptr) {
+            ((Plain<std::string>*)plain)->set(std::string(text + 1, slice.len - 2));
+            return;
+        }
+        Json::Value json;
+        if (parse(slice, json)) {
+            json_to_model_inner(json, plain);
+        }
+        return;
+    }
+
+    if (obj->is_list_member(name)) {
+        Json::Value json;
+        if (!parse(slice, json) || !json.isArray()) {
+            return;
+        }
+        std::unique_ptr<Model> proto(obj->create_list_item(name));
+        if (proto == nullptr) {
+            return;
+        }
+        List& list = obj->get_list(name);
+        list.clear();
+        for (const Json::Value& item_json : json) {
+            if (item_json.isNull()) {
+                list.emplace_back(nullptr);
+                continue;
+            }
+            Model* item = proto->create();
+            if (item == nullptr) {
+                return;
+            }
+            json_to_model_inner(item_json, item);
+            list.emplace_back(item);
+        }
+        return;
+    }
+
+    if (obj->is_object_member(name) && text[0] == '{') {
+        Object* sub = obj->get_object(name);
+        if (sub == nullptr) {
+            sub = obj->create_object(name);
+            if (sub == nullptr) {
+                return;
+            }
+            obj->reset_object(name, sub);
+        }
+        // nested object is lazy too, sharing the body
+        JsonLazySource* source = new(std::nothrow) JsonLazySource(_body);
+        if (source == nullptr) {
+            return;
+        }
+        if (!source->index(sub, slice.offset, slice.offset + slice.len)) {
+            delete source;
+            return;
+        }
+        sub->set_lazy_source(source);
+    }
+}
+
+bool json_to_model_lazy(const std::string& json_str, Object* model) {
+    return json_to_model_lazy(json_str.data(), json_str.size(), model);
+}
+
+bool json_to_model_lazy(const char* json_buf, size_t len, Object* model) {
+    if (model == nullptr) {
+        return false;
+    }
+    if (json_buf == nullptr || len == 0) {
+        return true;
+    }
+    std::shared_ptr<const std::string> body = std::make_shared<const std::string>(json_buf, len);
+    JsonLazySource* source = new(std::nothrow) JsonLazySource(body);
+    if (source == nullptr) {
+        return false;
+    }
+    if (!source->index(model, 0, len)) {
+        RELLAF_DEBUG("not json object, could not index to MODEL");
+        delete source;
+        return false;
+    }
+    model->set_lazy_source(source);
+    return true;
+}
+
+}
@@ -0,0 +1,192 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <time.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "load_runner.h"
+
+namespace rellaf {
+
+static const size_t SUB_BUCKETS = 64;
+// exact values below, then 64 sub buckets of each power of 2 up to 2^63
+static const size_t EXACT = SUB_BUCKETS * 2;
+static const size_t BUCKETS = EXACT + (63 - 6) * SUB_BUCKETS;
+
+static uint64_t monotonic_ns() {
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000000000 + tspec.tv_nsec;
+}
+
+LatencyHistogram::LatencyHistogram() : _buckets(BUCKETS, 0) {}
+
+size_t LatencyHistogram::index_of(uint64_t ns) {
+    if (ns < EXACT) {
+        return (size_t)ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - 6;
+    return EXACT + (size_t)(msb - 7) * SUB_BUCKETS + (size_t)((ns >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::upper_of(size_t idx) {
+    if (idx < EXACT) {
+        return idx;
+    }
+    size_t k = idx - EXACT;
+    int shift = (int)(k / SUB_BUCKETS) + 1;
+    uint64_t sub = k % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::add(uint64_t ns) {
+    ++_buckets[index_of(ns)];
+    ++_count;
+    _sum += ns;
+    _min = std::min(_min, ns);
+    _max = std::max(_max, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& o) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        _buckets[i] += o._buckets[i];
+    }
+    _count += o._count;
+    _sum += o._sum;
+    _min = std::min(_min, o._min);
+    _max = std::max(_max, o._max);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(_buckets.begin(), _buckets.end(), 0);
+    _count = 0;
+    _sum = 0;
+    _min = UINT64_MAX;
+    _max = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double ratio) const {
+    if (_count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)ceil(ratio * _count);
+    target = std::max<uint64_t>(1, std::min(target, _count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += _buckets[i];
+        if (seen >= target) {
+            return std::min(std::max(upper_of(i), _min), _max);
+        }
+    }
+    return _max;
+}
+
+std::string LoadRunner::Report::str() const {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "threads=%d calls=%lu errors=%lu seconds=%.3f qps=%.1f "
+                               "latency_us mean=%.1f p50=%.1f p99=%.1f p999=%.1f max=%.1f",
+            threads, (unsigned long)calls, (unsigned long)errors, seconds, qps,
+            mean_us, p50_us, p99_us, p999_us, max_us);
+    return buf;
+}
+
+std::string LoadRunner::Report::json() const {
+    char buf[512];
+    snprintf(buf, sizeof(buf), R"({"threads":%d,"calls":%lu,"errors":%lu,"seconds":%.3f,)"
+                               R"("qps":%.1f,"mean_us":%.1f,"p50_us":%.1f,"p99_us":%.1f,)"
+                               R"("p999_us":%.1f,"max_us":%.1f})",
+            threads, (unsigned long)calls, (unsigned long)errors, seconds, qps,
+            mean_us, p50_us, p99_us, p999_us, max_us);
+    return buf;
+}
+
+LoadRunner::LoadRunner(int threads, uint32_t duration_ms, uint64_t max_calls) :
+        _threads(threads < 1 ? 1 : threads),
+        _duration_ms(duration_ms),
+        _max_calls(max_calls) {}
+
+LoadRunner::Report LoadRunner::run(const Call& call) {
+    std::vector<LatencyHistogram> histograms(_threads);
+    std::vector<uint64_t> errors(_threads, 0);
+    std::atomic<bool> measuring(_warmup_ms == 0);
+    std::atomic<bool> stop(false);
+    std::atomic<int> running(_threads);
+
+    std::vector<std::thread> threads;
+    for (int idx = 0; idx < _threads; ++idx) {
+        threads.emplace_back([&, idx]() {
+            LatencyHistogram& histogram = histograms[idx];
+            uint64_t made = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                bool measured = measuring.load(std::memory_order_relaxed);
+                uint64_t begin = monotonic_ns();
+                bool ok = call(idx);
+                uint64_t end = monotonic_ns();
+                if (!measured) {
+                    continue;
+                }
+                histogram.add(end - begin);
+                if (!ok) {
+                    ++errors[idx];
+                }
+                if (_max_calls > 0 && ++made >= _max_calls) {
+                    break;
+                }
+            }
+            running.fetch_sub(1);
+        });
+    }
+
+    if (_warmup_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(_warmup_ms));
+        measuring = true;
+    }
+    uint64_t begin = monotonic_ns();
+    uint64_t deadline = begin + (uint64_t)_duration_ms * 1000000;
+    while (running.load() > 0 && monotonic_ns() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t elapsed = monotonic_ns() - begin;
+
+    _histogram.clear();
+    Report report;
+    report.threads = _threads;
+    for (int idx = 0; idx < _threads; ++idx) {
+        _histogram.merge(histograms[idx]);
+        report.errors += errors[idx];
+    }
+    report.calls = _histogram.count();
+    report.seconds = elapsed / 1e9;
+    report.qps = report.seconds > 0 ? report.calls / report.seconds : 0;
+    report.mean_us = _histogram.mean() / 1000;
+    report.p50_us = _histogram.percentile(0.5) / 1000.0;
+    report.p99_us = _histogram.percentile(0.99) / 1000.0;
+    report.p999_us = _histogram.percentile(0.999) / 1000.0;
+    report.max_us = _histogram.max() / 1000.0;
+    return report;
+}
+
+}
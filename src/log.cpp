@@ -0,0 +1,361 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include "log.h"
+
+namespace rellaf {
+
+namespace {
+
+thread_local std::string t_buf;
+thread_local bool t_busy = false;
+thread_local pid_t t_tid = 0;
+// "20181019 12:00:00" of `t_second`
+thread_local time_t t_second = 0;
+thread_local char t_second_str[32];
+
+const char s_level_chars[] = {'D', 'I', 'W', 'E', 'F'};
+
+const char* base_name(const char* file) {
+    const char* slash = strrchr(file, '/');
+    return slash == nullptr ? file : slash + 1;
+}
+
+bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+}
+
+std::atomic<int> Logger::_s_level(RELLAF_LOG_MIN_LEVEL);
+
+Logger& Logger::instance() {
+    // never destructed, lines logged by static destructors still written
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() {
+    if (pthread_create(&_writer, nullptr, run, this) != 0) {
+        // synchronous
+        _stopped = true;
+        return;
+    }
+    atexit(stop_at_exit);
+}
+
+void Logger::set_level(int level) {
+    _s_level = level;
+}
+
+bool Logger::open(const LoggerOptions& options) {
+    int fd = 1;
+    size_t file_bytes = 0;
+    if (!options.path.empty()) {
+        fd = ::open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            file_bytes = (size_t)st.st_size;
+        }
+    }
+    pthread_mutex_lock(&_io_lock);
+    if (_fd != 1) {
+        ::close(_fd);
+    }
+    _options = options;
+    _max_pending = options.max_pending;
+    _fd = fd;
+    _file_bytes = file_bytes;
+    pthread_mutex_unlock(&_io_lock);
+    return true;
+}
+
+void Logger::submit(const std::string& line) {
+    if (_stopped.load(std::memory_order_acquire)) {
+        write_batch(line);
+        return;
+    }
+    if (_pending.fetch_add(1, std::memory_order_relaxed) >=
+            _max_pending.load(std::memory_order_relaxed)) {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Node* node = new(std::nothrow) Node;
+    if (node == nullptr) {
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    node->line = line;
+    push(node);
+}
+
+void Logger::push(Node* node) {
+    Node* head = _head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!_head.compare_exchange_weak(head, node, std::memory_order_seq_cst,
+            std::memory_order_relaxed));
+    // stopped after the check of caller, the final drain may have passed, no one else takes it
+    if (_stopped.load(std::memory_order_seq_cst)) {
+        drain();
+        return;
+    }
+    if (head == nullptr) {
+        // a lost wakeup delays the writer by one wait timeout at most
+        pthread_cond_signal(&_cond);
+    }
+}
+
+void Logger::drain() {
+    std::string batch;
+    consume(_head.exchange(nullptr, std::memory_order_seq_cst), batch);
+}
+
+void Logger::flush() {
+    if (_stopped.load(std::memory_order_acquire)) {
+        return;
+    }
+    bool done = false;
+    Node marker;
+    marker.done = &done;
+    // marked done by whoever drains it, the writer, the final drain or `push` itself
+    push(&marker);
+    pthread_mutex_lock(&_lock);
+    while (!done) {
+        pthread_cond_wait(&_flush_cond, &_lock);
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+void* Logger::run(void* arg) {
+    Logger* logger = (Logger*)arg;
+    std::string batch;
+    while (true) {
+        Node* head = logger->_head.exchange(nullptr, std::memory_order_acquire);
+        if (head == nullptr) {
+            pthread_mutex_lock(&logger->_lock);
+            if (logger->_stop) {
+                pthread_mutex_unlock(&logger->_lock);
+                break;
+            }
+            if (logger->_head.load(std::memory_order_relaxed) == nullptr) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += 50 * 1000000;
+                if (deadline.tv_nsec >= 1000000000) {
+                    deadline.tv_sec += 1;
+                    deadline.tv_nsec -= 1000000000;
+                }
+                pthread_cond_timedwait(&logger->_cond, &logger->_lock, &deadline);
+            }
+            pthread_mutex_unlock(&logger->_lock);
+            continue;
+        }
+
+        logger->consume(head, batch);
+    }
+    return nullptr;
+}
+
+void Logger::stop_at_exit() {
+    Logger& logger = instance();
+    pthread_mutex_lock(&logger._lock);
+    logger._stop = true;
+    pthread_cond_signal(&logger._cond);
+    pthread_mutex_unlock(&logger._lock);
+    // writer drains queue before exit
+    pthread_join(logger._writer, nullptr);
+    logger._stopped.store(true, std::memory_order_seq_cst);
+    // pushed between the last drain and `_stopped`, later ones are drained by pushers
+    logger.drain();
+}
+
+void Logger::consume(Node* head, std::string& batch) {
+    // pushed as stack, reversed to order of submitting
+    Node* list = nullptr;
+    while (head != nullptr) {
+        Node* next = head->next;
+        head->next = list;
+        list = head;
+        head = next;
+    }
+    batch.clear();
+    bool has_marker = false;
+    size_t lines = 0;
+    for (Node* node = list; node != nullptr; node = node->next) {
+        if (node->done != nullptr) {
+            has_marker = true;
+            continue;
+        }
+        batch += node->line;
+        ++lines;
+    }
+    write_batch(batch);
+    _pending.fetch_sub(lines, std::memory_order_relaxed);
+
+    if (has_marker) {
+        pthread_mutex_lock(&_lock);
+    }
+    while (list != nullptr) {
+        Node* next = list->next;
+        if (list->done != nullptr) {
+            *list->done = true;
+        } else {
+            delete list;
+        }
+        list = next;
+    }
+    if (has_marker) {
+        pthread_cond_broadcast(&_flush_cond);
+        pthread_mutex_unlock(&_lock);
+    }
+}
+
+void Logger::write_batch(const std::string& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    pthread_mutex_lock(&_io_lock);
+    write_all(_fd, batch.data(), batch.size());
+    if (_fd != 1) {
+        _file_bytes += batch.size();
+        if (_options.rotate_bytes > 0 && _file_bytes >= _options.rotate_bytes) {
+            rotate();
+        }
+    }
+    pthread_mutex_unlock(&_io_lock);
+}
+
+void Logger::rotate() {
+    const std::string& path = _options.path;
+    for (int i = _options.max_files - 1; i >= 1; --i) {
+        rename((path + "." + std::to_string(i)).c_str(),
+                (path + "." + std::to_string(i + 1)).c_str());
+    }
+    if (_options.max_files > 0) {
+        rename(path.c_str(), (path + ".1").c_str());
+    } else {
+        unlink(path.c_str());
+    }
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        ::close(_fd);
+        _fd = fd;
+        _file_bytes = 0;
+    }
+}
+
+LogStream::LogStream(int level, const char* file, int line) : _level(level) {
+    if (!t_busy) {
+        t_busy = true;
+        _buf = &t_buf;
+        _buf->clear();
+    } else {
+        _buf = &_own;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec != t_second) {
+        struct tm tm;
+        localtime_r(&tv.tv_sec, &tm);
+        strftime(t_second_str, sizeof(t_second_str), "%Y%m%d %H:%M:%S", &tm);
+        t_second = tv.tv_sec;
+    }
+    if (t_tid == 0) {
+        t_tid = (pid_t)syscall(SYS_gettid);
+    }
+    char prefix[128];
+    int len = snprintf(prefix, sizeof(prefix), "%c %s.%06ld %d %s:%d] ",
+            s_level_chars[level < 0 ? 0 : (level > 4 ? 4 : level)], t_second_str,
+            (long)tv.tv_usec, (int)t_tid, base_name(file), line);
+    _buf->append(prefix, len < (int)sizeof(prefix) ? (size_t)len : sizeof(prefix) - 1);
+}
+
+LogStream::~LogStream() {
+    _buf->push_back('\n');
+    Logger& logger = Logger::instance();
+    logger.submit(*_buf);
+    if (_buf == &t_buf) {
+        t_busy = false;
+    }
+    if (_level >= RELLAF_LOG_LEVEL_FATAL) {
+        logger.flush();
+    }
+}
+
+LogStream& LogStream::operator<<(double val) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%g", val);
+    _buf->append(buf, (size_t)len);
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const void* val) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%p", val);
+    _buf->append(buf, (size_t)len);
+    return *this;
+}
+
+void LogStream::append_int(int64_t val) {
+    if (val < 0) {
+        _buf->push_back('-');
+        append_uint(0 - (uint64_t)val);
+        return;
+    }
+    append_uint((uint64_t)val);
+}
+
+void LogStream::append_uint(uint64_t val) {
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = (char)('0' + val % 10);
+        val /= 10;
+    } while (val != 0);
+    _buf->append(p, (size_t)(end - p));
+}
+
+}
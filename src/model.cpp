@@ -15,6 +15,10 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <pthread.h>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
 #include "model.h"
 
 namespace rellaf {
@@ -27,9 +31,7 @@ Model* Void::clone() const {
     return create();
 }
 
-List::~List() {
-    clear();
-}
+List::~List() = default;
 
 List::List() : Model() {
     _type = ModelTypeEnum::e().LIST;
@@ -42,8 +44,7 @@ List::List(const List& o) : Model() {
 
 List::List(List&& o) noexcept : Model() {
     _type = ModelTypeEnum::e().LIST;
-    assign(&o);
-    o.clear();
+    _items = std::move(o._items);
 }
 
 List& List::operator=(const List& o) {
@@ -54,14 +55,13 @@ List& List::operator=(const List& o) {
 
 List& List::operator=(List&& o) noexcept {
     _type = ModelTypeEnum::e().LIST;
-    assign(&o);
-    o.clear();
+    _items = std::move(o._items);
     return *this;
 }
 
 std::string List::debug_str() const {
     std::string buf = "[";
-    for (auto& item : _items) {
+    for (const Model* item : *this) {
         buf += item == nullptr ? "NULL" : item->debug_str();
         buf += ", ";
     }
@@ -75,76 +75,165 @@ std::string List::debug_str() const {
 }
 
 size_t List::size() const {
-    return _items.size();
+    return _items == nullptr ? 0 : _items->size();
 }
 
 bool List::empty() const {
-    return _items.empty();
+    return size() == 0;
 }
 
 void List::clear() {
-    for (auto& item : _items) {
-        delete item;
+    _items.reset();
+}
+
+List::Items& List::mutable_items() {
+    if (_items == nullptr) {
+        _items = std::make_shared<Items>();
+    } else if (_items.use_count() > 1) {
+        _items = std::make_shared<Items>(*_items);
     }
-    _items.clear();
+    return *_items;
 }
 
-void List::push_front(Model* model) {
-    if (model == nullptr) {
-        _items.push_front(nullptr);
-    } else {
-        _items.push_front(model->clone());
+Model* List::mutable_item(size_t idx) {
+    std::shared_ptr<Model>& item = mutable_items()[idx];
+    if (item != nullptr && item.use_count() > 1) {
+        item.reset(item->clone());
     }
+    return item.get();
+}
+
+void List::push_front(Model* model) {
+    mutable_items().emplace_front(model == nullptr ? nullptr : model->clone());
 }
 
 void List::push_back(Model* model) {
-    if (model == nullptr) {
-        _items.push_back(nullptr);
-    } else {
-        _items.push_back(model->clone());
-    }
+    mutable_items().emplace_back(model == nullptr ? nullptr : model->clone());
+}
+
+void List::emplace_back(Model* model) {
+    mutable_items().emplace_back(model);
+}
+
+void List::push_back(const std::shared_ptr<const Model>& model) {
+    mutable_items().emplace_back(std::const_pointer_cast<Model>(model));
 }
 
 void List::pop_front() {
-    if (!_items.empty()) {
-        delete _items.front();
+    if (!empty()) {
+        mutable_items().pop_front();
     }
-    _items.pop_front();
 }
 
 void List::pop_back() {
-    if (!_items.empty()) {
-        delete _items.back();
+    if (!empty()) {
+        mutable_items().pop_back();
     }
-    _items.pop_back();
 }
 
 void List::set(size_t idx, Model* model) {
-    if (idx >= _items.size()) {
+    if (idx >= size()) {
         return;
     }
-    delete _items[idx];
-    _items[idx] = model == nullptr ? nullptr : model->clone();
+    mutable_items()[idx].reset(model == nullptr ? nullptr : model->clone());
+}
+
+std::shared_ptr<const Model> List::share(size_t idx) const {
+    if (idx >= size()) {
+        return nullptr;
+    }
+    return (*_items)[idx];
 }
 
 const Model* List::operator[](size_t idx) const {
     return at(idx);
 }
 
-std::deque<Model*>::const_iterator List::begin() const {
-    return _items.begin();
+// begin and end of empty list
+static const List::Items s_empty_items;
+
+List::ConstIterator List::begin() const {
+    return ConstIterator(_items == nullptr ? s_empty_items.begin() : _items->begin());
+}
+
+List::ConstIterator List::end() const {
+    return ConstIterator(_items == nullptr ? s_empty_items.end() : _items->end());
 }
 
-std::deque<Model*>::const_iterator List::end() const {
-    return _items.end();
+std::atomic<const void*> ModelMeta::_s_recording(nullptr);
+ModelMeta* ModelMeta::_s_building = nullptr;
+// one prototype recorded at a time
+static pthread_mutex_t s_record_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// field ids are 18 bits, so a field key of binary codec takes at most 3 bytes
+static const uint32_t FIELD_ID_MASK = (1U << 18) - 1;
+
+static uint32_t field_id(const std::string& name) {
+    // FNV-1a
+    uint32_t h = 2166136261U;
+    for (char c : name) {
+        h ^= (uint8_t)c;
+        h *= 16777619U;
+    }
+    return (h ^ (h >> 18)) & FIELD_ID_MASK;
 }
 
-Object::~Object() {
-    for (auto& entry : _objects) {
-        delete entry.second;
+static bool member_less(const ModelMeta::Member& member, const std::string& name) {
+    return member.name < name;
+}
+
+const ModelMeta::Member* ModelMeta::find(const std::vector<Member>& members,
+        const std::string& name) {
+    auto iter = std::lower_bound(members.begin(), members.end(), name, member_less);
+    if (iter == members.end() || iter->name != name) {
+        return nullptr;
     }
+    return &(*iter);
 }
 
+MemberMap<Model*> ModelMeta::defaults() const {
+    return MemberMap<Model*>(_plains, _prototype);
+}
+
+void ModelMeta::begin_record(ModelMeta* meta, const void* prototype) {
+    pthread_mutex_lock(&s_record_lock);
+    _s_building = meta;
+    _s_recording.store(prototype, std::memory_order_relaxed);
+}
+
+void ModelMeta::end_record(Object* prototype) {
+    ModelMeta* meta = _s_building;
+    _s_recording.store(nullptr, std::memory_order_relaxed);
+    _s_building = nullptr;
+    pthread_mutex_unlock(&s_record_lock);
+
+    meta->_prototype = prototype;
+    for (std::vector<Member>* members : {&meta->_plains, &meta->_lists, &meta->_objects}) {
+        std::sort(members->begin(), members->end(), [](const Member& l, const Member& r) {
+            return l.name < r.name;
+        });
+    }
+    // ids only depend on names, the rare collided one takes the next free id
+    std::set<uint32_t> ids;
+    for (std::vector<Member>* members : {&meta->_plains, &meta->_lists, &meta->_objects}) {
+        for (Member& member : *members) {
+            member.id = field_id(member.name);
+            while (!ids.insert(member.id).second) {
+                RELLAF_DEBUG("field id of %s collided", member.name.c_str());
+                member.id = (member.id + 1) & FIELD_ID_MASK;
+            }
+        }
+    }
+}
+
+void ModelMeta::record(std::vector<Member> ModelMeta::* members, const Object* inst,
+        const char* name, const void* member, Model* (*creator)()) {
+    ptrdiff_t offset = (const char*)member - (const char*)inst;
+    (_s_building->*members).emplace_back(Member{name, offset, creator, 0});
+}
+
+Object::~Object() = default;
+
 std::string Object::debug_str() const {
     std::string buf = "{";
     for (auto& key : get_plains()) {
@@ -166,36 +255,175 @@ std::string Object::debug_str() const {
     return buf;
 }
 
-Model* Object::get_plain(const std::string& key) {
-    if (!is_plain_member(key)) {
-        return nullptr;
+bool Object::set_plain(const std::string& key, const std::string& val_str) {
+    const ModelMeta::Member* member = rellaf_meta().plain(key);
+    if (member == nullptr) {
+        return false;
     }
-    return _plains.find(key)->second;
+    lazy_drop(key);
+    mark_dirty((size_t)(member - rellaf_meta().plains().data()));
+    ModelMeta::plain_of(this, *member)->set_parse(val_str);
+    return true;
+}
+
+Model* Object::create_list_item(const std::string& name) const {
+    const ModelMeta::Member* member = rellaf_meta().list(name);
+    return member == nullptr ? nullptr : member->creator();
+}
+
+Object* Object::create_object(const std::string& name) const {
+    const ModelMeta::Member* member = rellaf_meta().object(name);
+    return member == nullptr ? nullptr : (Object*)member->creator();
+}
+
+Model* Object::get_plain(const std::string& key) {
+    return (Model*)((const Object*)this)->get_plain(key);
 }
 
 const Model* Object::get_plain(const std::string& key) const {
-    if (!is_plain_member(key)) {
+    const ModelMeta::Member* member = rellaf_meta().plain(key);
+    if (member == nullptr) {
         return nullptr;
     }
-    return _plains.find(key)->second;
+    lazy_load(key);
+    return ModelMeta::plain_of(this, *member);
 }
 
 Object* Object::get_object(const std::string& name) {
-    auto entry = _objects.find(name);
-    return entry == _objects.end() ? nullptr : entry->second;
+    const ModelMeta::Member* member = rellaf_meta().object(name);
+    if (member == nullptr) {
+        return nullptr;
+    }
+    lazy_load(name);
+    return mutable_object(*ModelMeta::object_of(this, *member));
 }
 
 const Object* Object::get_object(const std::string& name) const {
-    auto entry = _objects.find(name);
-    return entry == _objects.end() ? nullptr : entry->second;
+    const ModelMeta::Member* member = rellaf_meta().object(name);
+    if (member == nullptr) {
+        return nullptr;
+    }
+    lazy_load(name);
+    return ModelMeta::object_of(this, *member)->get();
+}
+
+bool Object::reset_object(const std::string& name, Object* val) {
+    lazy_drop(name);
+    const ModelMeta::Member* member = rellaf_meta().object(name);
+    if (member == nullptr) {
+        return false;
+    }
+    std::shared_ptr<Object>* object = ModelMeta::object_of(this, *member);
+    if (object->get() != val) {
+        object->reset(val);
+    }
+    return true;
 }
 
 List& Object::get_list(const std::string& name) {
-    return _lists.at(name);
+    return (List&)((const Object*)this)->get_list(name);
 }
 
 const List& Object::get_list(const std::string& name) const {
-    return _lists.at(name);
+    const ModelMeta::Member* member = rellaf_meta().list(name);
+    if (member == nullptr) {
+        throw std::out_of_range("no list member " + name);
+    }
+    lazy_load(name);
+    return *ModelMeta::list_of(this, *member);
+}
+
+void Object::assign_members(const Object* val) {
+    const ModelMeta& meta = rellaf_meta();
+    if (val == this || &val->rellaf_meta() != &meta) {
+        return;
+    }
+    val->lazy_load_all();
+    _lazy.reset();
+    _tag = val->rellaf_tag();
+    _dirty = val->_dirty;
+    _dirty_more = val->_dirty_more;
+    for (auto& member : meta.plains()) {
+        ModelMeta::plain_of(this, member)->assign(ModelMeta::plain_of(val, member));
+    }
+    for (auto& member : meta.objects()) {
+        *ModelMeta::object_of(this, member) = *ModelMeta::object_of(val, member);
+    }
+    for (auto& member : meta.lists()) {
+        ModelMeta::list_of(this, member)->assign(ModelMeta::list_of(val, member));
+    }
+}
+
+void Object::clear_members() {
+    _lazy.reset();
+    clear_dirty();
+    const ModelMeta& meta = rellaf_meta();
+    for (auto& member : meta.plains()) {
+        ModelMeta::plain_of(this, member)->clear();
+    }
+    for (auto& member : meta.objects()) {
+        ModelMeta::object_of(this, member)->reset();
+    }
+    for (auto& member : meta.lists()) {
+        ModelMeta::list_of(this, member)->clear();
+    }
+}
+
+bool Object::is_dirty(const std::string& key) const {
+    int idx = rellaf_meta().plain_index(key);
+    return idx >= 0 && is_dirty((size_t)idx);
+}
+
+bool Object::has_dirty() const {
+    if (_dirty != 0) {
+        return true;
+    }
+    for (uint64_t bits : _dirty_more) {
+        if (bits != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Object::clear_dirty() {
+    _dirty = 0;
+    _dirty_more.clear();
+}
+
+void Object::mark_dirty_more(size_t idx) {
+    if (idx / 64 >= _dirty_more.size()) {
+        _dirty_more.resize(idx / 64 + 1, 0);
+    }
+    _dirty_more[idx / 64] |= 1ULL << (idx % 64);
+}
+
+void Object::set_lazy_source(LazySource* source) {
+    lazy_load_all();
+    _lazy.reset(source);
+    if (_lazy && _lazy->empty()) {
+        _lazy.reset();
+    }
+}
+
+void Object::lazy_load_member(const std::string& name) const {
+    std::unique_ptr<LazySource> source(std::move(_lazy));
+    source->load((Object*)this, name);
+    if (!source->empty()) {
+        _lazy = std::move(source);
+    }
+}
+
+void Object::lazy_load_members() const {
+    std::unique_ptr<LazySource> source(std::move(_lazy));
+    source->load_all((Object*)this);
+}
+
+void Object::lazy_drop_member(const std::string& name) const {
+    _lazy->drop(name);
+    if (_lazy->empty()) {
+        _lazy.reset();
+    }
 }
 
 bool is_plain(const Model* model) {
@@ -0,0 +1,511 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <string.h>
+#include <memory>
+#include "model_binary.h"
+#include "varint.h"
+
+namespace rellaf {
+
+enum WireType {
+    WIRE_VARINT = 0,
+    WIRE_FIXED64 = 1,
+    WIRE_LEN = 2,
+    WIRE_FIXED32 = 5
+};
+
+// nested objects and lists deeper than it are rejected
+static const int MAX_DEPTH = 64;
+
+static int plain_wire(const Model* model) {
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::FLOAT_code:
+            return WIRE_FIXED32;
+        case ModelTypeEnum::DOUBLE_code:
+            return WIRE_FIXED64;
+        case ModelTypeEnum::STR_code:
+            return WIRE_LEN;
+        default:
+            return WIRE_VARINT;
+    }
+}
+
+static void append_fixed(std::string& buf, uint64_t val, size_t bytes) {
+    char tmp[8];
+    for (size_t i = 0; i < bytes; ++i) {
+        tmp[i] = (char)(val >> (i * 8));
+    }
+    buf.append(tmp, bytes);
+}
+
+static bool read_fixed(const char* buf, size_t len, size_t& pos, uint64_t& val, size_t bytes) {
+    if (len - pos < bytes) {
+        return false;
+    }
+    val = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        val |= (uint64_t)(uint8_t)buf[pos + i] << (i * 8);
+    }
+    pos += bytes;
+    return true;
+}
+
+static bool read_len(const char* buf, size_t len, size_t& pos, size_t& val_len) {
+    uint64_t val = 0;
+    if (!read_varint(buf, len, pos, val) || val > len - pos) {
+        return false;
+    }
+    val_len = (size_t)val;
+    return true;
+}
+
+/**
+ * reserve 1 byte for the length of value written by `writer`, length is added by `extra`,
+ * extended in place if length not fit in 1 byte
+ */
+template<class Writer>
+static bool append_len_prefixed(std::string& buf, uint64_t extra, Writer writer) {
+    size_t pos = buf.size();
+    buf += '\0';
+    if (!writer()) {
+        return false;
+    }
+    uint64_t len = buf.size() - pos - 1 + extra;
+    if (len < 0x80) {
+        buf[pos] = (char)len;
+    } else {
+        std::string head;
+        append_varint(head, len);
+        buf.replace(pos, 1, head);
+    }
+    return true;
+}
+
+static void encode_plain(const Model* model, std::string& buf) {
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::CHAR_code:
+            append_varint(buf, zigzag_encode(((Plain<char>*)model)->value()));
+            break;
+        case ModelTypeEnum::INT16_code:
+            append_varint(buf, zigzag_encode(((Plain<int16_t>*)model)->value()));
+            break;
+        case ModelTypeEnum::INT_code:
+            append_varint(buf, zigzag_encode(((Plain<int>*)model)->value()));
+            break;
+        case ModelTypeEnum::INT64_code:
+            append_varint(buf, zigzag_encode(((Plain<int64_t>*)model)->value()));
+            break;
+        case ModelTypeEnum::UINT16_code:
+            append_varint(buf, ((Plain<uint16_t>*)model)->value());
+            break;
+        case ModelTypeEnum::UINT32_code:
+            append_varint(buf, ((Plain<uint32_t>*)model)->value());
+            break;
+        case ModelTypeEnum::UINT64_code:
+            append_varint(buf, ((Plain<uint64_t>*)model)->value());
+            break;
+        case ModelTypeEnum::BOOL_code:
+            append_varint(buf, ((Plain<bool>*)model)->value() ? 1 : 0);
+            break;
+        case ModelTypeEnum::FLOAT_code: {
+            float val = ((Plain<float>*)model)->value();
+            uint32_t bits = 0;
+            memcpy(&bits, &val, sizeof(bits));
+            append_fixed(buf, bits, 4);
+            break;
+        }
+        case ModelTypeEnum::DOUBLE_code: {
+            double val = ((Plain<double>*)model)->value();
+            uint64_t bits = 0;
+            memcpy(&bits, &val, sizeof(bits));
+            append_fixed(buf, bits, 8);
+            break;
+        }
+        case ModelTypeEnum::STR_code: {
+            const std::string& val = ((Plain<std::string>*)model)->value();
+            append_varint(buf, val.size());
+            buf += val;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static bool decode_plain(const char* buf, size_t len, size_t& pos, Model* model) {
+    uint64_t val = 0;
+    int wire = plain_wire(model);
+    if (wire == WIRE_VARINT) {
+        if (!read_varint(buf, len, pos, val)) {
+            return false;
+        }
+    } else if (wire == WIRE_FIXED32) {
+        if (!read_fixed(buf, len, pos, val, 4)) {
+            return false;
+        }
+    } else if (wire == WIRE_FIXED64) {
+        if (!read_fixed(buf, len, pos, val, 8)) {
+            return false;
+        }
+    }
+
+    switch (model->rellaf_type().code) {
+        case ModelTypeEnum::CHAR_code:
+            ((Plain<char>*)model)->set((char)zigzag_decode(val));
+            return true;
+        case ModelTypeEnum::INT16_code:
+            ((Plain<int16_t>*)model)->set((int16_t)zigzag_decode(val));
+            return true;
+        case ModelTypeEnum::INT_code:
+            ((Plain<int>*)model)->set((int)zigzag_decode(val));
+            return true;
+        case ModelTypeEnum::INT64_code:
+            ((Plain<int64_t>*)model)->set(zigzag_decode(val));
+            return true;
+        case ModelTypeEnum::UINT16_code:
+            ((Plain<uint16_t>*)model)->set((uint16_t)val);
+            return true;
+        case ModelTypeEnum::UINT32_code:
+            ((Plain<uint32_t>*)model)->set((uint32_t)val);
+            return true;
+        case ModelTypeEnum::UINT64_code:
+            ((Plain<uint64_t>*)model)->set(val);
+            return true;
+        case ModelTypeEnum::BOOL_code:
+            ((Plain<bool>*)model)->set(val != 0);
+            return true;
+        case ModelTypeEnum::FLOAT_code: {
+            uint32_t bits = (uint32_t)val;
+            float fval = 0;
+            memcpy(&fval, &bits, sizeof(bits));
+            ((Plain<float>*)model)->set(fval);
+            return true;
+        }
+        case ModelTypeEnum::DOUBLE_code: {
+            double dval = 0;
+            memcpy(&dval, &val, sizeof(val));
+            ((Plain<double>*)model)->set(dval);
+            return true;
+        }
+        case ModelTypeEnum::STR_code: {
+            size_t str_len = 0;
+            if (!read_len(buf, len, pos, str_len)) {
+                return false;
+            }
+            ((Plain<std::string>*)model)->set(std::string(buf + pos, str_len));
+            pos += str_len;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool encode(const Model* model, std::string& buf, int depth);
+
+static bool encode_list(const List* list, std::string& buf, int depth) {
+    append_varint(buf, list->size());
+    for (const Model* item : *list) {
+        if (item == nullptr) {
+            append_varint(buf, 0);
+            continue;
+        }
+        if (!append_len_prefixed(buf, 1, [&]() { return encode(item, buf, depth + 1); })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline uint64_t field_key(const ModelMeta::Member& member, int wire) {
+    return ((uint64_t)member.id << 3) | (uint64_t)wire;
+}
+
+static bool encode_object(const Object* obj, std::string& buf, int depth) {
+    const ModelMeta& meta = obj->rellaf_meta();
+    // members of map and meta are both in name order
+    const ModelMeta::Member* member = meta.plains().data();
+    for (auto& entry : obj->get_plains()) {
+        append_varint(buf, field_key(*member++, plain_wire(entry.second)));
+        encode_plain(entry.second, buf);
+    }
+    member = meta.lists().data();
+    for (auto& entry : obj->get_lists()) {
+        append_varint(buf, field_key(*member++, WIRE_LEN));
+        const List* list = &entry.second;
+        if (!append_len_prefixed(buf, 0, [&]() { return encode_list(list, buf, depth + 1); })) {
+            return false;
+        }
+    }
+    member = meta.objects().data();
+    for (auto& entry : obj->get_objects()) {
+        if (entry.second == nullptr) {
+            append_varint(buf, field_key(*member++, WIRE_VARINT));
+            append_varint(buf, 0);
+            continue;
+        }
+        append_varint(buf, field_key(*member++, WIRE_LEN));
+        const Object* sub = entry.second;
+        if (!append_len_prefixed(buf, 0, [&]() { return encode(sub, buf, depth + 1); })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool encode(const Model* model, std::string& buf, int depth) {
+    if (depth > MAX_DEPTH) {
+        RELLAF_DEBUG("model too deep to encode");
+        return false;
+    }
+    if (is_plain(model)) {
+        encode_plain(model, buf);
+        return true;
+    }
+    if (is_list(model)) {
+        return encode_list((const List*)model, buf, depth);
+    }
+    if (is_object(model)) {
+        return encode_object((const Object*)model, buf, depth);
+    }
+    return true;
+}
+
+static bool decode(const char* buf, size_t len, Model* model, int depth);
+
+/**
+ * @param proto     items are created by it, nullptr if list must be empty
+ */
+static bool decode_list(const char* buf, size_t len, size_t& pos, List* list, const Model* proto,
+        int depth) {
+    list->clear();
+    uint64_t count = 0;
+    // each item takes at least 1 byte
+    if (!read_varint(buf, len, pos, count) || count > len - pos) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t item_len = 0;
+        if (!read_varint(buf, len, pos, item_len)) {
+            return false;
+        }
+        if (item_len == 0) {
+            list->emplace_back(nullptr);
+            continue;
+        }
+        --item_len;
+        if (item_len > len - pos || proto == nullptr) {
+            return false;
+        }
+        Model* item = proto->create();
+        if (item == nullptr) {
+            return false;
+        }
+        list->emplace_back(item);
+        if (!decode(buf + pos, (size_t)item_len, item, depth + 1)) {
+            return false;
+        }
+        pos += item_len;
+    }
+    return true;
+}
+
+static bool skip_field(const char* buf, size_t len, size_t& pos, int wire) {
+    uint64_t val = 0;
+    size_t val_len = 0;
+    switch (wire) {
+        case WIRE_VARINT:
+            return read_varint(buf, len, pos, val);
+        case WIRE_FIXED64:
+            return read_fixed(buf, len, pos, val, 8);
+        case WIRE_FIXED32:
+            return read_fixed(buf, len, pos, val, 4);
+        case WIRE_LEN:
+            if (!read_len(buf, len, pos, val_len)) {
+                return false;
+            }
+            pos += val_len;
+            return true;
+        default:
+            return false;
+    }
+}
+
+enum MemberKind {
+    PLAIN_MEMBER = 0,
+    LIST_MEMBER = 1,
+    OBJECT_MEMBER = 2,
+    NO_MEMBER = 3
+};
+
+/**
+ * @brief find member of field `id`, fields are written in member order, so the ones at
+ *        `next` of each kind are tried before scanning, `next` moves after the found one
+ * @return kind of member found
+ */
+static MemberKind find_member(const ModelMeta& meta, size_t next[NO_MEMBER], uint64_t id,
+        const ModelMeta::Member*& member) {
+    const std::vector<ModelMeta::Member>* kinds[NO_MEMBER] = {
+            &meta.plains(), &meta.lists(), &meta.objects()};
+    for (int kind = PLAIN_MEMBER; kind < NO_MEMBER; ++kind) {
+        const std::vector<ModelMeta::Member>& members = *kinds[kind];
+        if (next[kind] < members.size() && members[next[kind]].id == id) {
+            member = &members[next[kind]++];
+            return (MemberKind)kind;
+        }
+    }
+    for (int kind = PLAIN_MEMBER; kind < NO_MEMBER; ++kind) {
+        const std::vector<ModelMeta::Member>& members = *kinds[kind];
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (members[i].id == id) {
+                next[kind] = i + 1;
+                member = &members[i];
+                return (MemberKind)kind;
+            }
+        }
+    }
+    return NO_MEMBER;
+}
+
+static bool decode_object(const char* buf, size_t len, Object* obj, int depth) {
+    // pending lazy members are loaded first, not to overwrite decoded ones later
+    obj->get_plains();
+    const ModelMeta& meta = obj->rellaf_meta();
+    size_t next[NO_MEMBER] = {0, 0, 0};
+
+    size_t pos = 0;
+    while (pos < len) {
+        uint64_t key = 0;
+        if (!read_varint(buf, len, pos, key)) {
+            return false;
+        }
+        int wire = (int)(key & 0x7);
+        uint64_t id = key >> 3;
+
+        const ModelMeta::Member* member = nullptr;
+        MemberKind kind = find_member(meta, next, id, member);
+
+        if (kind == PLAIN_MEMBER) {
+            Model* plain = ModelMeta::plain_of(obj, *member);
+            if (wire != plain_wire(plain) || !decode_plain(buf, len, pos, plain)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (kind == LIST_MEMBER) {
+            size_t list_len = 0;
+            if (wire != WIRE_LEN || !read_len(buf, len, pos, list_len)) {
+                return false;
+            }
+            std::unique_ptr<Model> proto(obj->create_list_item(member->name));
+            size_t list_pos = 0;
+            if (!decode_list(buf + pos, list_len, list_pos, ModelMeta::list_of(obj, *member),
+                    proto.get(), depth + 1) || list_pos != list_len) {
+                return false;
+            }
+            pos += list_len;
+            continue;
+        }
+
+        if (kind == OBJECT_MEMBER) {
+            const std::string& name = member->name;
+            if (wire == WIRE_VARINT) {
+                uint64_t val = 0;
+                if (!read_varint(buf, len, pos, val) || val != 0) {
+                    return false;
+                }
+                obj->reset_object(name, nullptr);
+                continue;
+            }
+            size_t sub_len = 0;
+            if (wire != WIRE_LEN || !read_len(buf, len, pos, sub_len)) {
+                return false;
+            }
+            Object* sub = obj->get_object(name);
+            if (sub == nullptr) {
+                sub = obj->create_object(name);
+                if (sub == nullptr) {
+                    // abstract type, could not be decoded
+                    pos += sub_len;
+                    continue;
+                }
+                obj->reset_object(name, sub);
+            }
+            if (!decode(buf + pos, sub_len, sub, depth + 1)) {
+                return false;
+            }
+            pos += sub_len;
+            continue;
+        }
+
+        // unknown field
+        if (!skip_field(buf, len, pos, wire)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool decode(const char* buf, size_t len, Model* model, int depth) {
+    if (depth > MAX_DEPTH) {
+        RELLAF_DEBUG("binary too deep to decode");
+        return false;
+    }
+    if (is_plain(model)) {
+        size_t pos = 0;
+        return decode_plain(buf, len, pos, model) && pos == len;
+    }
+    if (is_list(model)) {
+        List* list = (List*)model;
+        // item type of standalone list is unknown, take the existing one
+        std::unique_ptr<Model> proto;
+        for (const Model* item : *(const List*)list) {
+            if (item != nullptr) {
+                proto.reset(item->create());
+                break;
+            }
+        }
+        size_t pos = 0;
+        return decode_list(buf, len, pos, list, proto.get(), depth) && pos == len;
+    }
+    if (is_object(model)) {
+        return decode_object(buf, len, (Object*)model, depth);
+    }
+    return true;
+}
+
+bool model_to_binary(const Model* model, std::string& buf) {
+    if (model == nullptr) {
+        return false;
+    }
+    return encode(model, buf, 0);
+}
+
+bool binary_to_model(const std::string& buf, Model* model) {
+    return binary_to_model(buf.data(), buf.size(), model);
+}
+
+bool binary_to_model(const char* buf, size_t len, Model* model) {
+    if (model == nullptr || (buf == nullptr && len != 0)) {
+        return false;
+    }
+    return decode(buf, len, model, 0);
+}
+
+}
@@ -0,0 +1,486 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "model_snapshot.h"
+
+namespace rellaf {
+
+static const char SNAPSHOT_MAGIC[8] = {'R', 'L', 'F', 'S', 'N', 'A', 'P', '1'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const size_t HEADER_LEN = 32;
+
+static size_t width_of(int code) {
+    switch (code) {
+        case ModelTypeEnum::CHAR_code:
+        case ModelTypeEnum::BOOL_code:
+            return 1;
+        case ModelTypeEnum::INT16_code:
+        case ModelTypeEnum::UINT16_code:
+            return 2;
+        case ModelTypeEnum::INT_code:
+        case ModelTypeEnum::UINT32_code:
+        case ModelTypeEnum::FLOAT_code:
+            return 4;
+        case ModelTypeEnum::INT64_code:
+        case ModelTypeEnum::UINT64_code:
+        case ModelTypeEnum::DOUBLE_code:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+static bool write_all(FILE* fp, const void* data, size_t len) {
+    return len == 0 || fwrite(data, 1, len, fp) == len;
+}
+
+static bool pad(FILE* fp, uint64_t& pos) {
+    static const char zeros[8] = {0};
+    size_t len = (size_t)((8 - pos % 8) % 8);
+    pos += len;
+    return write_all(fp, zeros, len);
+}
+
+static bool copy_spool(FILE* from, FILE* to, uint64_t& pos) {
+    if (fflush(from) != 0 || fseek(from, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    char buf[64 * 1024];
+    size_t len = 0;
+    while ((len = fread(buf, 1, sizeof(buf), from)) > 0) {
+        if (!write_all(to, buf, len)) {
+            return false;
+        }
+        pos += len;
+    }
+    return ferror(from) == 0;
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    reset();
+}
+
+void SnapshotWriter::reset() {
+    for (Column& column : _columns) {
+        if (column.data != nullptr) {
+            fclose(column.data);
+        }
+        if (column.bytes != nullptr) {
+            fclose(column.bytes);
+        }
+    }
+    _columns.clear();
+    _type = nullptr;
+    _row_count = 0;
+    _failed = false;
+}
+
+FILE* SnapshotWriter::spool(size_t idx, const char* kind) {
+    std::string tmp = _path + ".spool." + std::to_string(idx) + kind;
+    FILE* fp = fopen(tmp.c_str(), "w+b");
+    if (fp != nullptr) {
+        // removed at once, kept until closed
+        unlink(tmp.c_str());
+    }
+    return fp;
+}
+
+bool SnapshotWriter::open(const std::string& path, const Object* prototype) {
+    reset();
+    if (prototype == nullptr) {
+        return false;
+    }
+    _path = path;
+    _type = &typeid(*prototype);
+    for (auto& entry : prototype->get_plains()) {
+        Column column;
+        column.name = entry.first;
+        column.code = entry.second->rellaf_type().code;
+        column.width = width_of(column.code);
+        if (column.width == 0 && column.code != ModelTypeEnum::STR_code) {
+            RELLAF_DEBUG("snapshot unsupported type of %s", entry.first.c_str());
+            reset();
+            return false;
+        }
+        _columns.push_back(column);
+        Column& added = _columns.back();
+        added.data = spool(_columns.size() - 1, ".data");
+        if (added.code == ModelTypeEnum::STR_code) {
+            added.bytes = spool(_columns.size() - 1, ".bytes");
+        }
+        if (added.data == nullptr ||
+                (added.code == ModelTypeEnum::STR_code && added.bytes == nullptr)) {
+            RELLAF_DEBUG("snapshot create spool of %s failed", path.c_str());
+            reset();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotWriter::append(const Object* obj) {
+    if (_type == nullptr || _failed || obj == nullptr || typeid(*obj) != *_type) {
+        return false;
+    }
+    size_t idx = 0;
+    for (auto& entry : obj->get_plains()) {
+        Column& column = _columns[idx++];
+        const Model* plain = entry.second;
+        bool ok = true;
+        switch (column.code) {
+            case ModelTypeEnum::CHAR_code: {
+                char val = ((const Plain<char>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::INT16_code: {
+                int16_t val = ((const Plain<int16_t>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::INT_code: {
+                int val = ((const Plain<int>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::INT64_code: {
+                int64_t val = ((const Plain<int64_t>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::UINT16_code: {
+                uint16_t val = ((const Plain<uint16_t>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::UINT32_code: {
+                uint32_t val = ((const Plain<uint32_t>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::UINT64_code: {
+                uint64_t val = ((const Plain<uint64_t>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::BOOL_code: {
+                bool val = ((const Plain<bool>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::FLOAT_code: {
+                float val = ((const Plain<float>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::DOUBLE_code: {
+                double val = ((const Plain<double>*)plain)->value();
+                ok = write_all(column.data, &val, sizeof(val));
+                break;
+            }
+            case ModelTypeEnum::STR_code: {
+                const std::string& val = ((const Plain<std::string>*)plain)->value();
+                column.bytes_len += val.size();
+                ok = write_all(column.bytes, val.data(), val.size()) &&
+                     write_all(column.data, &column.bytes_len, sizeof(column.bytes_len));
+                break;
+            }
+            default:
+                break;
+        }
+        if (!ok) {
+            _failed = true;
+            return false;
+        }
+    }
+    ++_row_count;
+    return true;
+}
+
+bool SnapshotWriter::append(const List& list) {
+    for (const Model* item : list) {
+        if (item != nullptr && (!is_object(item) || !append((const Object*)item))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotWriter::finish() {
+    if (_type == nullptr || _failed) {
+        reset();
+        return false;
+    }
+    std::string tmp = _path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "wb");
+    if (fp == nullptr) {
+        RELLAF_DEBUG("snapshot open %s failed", tmp.c_str());
+        reset();
+        return false;
+    }
+
+    // header written at last
+    char header[HEADER_LEN] = {0};
+    uint64_t pos = 0;
+    bool ok = write_all(fp, header, HEADER_LEN);
+    pos += HEADER_LEN;
+
+    std::string dir;
+    for (size_t i = 0; ok && i < _columns.size(); ++i) {
+        Column& column = _columns[i];
+        uint64_t data_off = pos;
+        uint64_t bytes_off = 0;
+        if (column.code == ModelTypeEnum::STR_code) {
+            uint64_t first = 0;
+            ok = write_all(fp, &first, sizeof(first));
+            pos += sizeof(first);
+        }
+        ok = ok && copy_spool(column.data, fp, pos);
+        uint64_t data_len = pos - data_off;
+        ok = ok && pad(fp, pos);
+        if (ok && column.code == ModelTypeEnum::STR_code) {
+            bytes_off = pos;
+            ok = copy_spool(column.bytes, fp, pos) && pad(fp, pos);
+        }
+
+        uint16_t name_len = (uint16_t)column.name.size();
+        uint8_t code = (uint8_t)column.code;
+        dir.append((const char*)&name_len, sizeof(name_len));
+        dir.append(column.name);
+        dir.append((const char*)&code, sizeof(code));
+        dir.append((const char*)&data_off, sizeof(data_off));
+        dir.append((const char*)&data_len, sizeof(data_len));
+        dir.append((const char*)&bytes_off, sizeof(bytes_off));
+        dir.append((const char*)&column.bytes_len, sizeof(column.bytes_len));
+    }
+
+    uint64_t dir_off = pos;
+    ok = ok && write_all(fp, dir.data(), dir.size());
+
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t column_count = (uint32_t)_columns.size();
+    memcpy(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 12, &column_count, sizeof(column_count));
+    memcpy(header + 16, &_row_count, sizeof(_row_count));
+    memcpy(header + 24, &dir_off, sizeof(dir_off));
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && write_all(fp, header, HEADER_LEN);
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), _path.c_str()) == 0;
+    if (!ok) {
+        RELLAF_DEBUG("snapshot write %s failed", _path.c_str());
+        unlink(tmp.c_str());
+    }
+    reset();
+    return ok;
+}
+
+SnapshotView::~SnapshotView() {
+    close();
+}
+
+bool SnapshotView::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        RELLAF_DEBUG("snapshot open %s failed", path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_LEN) {
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        RELLAF_DEBUG("snapshot mmap %s failed", path.c_str());
+        return false;
+    }
+    _base = (const char*)addr;
+    _size = (size_t)st.st_size;
+    if (!parse()) {
+        RELLAF_DEBUG("snapshot %s corrupted", path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotView::close() {
+    if (_base != nullptr) {
+        munmap((void*)_base, _size);
+    }
+    _base = nullptr;
+    _size = 0;
+    _row_count = 0;
+    _columns.clear();
+}
+
+bool SnapshotView::parse() {
+    uint32_t version = 0;
+    uint32_t column_count = 0;
+    uint64_t dir_off = 0;
+    if (memcmp(_base, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        return false;
+    }
+    memcpy(&version, _base + 8, sizeof(version));
+    memcpy(&column_count, _base + 12, sizeof(column_count));
+    memcpy(&_row_count, _base + 16, sizeof(_row_count));
+    memcpy(&dir_off, _base + 24, sizeof(dir_off));
+    if (version != SNAPSHOT_VERSION || dir_off < HEADER_LEN || dir_off > _size) {
+        return false;
+    }
+
+    // bound of every region checked here, accessors trust them
+    size_t pos = (size_t)dir_off;
+    for (uint32_t i = 0; i < column_count; ++i) {
+        Column column;
+        uint16_t name_len = 0;
+        if (_size - pos < sizeof(name_len)) {
+            return false;
+        }
+        memcpy(&name_len, _base + pos, sizeof(name_len));
+        pos += sizeof(name_len);
+        if (_size - pos < name_len + 1 + 4 * sizeof(uint64_t)) {
+            return false;
+        }
+        column.name.assign(_base + pos, name_len);
+        pos += name_len;
+        column.code = (uint8_t)_base[pos++];
+        memcpy(&column.data_off, _base + pos, sizeof(uint64_t));
+        memcpy(&column.data_len, _base + pos + 8, sizeof(uint64_t));
+        memcpy(&column.bytes_off, _base + pos + 16, sizeof(uint64_t));
+        memcpy(&column.bytes_len, _base + pos + 24, sizeof(uint64_t));
+        pos += 4 * sizeof(uint64_t);
+
+        if (column.data_off % 8 != 0 || column.data_off > dir_off ||
+                column.data_len > dir_off - column.data_off) {
+            return false;
+        }
+        if (column.code == ModelTypeEnum::STR_code) {
+            if (_row_count >= column.data_len / sizeof(uint64_t) ||
+                    column.data_len != (_row_count + 1) * sizeof(uint64_t) ||
+                    column.bytes_off > dir_off || column.bytes_len > dir_off - column.bytes_off) {
+                return false;
+            }
+            // offsets between are checked on access, not to touch all pages here
+            const uint64_t* offsets = (const uint64_t*)(_base + column.data_off);
+            if (offsets[0] != 0 || offsets[_row_count] != column.bytes_len) {
+                return false;
+            }
+        } else {
+            size_t width = width_of(column.code);
+            if (width == 0 || _row_count > column.data_len / width ||
+                    column.data_len != _row_count * width) {
+                return false;
+            }
+        }
+        _columns.push_back(column);
+    }
+    return true;
+}
+
+int SnapshotView::column(const std::string& name) const {
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        if (_columns[i].name == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+bool SnapshotView::str(size_t col, uint64_t row, const char*& data, size_t& len) const {
+    if (col >= _columns.size() || row >= _row_count ||
+            _columns[col].code != ModelTypeEnum::STR_code) {
+        return false;
+    }
+    const Column& column = _columns[col];
+    const uint64_t* offsets = (const uint64_t*)(_base + column.data_off);
+    if (offsets[row] > offsets[row + 1] || offsets[row + 1] > column.bytes_len) {
+        return false;
+    }
+    data = _base + column.bytes_off + offsets[row];
+    len = (size_t)(offsets[row + 1] - offsets[row]);
+    return true;
+}
+
+bool SnapshotView::to_model(uint64_t row, Object* obj) const {
+    if (obj == nullptr || row >= _row_count) {
+        return false;
+    }
+    for (size_t col = 0; col < _columns.size(); ++col) {
+        const Column& column = _columns[col];
+        Model* plain = obj->get_plain(column.name);
+        if (plain == nullptr || plain->rellaf_type().code != column.code) {
+            continue;
+        }
+        const char* value = _base + column.data_off + row * width_of(column.code);
+        switch (column.code) {
+            case ModelTypeEnum::CHAR_code:
+                ((Plain<char>*)plain)->set(*(const char*)value);
+                break;
+            case ModelTypeEnum::INT16_code:
+                ((Plain<int16_t>*)plain)->set(*(const int16_t*)value);
+                break;
+            case ModelTypeEnum::INT_code:
+                ((Plain<int>*)plain)->set(*(const int*)value);
+                break;
+            case ModelTypeEnum::INT64_code:
+                ((Plain<int64_t>*)plain)->set(*(const int64_t*)value);
+                break;
+            case ModelTypeEnum::UINT16_code:
+                ((Plain<uint16_t>*)plain)->set(*(const uint16_t*)value);
+                break;
+            case ModelTypeEnum::UINT32_code:
+                ((Plain<uint32_t>*)plain)->set(*(const uint32_t*)value);
+                break;
+            case ModelTypeEnum::UINT64_code:
+                ((Plain<uint64_t>*)plain)->set(*(const uint64_t*)value);
+                break;
+            case ModelTypeEnum::BOOL_code:
+                ((Plain<bool>*)plain)->set(*(const uint8_t*)value != 0);
+                break;
+            case ModelTypeEnum::FLOAT_code:
+                ((Plain<float>*)plain)->set(*(const float*)value);
+                break;
+            case ModelTypeEnum::DOUBLE_code:
+                ((Plain<double>*)plain)->set(*(const double*)value);
+                break;
+            case ModelTypeEnum::STR_code: {
+                const char* data = nullptr;
+                size_t len = 0;
+                if (!str(col, row, data, len)) {
+                    return false;
+                }
+                ((Plain<std::string>*)plain)->set(std::string(data, len));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+}
@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 #include "common.h"
 
 namespace rellaf {
@@ -29,6 +30,9 @@ class Latch {
 public:
     explicit Latch(const uint32_t count = 1) : _count(count) {}
 
+    /**
+     * @return 0, signaled; 1, timeout
+     */
     int wait(const uint32_t timeout_mills = 0) {
         pthread_mutex_lock(&_mutex);
 
@@ -37,14 +41,18 @@ public:
                 pthread_cond_wait(&_cond, &_mutex);
             }
         } else {
-            struct timespec tspec;
+            struct timespec tspec{};
             clock_gettime(CLOCK_REALTIME, &tspec);
             tspec.tv_sec += timeout_mills / 1000;
+            tspec.tv_nsec += (long)(timeout_mills % 1000) * 1000000;
+            if (tspec.tv_nsec >= 1000000000) {
+                tspec.tv_sec += 1;
+                tspec.tv_nsec -= 1000000000;
+            }
 
             while (!_signal) {
-                if (pthread_cond_timedwait(&_cond, &_mutex, &tspec) == ETIMEDOUT) {
+                if (pthread_cond_timedwait(&_cond, &_mutex, &tspec) == ETIMEDOUT && !_signal) {
                     pthread_mutex_unlock(&_mutex);
-                    _signal = false;
                     return 1;
                 }
             }
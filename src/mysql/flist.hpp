@@ -56,7 +56,7 @@ public:
         ListNode<T>* q = p;
         for (size_t i = _len; i > 0; --i) {
             p = p->_next;
-            free(q);
+            delete q;
             q = p;
         }
         _len = 0;
@@ -43,7 +43,13 @@ public:
     }
 
     inline size_t size() {
-        return _list.size();
+        if (!_blocking) {
+            return _list.size();
+        }
+        pthread_mutex_lock(&_mutex);
+        size_t size = _list.size();
+        pthread_mutex_unlock(&_mutex);
+        return size;
     }
 
     inline bool isempty() {
@@ -60,21 +66,18 @@ public:
     inline int add_block(T val, uint32_t timeout_mills = 0) {
         pthread_mutex_lock(&_mutex);
 
-        if (isfull()) {
-            if (timeout_mills == 0) {
-                while (!_full_signal) {
-                    pthread_cond_wait(&_full_cond, &_mutex);
-                }
-            } else {
-                struct timespec tspec{};
-                clock_gettime(CLOCK_REALTIME, &tspec);
-                tspec.tv_sec += timeout_mills / 1000;
-                while (!_full_signal) {
-                    if (pthread_cond_timedwait(&_full_cond, &_mutex, &tspec) == ETIMEDOUT) {
-                        _full_signal = false;
-                        pthread_mutex_unlock(&_mutex);
-                        return 1;
-                    }
+        if (timeout_mills == 0) {
+            while (isfull() && !_full_signal) {
+                pthread_cond_wait(&_full_cond, &_mutex);
+            }
+        } else {
+            struct timespec tspec = deadline(timeout_mills);
+            while (isfull() && !_full_signal) {
+                if (pthread_cond_timedwait(&_full_cond, &_mutex, &tspec) == ETIMEDOUT &&
+                        isfull()) {
+                    _full_signal = false;
+                    pthread_mutex_unlock(&_mutex);
+                    return 1;
                 }
             }
         }
@@ -110,22 +113,20 @@ public:
 
         pthread_mutex_lock(&_mutex);
 
-        if (isempty()) {
-            if (timeout_mills == 0) {
-                while (!_empty_signal) {
-                    pthread_cond_wait(&_empty_cond, &_mutex);
-                }
-            } else {
-                struct timespec tspec{};
-                clock_gettime(CLOCK_REALTIME, &tspec);
-                tspec.tv_sec += timeout_mills / 1000;
-                while (!_empty_signal) {
-                    if (pthread_cond_timedwait(&_empty_cond, &_mutex, &tspec) == ETIMEDOUT) {
-                        *n = nullptr;
-                        _empty_signal = false;
-                        pthread_mutex_unlock(&_mutex);
-                        return 1;
-                    }
+        // list checked too, a signal may be consumed by another popper
+        if (timeout_mills == 0) {
+            while (isempty() && !_empty_signal) {
+                pthread_cond_wait(&_empty_cond, &_mutex);
+            }
+        } else {
+            struct timespec tspec = deadline(timeout_mills);
+            while (isempty() && !_empty_signal) {
+                if (pthread_cond_timedwait(&_empty_cond, &_mutex, &tspec) == ETIMEDOUT &&
+                        isempty()) {
+                    *n = nullptr;
+                    _empty_signal = false;
+                    pthread_mutex_unlock(&_mutex);
+                    return 1;
                 }
             }
         }
@@ -137,11 +138,36 @@ public:
         _full_signal = true;
         pthread_cond_signal(&_full_cond);
         _empty_signal = false;
+        if (!isempty()) {
+            // more for other poppers
+            pthread_cond_signal(&_empty_cond);
+        }
 
         pthread_mutex_unlock(&_mutex);
         return 0;
     }
 
+    /**
+     * @return 0, succ; -1, failed; 1, empty
+     */
+    inline int try_pop_block(ListNode<T>** n) {
+        if (n == nullptr) {
+            return -1;
+        }
+
+        pthread_mutex_lock(&_mutex);
+        if (isempty()) {
+            *n = nullptr;
+            pthread_mutex_unlock(&_mutex);
+            return 1;
+        }
+        *n = _list.pop_head();
+        _full_signal = true;
+        pthread_cond_signal(&_full_cond);
+        pthread_mutex_unlock(&_mutex);
+        return 0;
+    }
+
     inline int pop(ListNode<T>** n, uint32_t timeout_mills = 0) {
         if (n == nullptr) {
             return -1;
@@ -169,6 +195,19 @@ public:
         }
     }
 
+private:
+    static struct timespec deadline(uint32_t timeout_mills) {
+        struct timespec tspec{};
+        clock_gettime(CLOCK_REALTIME, &tspec);
+        tspec.tv_sec += timeout_mills / 1000;
+        tspec.tv_nsec += (long)(timeout_mills % 1000) * 1000000;
+        if (tspec.tv_nsec >= 1000000000) {
+            tspec.tv_sec += 1;
+            tspec.tv_nsec -= 1000000000;
+        }
+        return tspec;
+    }
+
 private:
     LinkList<T> _list;
     bool _blocking;
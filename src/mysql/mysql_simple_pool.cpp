@@ -16,33 +16,42 @@
 //
 
 
+#include <string.h>
 #include <strings.h>
+#include <time.h>
+#include <unistd.h>
 #include <deque>
+#include <algorithm>
+#include "errmsg.h"
 #include "mysql_simple_pool.h"
 
 namespace rellaf {
 
-uint16_t MysqlSimplePool::_s_port;
-std::string MysqlSimplePool::_s_host;
-std::string MysqlSimplePool::_s_database;
-std::string MysqlSimplePool::_s_username;
-std::string MysqlSimplePool::_s_password;
-std::string MysqlSimplePool::_s_charset;
-uint32_t MysqlSimplePool::_s_thread_count;
-uint32_t MysqlSimplePool::_s_task_queue_size;
-std::deque<MyThread*> MysqlSimplePool::_s_pool;
+static uint64_t monotonic_us() {
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
 
-pthread_mutex_t MysqlSimplePool::_s_tx_lock = PTHREAD_MUTEX_INITIALIZER;
-std::map<uint64_t, SqlTx> MysqlSimplePool::_s_tx_pool;
+static bool is_conn_error(unsigned int err) {
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST || err == CR_CONN_HOST_ERROR;
+}
 
 MysqlSimplePool::MysqlSimplePool() : _action_idx(0) {
-    if (mysql_library_init(0, nullptr, nullptr) != 0) {
+    // once for all pools
+    static int lib_ret = mysql_library_init(0, nullptr, nullptr);
+    if (lib_ret != 0) {
         RELLAF_DEBUG("connect mysql lib failed");
         exit(-1);
     }
+    pthread_mutex_init(&_pool_lock, nullptr);
+    pthread_mutex_init(&_tx_lock, nullptr);
 }
 
 MysqlSimplePool::~MysqlSimplePool() {
+    stop();
+    pthread_mutex_destroy(&_tx_lock);
+    pthread_mutex_destroy(&_pool_lock);
     mysql_thread_end();
 }
 
@@ -52,76 +61,154 @@ MysqlSimplePool& MysqlSimplePool::instance() {
 }
 
 void MysqlSimplePool::stop() {
-    for (uint32_t i = 0; i < MysqlSimplePool::_s_thread_count; ++i) {
-        _s_pool[i]->status = 0;
-
-        if (_s_pool[i]->tid != 0) {
-            pthread_join(_s_pool[i]->tid, nullptr);
+    pthread_mutex_lock(&_pool_lock);
+    _stopping = true;
+    std::deque<MyThread*> threads;
+    threads.swap(_pool);
+    pthread_mutex_unlock(&_pool_lock);
+
+    for (MyThread* thread : threads) {
+        thread->status = 0;
+    }
+    // wake idle ones, busy ones see status after current task
+    for (size_t i = 0; i < threads.size() && _tasks != nullptr; ++i) {
+        _tasks->add_block(nullptr, 10);
+    }
+    for (MyThread* thread : threads) {
+        if (thread->tid != 0) {
+            pthread_join(thread->tid, nullptr);
         }
+        thread->tasks = nullptr;
+        thread->inst = nullptr;
+        delete thread;
+    }
+    delete _tasks;
+    _tasks = nullptr;
 
-        delete _s_pool[i]->tasks;
-
-        _s_pool[i]->tasks = nullptr;
-        _s_pool[i]->inst = nullptr;
-
-        delete _s_pool[i];
-        _s_pool[i] = nullptr;
+    if (_killer_tid != 0) {
+        _kill_tasks->add_block(nullptr);
+        pthread_join(_killer_tid, nullptr);
+        _killer_tid = 0;
+    }
+    if (_kill_tasks != nullptr) {
+        ListNode<MyContext*>* node = nullptr;
+        while (_kill_tasks->try_pop_block(&node) == 0) {
+            if (node->_data != nullptr) {
+                release(node->_data);
+            }
+            delete node;
+        }
+        delete _kill_tasks;
+        _kill_tasks = nullptr;
     }
 }
 
 bool MysqlSimplePool::connect(const std::string& host, uint16_t port, const std::string& username,
         const std::string& password, const std::string& database, const std::string& charset,
         uint32_t thread_count, uint32_t task_queue_size) {
+    MysqlPoolOptions options;
+    options.min_conns = thread_count;
+    options.max_conns = thread_count;
+    options.task_queue_size = task_queue_size;
+    return connect(host, port, username, password, database, charset, options);
+}
 
-    MysqlSimplePool::_s_host = host;
-    MysqlSimplePool::_s_port = port;
-    MysqlSimplePool::_s_database = database;
-    MysqlSimplePool::_s_username = username;
-    MysqlSimplePool::_s_password = password;
-    MysqlSimplePool::_s_charset = charset;
-    MysqlSimplePool::_s_thread_count = thread_count;
-    MysqlSimplePool::_s_task_queue_size = task_queue_size;
-
-    for (uint32_t i = 0; i < MysqlSimplePool::_s_thread_count; ++i) {
-        auto* thread = new(std::nothrow) MyThread;
-        if (thread == nullptr) {
-            stop();
-            return false;
-        }
+bool MysqlSimplePool::connect(const std::string& host, uint16_t port, const std::string& username,
+        const std::string& password, const std::string& database, const std::string& charset,
+        const MysqlPoolOptions& options) {
+    if (options.min_conns == 0 || options.max_conns < options.min_conns) {
+        RELLAF_DEBUG("invalid pool size, min : %u, max : %u", options.min_conns,
+                options.max_conns);
+        return false;
+    }
 
-        thread->status = 1;
-        thread->tid = 0;
-        thread->inst = this;
-        thread->tasks = new(std::nothrow) Queue<MyContext*>(MysqlSimplePool::_s_task_queue_size, true);
-        if (thread->tasks == nullptr) {
-            delete thread->tasks;
-            delete thread;
-            stop();
-            return false;
-        }
+    _host = host;
+    _port = port;
+    _database = database;
+    _username = username;
+    _password = password;
+    _charset = charset;
+    _options = options;
+
+    _tasks = new(std::nothrow) Queue<MyContext*>(options.task_queue_size, true);
+    if (_tasks == nullptr) {
+        return false;
+    }
+    _kill_tasks = new(std::nothrow) Queue<MyContext*>(0, true);
+    if (_kill_tasks == nullptr) {
+        stop();
+        return false;
+    }
+    if (pthread_create(&_killer_tid, nullptr, kill_routine, this) != 0) {
+        RELLAF_DEBUG("create killer thread failed");
+        _killer_tid = 0;
+        stop();
+        return false;
+    }
+    pthread_mutex_lock(&_pool_lock);
+    _stopping = false;
+    pthread_mutex_unlock(&_pool_lock);
 
-        if (pthread_create(&thread->tid, nullptr, MysqlSimplePool::thd_routine, thread) != 0) {
+    for (uint32_t i = 0; i < options.min_conns; ++i) {
+        MyThread* thread = new_thread(false);
+        if (thread == nullptr) {
             stop();
             return false;
         }
-
-//        while (thread->status != 2 && thread->status != 0) {
-//            RELLAF_DEBUG("pending for sql thread");
-//            sleep(1);
-//        }
-
-        _s_pool.push_back(thread);
+        pthread_mutex_lock(&_pool_lock);
+        _pool.push_back(thread);
+        pthread_mutex_unlock(&_pool_lock);
+        ++_conns;
     }
 
     return true;
 }
 
+MysqlPoolStats MysqlSimplePool::stats() const {
+    MysqlPoolStats stats;
+    stats.conns = _conns.load(std::memory_order_relaxed);
+    stats.active = _active.load(std::memory_order_relaxed);
+    stats.broken = _broken.load(std::memory_order_relaxed);
+    uint32_t busy = stats.active + stats.broken;
+    stats.idle = stats.conns > busy ? stats.conns - busy : 0;
+    stats.waiting = _tasks == nullptr ? 0 : _tasks->size();
+    stats.tasks = _task_count.load(std::memory_order_relaxed);
+    stats.wait_us = _wait_us.load(std::memory_order_relaxed);
+    stats.reconnects = _reconnects.load(std::memory_order_relaxed);
+    stats.ping_failures = _ping_failures.load(std::memory_order_relaxed);
+    stats.grown = _grown.load(std::memory_order_relaxed);
+    stats.shrunk = _shrunk.load(std::memory_order_relaxed);
+    stats.batches = _batches.load(std::memory_order_relaxed);
+    stats.batched = _batched.load(std::memory_order_relaxed);
+    stats.timeouts = _timeouts.load(std::memory_order_relaxed);
+    stats.kills = _kills.load(std::memory_order_relaxed);
+    return stats;
+}
+
 bool MysqlSimplePool::connect(MYSQL* mysql) {
-    MYSQL* tmp = mysql_real_connect(mysql, MysqlSimplePool::_s_host.c_str(),
-            MysqlSimplePool::_s_username.c_str(), MysqlSimplePool::_s_password.c_str(),
-            MysqlSimplePool::_s_database.c_str(), MysqlSimplePool::_s_port, nullptr, 0);
+    mysql_init(mysql);
+    const MysqlPoolOptions& options = _options;
+    if (options.connect_timeout_ms > 0) {
+        unsigned int timeout = (options.connect_timeout_ms + 999) / 1000;
+        mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    }
+    if (options.read_timeout_ms > 0) {
+        unsigned int timeout = (options.read_timeout_ms + 999) / 1000;
+        mysql_options(mysql, MYSQL_OPT_READ_TIMEOUT, &timeout);
+    }
+    if (options.write_timeout_ms > 0) {
+        unsigned int timeout = (options.write_timeout_ms + 999) / 1000;
+        mysql_options(mysql, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+    }
+
+    // statements of a pipelined batch are sent in one query
+    unsigned long flags = options.pipeline_max > 1 ? CLIENT_MULTI_STATEMENTS : 0;
+    MYSQL* tmp = mysql_real_connect(mysql, _host.c_str(),
+            _username.c_str(), _password.c_str(),
+            _database.c_str(), _port, nullptr, flags);
     if (tmp != mysql) {
         RELLAF_DEBUG("connect to mysql failed, error : %s", mysql_error(mysql));
+        mysql_close(mysql);
         return false;
     }
     return true;
@@ -131,122 +218,464 @@ void MysqlSimplePool::close(MYSQL* mysql) {
     mysql_close(mysql);
 }
 
-void MysqlSimplePool::retry(MYSQL* mysql) {
-    close(mysql);
-    connect(mysql);
+bool MysqlSimplePool::reconnect(MYSQL* mysql, MyThread* thread) {
+    const MysqlPoolOptions& options = _options;
+    uint32_t backoff_ms = options.reconnect_min_ms;
+    while (thread->status) {
+        // sliced to notice stop
+        for (uint32_t slept = 0; slept < backoff_ms && thread->status; slept += 50) {
+            usleep(std::min(backoff_ms - slept, 50U) * 1000);
+        }
+        if (!thread->status) {
+            break;
+        }
+        if (connect(mysql)) {
+            ++_reconnects;
+            return true;
+        }
+        backoff_ms = std::min(std::max(backoff_ms * 2, 1U), options.reconnect_max_ms);
+    }
+    return false;
+}
+
+void MysqlSimplePool::grow() {
+    if (_conns.load(std::memory_order_relaxed) >= _options.max_conns) {
+        return;
+    }
+    pthread_mutex_lock(&_pool_lock);
+    if (!_stopping && _conns.load(std::memory_order_relaxed) < _options.max_conns) {
+        MyThread* thread = new_thread(false);
+        if (thread != nullptr) {
+            _pool.push_back(thread);
+            ++_conns;
+            ++_grown;
+            RELLAF_DEBUG("mysql pool grown to %u", _conns.load());
+        }
+    }
+    pthread_mutex_unlock(&_pool_lock);
+}
+
+bool MysqlSimplePool::try_shrink(MyThread* thread) {
+    bool shrunk = false;
+    pthread_mutex_lock(&_pool_lock);
+    if (!_stopping && _conns.load(std::memory_order_relaxed) > _options.min_conns) {
+        for (auto iter = _pool.begin(); iter != _pool.end(); ++iter) {
+            if (*iter == thread) {
+                _pool.erase(iter);
+                --_conns;
+                ++_shrunk;
+                pthread_detach(thread->tid);
+                shrunk = true;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&_pool_lock);
+    return shrunk;
+}
+
+bool MysqlSimplePool::run_task(MYSQL* mysql, MyThread* thread, MyContext* context) {
+    if (!start_task(mysql, context)) {
+        return false;
+    }
+    return exec_task(mysql, thread, context);
+}
+
+bool MysqlSimplePool::exec_task(MYSQL* mysql, MyThread* thread, MyContext* context) {
+    const std::string& sql = context->sql;
+
+    InnerResult* result = new(std::nothrow) InnerResult;
+    if (result == nullptr) {
+        RELLAF_DEBUG("exec sql failed, alloc result error");
+        finish_task(context, nullptr);
+        return false;
+    }
+    result->status = 0;
+    result->row_count = 0;
+    result->data = nullptr;
+
+    bool lost = false;
+    if (strncasecmp(sql.c_str(), "BEGIN", sizeof("BEGIN") - 1) == 0) {
+        RELLAF_DEBUG("BEGIN");
+
+        if (mysql_autocommit(mysql, 0) != 0) {
+            RELLAF_DEBUG("begin transaction faild : %s", mysql_error(mysql));
+            result->status = -1;
+            result->message = mysql_error(mysql);
+        }
+
+    } else if (strncasecmp(sql.c_str(), "COMMIT", sizeof("COMMIT") - 1) == 0) {
+        RELLAF_DEBUG("COMMIT");
+
+        if (mysql_commit(mysql) != 0) {
+            RELLAF_DEBUG("commit transaction faild : %s", mysql_error(mysql));
+            result->status = -1;
+            result->message = mysql_error(mysql);
+        }
+
+    } else if (strncasecmp(sql.c_str(), "ROLLBACK", sizeof("ROLLBACK") - 1) == 0) {
+        RELLAF_DEBUG("ROLLBACK");
+
+        if (mysql_rollback(mysql) != 0) {
+            RELLAF_DEBUG("rollback transaction faild : %s", mysql_error(mysql));
+            result->status = -1;
+            result->message = mysql_error(mysql);
+        }
+
+    } else {
+        RELLAF_DEBUG("%s", sql.substr(0, 8).c_str());
+
+        if (mysql_real_query(mysql, sql.c_str(), sql.size()) == 0) {
+            if (strncasecmp(sql.c_str(), "INSERT", sizeof("INSERT") - 1) == 0) {
+                uint64_t keyid = mysql_insert_id(mysql);
+                result->data = (void*) keyid;
+            }
+            result->row_count = (int) mysql_affected_rows(mysql);
+            // any statement with a result set, SHOW as well, left unread breaks the next one
+            if (mysql_field_count(mysql) != 0) {
+                result->data = (void*) mysql_store_result(mysql);
+                result->rows = true;
+            }
+        } else {
+            result->status = -1;
+            result->message = mysql_error(mysql);
+            RELLAF_DEBUG("exec sql: %s failed, error : %s", sql.c_str(), mysql_error(mysql));
+            lost = is_conn_error(mysql_errno(mysql));
+        }
+    }
+
+    if (lost && requeue(thread, context)) {
+        delete result;
+        return lost;
+    }
+    finish_task(context, result);
+    return lost;
+}
+
+bool MysqlSimplePool::requeue(MyThread* thread, MyContext* context) {
+    // SELECT is safe to run again, by another connection, reconnecting is not waited
+    if (thread->dedicated || context->retried ||
+            strncasecmp(context->sql.c_str(), "SELECT", sizeof("SELECT") - 1) != 0) {
+        return false;
+    }
+    pthread_mutex_lock(&context->lock);
+    bool abandoned = context->state == MY_TASK_ABANDONED;
+    if (!abandoned) {
+        context->state = MY_TASK_QUEUED;
+        context->conn_id = 0;
+    }
+    pthread_mutex_unlock(&context->lock);
+    if (abandoned) {
+        return false;
+    }
+    context->retried = true;
+    return _tasks->add_block(context, 1) == 0;
+}
+
+bool MysqlSimplePool::start_task(MYSQL* mysql, MyContext* context, bool batched) {
+    pthread_mutex_lock(&context->lock);
+    if (context->state == MY_TASK_ABANDONED) {
+        pthread_mutex_unlock(&context->lock);
+        release(context);
+        return false;
+    }
+    // caller is giving up, not worth a round trip
+    if (context->deadline_us != 0 && monotonic_us() >= context->deadline_us) {
+        pthread_mutex_unlock(&context->lock);
+        RELLAF_DEBUG("deadline exceeded in queue : %s", context->sql.c_str());
+        ++_timeouts;
+        finish_task(context, new_error("deadline exceeded in queue"));
+        return false;
+    }
+    context->state = MY_TASK_RUNNING;
+    context->conn_id = mysql_thread_id(mysql);
+    context->batched = batched;
+    pthread_mutex_unlock(&context->lock);
+    return true;
+}
+
+void MysqlSimplePool::finish_task(MyContext* context, InnerResult* result) {
+    pthread_mutex_lock(&context->lock);
+    // not to be killed any more, the connection goes on with others' statements
+    context->conn_id = 0;
+    if (context->state == MY_TASK_ABANDONED) {
+        free_result(result);
+    } else {
+        context->state = MY_TASK_DONE;
+        context->result = result;
+        context->latch.count_down();
+    }
+    pthread_mutex_unlock(&context->lock);
+    release(context);
+}
+
+bool MysqlSimplePool::is_abandoned(MyContext* context) {
+    pthread_mutex_lock(&context->lock);
+    bool abandoned = context->state == MY_TASK_ABANDONED;
+    pthread_mutex_unlock(&context->lock);
+    return abandoned;
+}
+
+void MysqlSimplePool::release(MyContext* context) {
+    if (context->refs.fetch_sub(1) == 1) {
+        delete context;
+    }
+}
+
+InnerResult* MysqlSimplePool::new_error(const std::string& message) {
+    InnerResult* result = new(std::nothrow) InnerResult;
+    if (result != nullptr) {
+        result->status = -1;
+        result->row_count = 0;
+        result->data = nullptr;
+        result->message = message;
+    }
+    return result;
+}
+
+void MysqlSimplePool::free_result(InnerResult* result) {
+    if (result != nullptr && result->rows && result->data != nullptr) {
+        mysql_free_result(static_cast<MYSQL_RES*>(result->data));
+    }
+    delete result;
+}
+
+bool MysqlSimplePool::pipelinable(const std::string& sql) {
+    static const char* const prefixes[] = {"SELECT", "INSERT", "UPDATE", "DELETE", "REPLACE"};
+    // more than one statement breaks demultiplexing
+    if (sql.find(';') != std::string::npos) {
+        return false;
+    }
+    for (const char* prefix : prefixes) {
+        if (strncasecmp(sql.c_str(), prefix, strlen(prefix)) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MysqlSimplePool::run_batch(MYSQL* mysql, MyThread* thread,
+        const std::vector<MyContext*>& tasks) {
+    std::vector<MyContext*> batch;
+    for (MyContext* context : tasks) {
+        if (start_task(mysql, context, true)) {
+            batch.push_back(context);
+        }
+    }
+    if (batch.empty()) {
+        return false;
+    }
+    if (batch.size() == 1) {
+        return exec_task(mysql, thread, batch.front());
+    }
+
+    std::string sql;
+    for (MyContext* context : batch) {
+        if (!sql.empty()) {
+            sql += ";\n";
+        }
+        sql += context->sql;
+    }
+    ++_batches;
+    _batched += batch.size();
+    RELLAF_DEBUG("batch of %zu statements", batch.size());
+
+    // each result in order of statements, the first failed one ends the batch
+    size_t done = 0;
+    int ret = mysql_real_query(mysql, sql.c_str(), sql.size());
+    while (ret == 0 && done < batch.size()) {
+        MyContext* context = batch[done];
+        InnerResult* result = new(std::nothrow) InnerResult;
+        if (result != nullptr) {
+            result->status = 0;
+            result->data = nullptr;
+            if (strncasecmp(context->sql.c_str(), "INSERT", sizeof("INSERT") - 1) == 0) {
+                uint64_t keyid = mysql_insert_id(mysql);
+                result->data = (void*) keyid;
+            }
+            result->row_count = (int) mysql_affected_rows(mysql);
+        }
+        // consumed anyway to reach the next result
+        if (mysql_field_count(mysql) != 0) {
+            MYSQL_RES* res = mysql_store_result(mysql);
+            if (result != nullptr) {
+                result->data = (void*) res;
+                result->rows = true;
+            } else if (res != nullptr) {
+                mysql_free_result(res);
+            }
+        }
+        finish_task(context, result);
+
+        ++done;
+        if (done < batch.size()) {
+            ret = mysql_next_result(mysql);
+        }
+    }
+    if (done == batch.size()) {
+        return false;
+    }
+
+    bool lost = ret < 0 || is_conn_error(mysql_errno(mysql));
+    std::string message = ret < 0 ? "mysql batch result missing" : mysql_error(mysql);
+    RELLAF_DEBUG("exec batch failed at %zu, error : %s", done, message.c_str());
+    for (size_t i = done; i < batch.size(); ++i) {
+        MyContext* context = batch[i];
+        // not run after failed one, unless connection lost
+        if (i > done && !lost) {
+            if (is_abandoned(context)) {
+                finish_task(context, nullptr);
+                continue;
+            }
+            lost = exec_task(mysql, thread, context);
+            continue;
+        }
+        if (lost && requeue(thread, context)) {
+            continue;
+        }
+        finish_task(context, new_error(message));
+    }
+    return lost;
 }
 
 void* MysqlSimplePool::thd_routine(void* ptr) {
     MyThread* arg = (MyThread*) ptr;
+    MysqlSimplePool* pool = arg->inst;
     Queue<MyContext*>* tasks = arg->tasks;
+    const MysqlPoolOptions& options = pool->_options;
 
     MYSQL mysql;
-    mysql_init(&mysql);
     mysql_thread_init();
-    MysqlSimplePool::connect(&mysql);
+    bool connected = pool->connect(&mysql);
 
     RELLAF_DEBUG("mysql thread start");
 
-    ListNode<MyContext*>* context = nullptr;
+    bool shrunk = false;
+    uint64_t idle_since_us = monotonic_us();
+    ListNode<MyContext*>* node = nullptr;
     while (arg->status) {
-        arg->status = 2;
-//        RELLAF_DEBUG("mysql acc task count : %zu", tasks->size());
-        int ret_list = tasks->pop_block(&context, 3000);
+        if (!connected && !arg->dedicated) {
+            ++pool->_broken;
+            connected = pool->reconnect(&mysql, arg);
+            --pool->_broken;
+            idle_since_us = monotonic_us();
+            continue;
+        }
+
+        // woken to ping or shrink when idle, otherwise only by tasks and stop
+        uint32_t timeout_ms = 0;
+        if (!arg->dedicated) {
+            for (uint32_t interval : {options.health_check_ms, options.shrink_idle_ms}) {
+                if (interval > 0 && (timeout_ms == 0 || interval < timeout_ms)) {
+                    timeout_ms = interval;
+                }
+            }
+        }
+        int ret_list = tasks->pop_block(&node, timeout_ms);
         if (ret_list == -1) {
             RELLAF_DEBUG("mysql thread worker fatal");
             arg->status = 0;
             break;
         }
+        MyContext* context = node == nullptr ? nullptr : node->_data;
+        delete node;
+        node = nullptr;
         if (ret_list == 1 || context == nullptr) {
-//            RELLAF_DEBUG("pop task timeout, ret : %d, context : %lx", ret_list,
-//                    reinterpret_cast<unsigned long>(context));
+            if (!arg->status || arg->dedicated) {
+                continue;
+            }
+            uint64_t idle_ms = (monotonic_us() - idle_since_us) / 1000;
+            if (options.shrink_idle_ms > 0 && idle_ms >= options.shrink_idle_ms &&
+                    pool->try_shrink(arg)) {
+                shrunk = true;
+                break;
+            }
+            if (connected && options.health_check_ms > 0 && idle_ms >= options.health_check_ms) {
+                if (mysql_ping(&mysql) != 0) {
+                    RELLAF_DEBUG("mysql ping failed : %s", mysql_error(&mysql));
+                    ++pool->_ping_failures;
+                    MysqlSimplePool::close(&mysql);
+                    connected = false;
+                }
+            }
             continue;
         }
 
-        const std::string& sql = context->_data->sql;
-
-        InnerResult* result = new(std::nothrow) InnerResult;
-        if (result == nullptr) {
-            RELLAF_DEBUG("exec sql failed, alloc result error");
-            context->_data->latch.count_down();
-            delete context;
-            break;
+        // more queued statements joined while the queue is deep
+        std::vector<MyContext*> batch(1, context);
+        MyContext* pending = nullptr;
+        if (!arg->dedicated && connected && options.pipeline_max > 1 &&
+                pipelinable(context->sql)) {
+            uint32_t conns = std::max(pool->_conns.load(std::memory_order_relaxed), 1U);
+            size_t want = std::min<size_t>(options.pipeline_max, 1 + tasks->size() / conns);
+            while (batch.size() < want && tasks->try_pop_block(&node) == 0) {
+                MyContext* more = node == nullptr ? nullptr : node->_data;
+                delete node;
+                node = nullptr;
+                if (more == nullptr) {
+                    // wakeup of stopping, left for others
+                    tasks->add_block(nullptr, 10);
+                    break;
+                }
+                if (!pipelinable(more->sql)) {
+                    pending = more;
+                    break;
+                }
+                batch.push_back(more);
+            }
         }
-        result->status = 0;
-        result->row_count = 0;
-        result->data = nullptr;
-        *(context->_data->result) = result;
 
-        if (strncasecmp(sql.c_str(), "BEGIN", sizeof("BEGIN") - 1) == 0) {
-            RELLAF_DEBUG("BEGIN");
-
-            if (mysql_autocommit(&mysql, 0) != 0) {
-                RELLAF_DEBUG("begin transaction faild : %s", mysql_error(&mysql));
-                result->status = -1;
-                result->message = mysql_error(&mysql);
+        if (!arg->dedicated) {
+            uint64_t now_us = monotonic_us();
+            uint64_t max_wait_us = 0;
+            for (MyContext* task : batch) {
+                uint64_t wait_us = now_us - task->enqueue_us;
+                max_wait_us = std::max(max_wait_us, wait_us);
+                ++pool->_task_count;
+                pool->_wait_us += wait_us;
             }
-
-        } else if (strncasecmp(sql.c_str(), "COMMIT", sizeof("COMMIT") - 1) == 0) {
-            RELLAF_DEBUG("COMMIT");
-
-            if (mysql_commit(&mysql) != 0) {
-                RELLAF_DEBUG("commit transaction faild : %s", mysql_error(&mysql));
-                result->status = -1;
-                result->message = mysql_error(&mysql);
+            if (max_wait_us >= options.grow_wait_us) {
+                pool->grow();
             }
+        }
 
-        } else if (strncasecmp(sql.c_str(), "ROLLBACK", sizeof("ROLLBACK") - 1) == 0) {
-            RELLAF_DEBUG("ROLLBACK");
-
-            if (mysql_rollback(&mysql) != 0) {
-                RELLAF_DEBUG("rollback transaction faild : %s", mysql_error(&mysql));
-                result->status = -1;
-                result->message = mysql_error(&mysql);
-            }
+        if (!connected) {
+            // transaction thread failed to connect
+            finish_task(context, new_error("mysql not connected"));
+            continue;
+        }
 
-        } else {
-            RELLAF_DEBUG("%s", sql.substr(0, 8).c_str());
-
-            int count = 3;
-            while (count) {
-                result->status = 0;
-                if (mysql_real_query(&mysql, sql.c_str(), sql.size()) == 0) {
-                    if (strncasecmp(sql.c_str(), "INSERT", sizeof("INSERT") - 1) == 0) {
-                        uint64_t keyid = mysql_insert_id(&mysql);
-                        result->data = (void*) keyid;
-                    }
-                    result->row_count = (int) mysql_affected_rows(&mysql);
-                    if (strncasecmp(sql.c_str(), "SELECT", sizeof("SELECT") - 1) == 0) {
-                        result->data = (void*) mysql_store_result(&mysql);
-                    }
-                    break;
-                }
-                result->status = -1;
-                result->message = mysql_error(&mysql);
-                RELLAF_DEBUG("exec sql: %s failed, error : %s", sql.c_str(), mysql_error(&mysql));
-                --count;
-                MysqlSimplePool::retry(&mysql);
+        ++pool->_active;
+        bool lost = batch.size() > 1 ? pool->run_batch(&mysql, arg, batch) :
+                    pool->run_task(&mysql, arg, context);
+        if (pending != nullptr) {
+            // never sent, safe to give to another connection
+            if (!lost || tasks->add_block(pending, 1) != 0) {
+                ++pool->_task_count;
+                pool->_wait_us += monotonic_us() - pending->enqueue_us;
+                lost = pool->run_task(&mysql, arg, pending) || lost;
             }
         }
-
-        context->_data->latch.count_down();
-        delete context;
-        context = nullptr;
+        if (lost) {
+            MysqlSimplePool::close(&mysql);
+            connected = false;
+        }
+        --pool->_active;
+        idle_since_us = monotonic_us();
     }
 
     RELLAF_DEBUG("mysql thread end");
-    MysqlSimplePool::close(&mysql);
+    if (connected) {
+        MysqlSimplePool::close(&mysql);
+    }
     mysql_thread_end();
+    if (shrunk) {
+        delete arg;
+    }
     return (void*) nullptr;
 }
 
-Queue<MyContext*>* MysqlSimplePool::fetch_thread() {
-    uint32_t idx = RELLAF_ATOMIC_INC(_action_idx) % MysqlSimplePool::_s_thread_count;
-    RELLAF_DEBUG("mysql thread %u fetched, tid : %lx", idx, MysqlSimplePool::_s_pool[idx]->tid);
-    return MysqlSimplePool::_s_pool[idx]->tasks;
-}
-
-MyThread* MysqlSimplePool::new_thread() {
+MyThread* MysqlSimplePool::new_thread(bool dedicated) {
     MyThread* thread = new(std::nothrow) MyThread;
     if (thread == nullptr) {
         return nullptr;
@@ -255,78 +684,70 @@ MyThread* MysqlSimplePool::new_thread() {
     thread->status = 1;
     thread->tid = 0;
     thread->inst = this;
-    thread->tasks = new(std::nothrow) Queue<MyContext*>(MysqlSimplePool::_s_task_queue_size, true);
-    if (thread->tasks == nullptr) {
-        delete thread;
-        return nullptr;
+    thread->dedicated = dedicated;
+    if (dedicated) {
+        thread->tasks = new(std::nothrow) Queue<MyContext*>(_options.task_queue_size, true);
+        if (thread->tasks == nullptr) {
+            delete thread;
+            return nullptr;
+        }
+    } else {
+        thread->tasks = _tasks;
     }
 
     if (pthread_create(&thread->tid, nullptr, MysqlSimplePool::thd_routine, thread) != 0) {
-        delete thread->tasks;
+        if (dedicated) {
+            delete thread->tasks;
+        }
         delete thread;
         return nullptr;
     }
 
-//    while (thread->status != 2 && thread->status != 0) {
-//        RELLAF_DEBUG("pending for sql thread");
-//        sleep(1);
-//    }
-
     return thread;
 }
 
 bool MysqlSimplePool::begin(SqlTx& tx) {
     uint64_t tx_id = RELLAF_ATOMIC_INC(_action_idx);
     RELLAF_DEBUG("mysql transaction begin : %lu, current tx_pool size : %zu", tx_id,
-            _s_tx_pool.size());
+            _tx_pool.size());
 
-    MyThread* thread = new_thread();
+    MyThread* thread = new_thread(true);
     if (thread == nullptr) {
         RELLAF_DEBUG("fetch mysql thread failed, tx_id : %lu", tx_id);
         return false;
     }
 
-    InnerResult* result = nullptr;
-    MyContext context;
-    context.sql = "BEGIN";
-    context.result = &result;
-
-    thread->tasks->add_block(&context);
     RELLAF_DEBUG("tx latch waiting, txid : %lu", tx_id);
-    context.latch.wait();
+    InnerResult* result = submit(thread->tasks, "BEGIN", false);
     RELLAF_DEBUG("tx latch wait done, txid : %lu", tx_id);
 
     tx.thread = thread;
     tx.tx_id = tx_id;
-    pthread_mutex_lock(&_s_tx_lock);
-    _s_tx_pool.insert(std::make_pair(tx.tx_id, tx));
-    pthread_mutex_unlock(&_s_tx_lock);
+    pthread_mutex_lock(&_tx_lock);
+    _tx_pool.insert(std::make_pair(tx.tx_id, tx));
+    pthread_mutex_unlock(&_tx_lock);
 
-    bool re = result->status == 0;
+    bool re = result != nullptr && result->status == 0;
     delete result;
     return re;
 }
 
 bool MysqlSimplePool::tx_end(SqlTx& tx, const std::string& sql) {
     RELLAF_DEBUG("mysql transaction %s : %lu, current tx_pool size : %zu",
-            sql.c_str(), tx.tx_id, _s_tx_pool.size());
+            sql.c_str(), tx.tx_id, _tx_pool.size());
 
-    pthread_mutex_lock(&_s_tx_lock);
-    auto entry = _s_tx_pool.find(tx.tx_id);
-    pthread_mutex_unlock(&_s_tx_lock);
-    if (entry == _s_tx_pool.end()) {
+    pthread_mutex_lock(&_tx_lock);
+    auto entry = _tx_pool.find(tx.tx_id);
+    pthread_mutex_unlock(&_tx_lock);
+    if (entry == _tx_pool.end()) {
         RELLAF_DEBUG("no transaction, tx_id : %lu", tx.tx_id);
         return false;
     }
     MyThread* thread = entry->second.thread;
 
-    InnerResult* result = nullptr;
-    MyContext context;
-    context.sql = sql;
-    context.result = &result;
-    thread->tasks->add_block(&context);
+    // ended whatever the deadline, the connection is closed right after
     RELLAF_DEBUG("tx latch waiting, txid : %lu", tx.tx_id);
-    context.latch.wait();
+    InnerResult* result = submit(thread->tasks, sql, false);
     RELLAF_DEBUG("tx latch wait done, txid : %lu", tx.tx_id);
 
     RELLAF_DEBUG("mysql transaction %s, join thread start, tx_id : %lu", sql.c_str(), tx.tx_id);
@@ -337,11 +758,11 @@ bool MysqlSimplePool::tx_end(SqlTx& tx, const std::string& sql) {
     delete thread;
     RELLAF_DEBUG("mysql transaction %s, join thread end, tx_id : %lu", sql.c_str(), tx.tx_id);
 
-    pthread_mutex_lock(&_s_tx_lock);
-    _s_tx_pool.erase(tx.tx_id);
-    pthread_mutex_unlock(&_s_tx_lock);
+    pthread_mutex_lock(&_tx_lock);
+    _tx_pool.erase(tx.tx_id);
+    pthread_mutex_unlock(&_tx_lock);
 
-    bool re = result->status == 0;
+    bool re = result != nullptr && result->status == 0;
     delete result;
     return re;
 }
@@ -355,50 +776,149 @@ bool MysqlSimplePool::rollback(SqlTx& tx) {
 }
 
 void MysqlSimplePool::tx_execute(SqlTx* tx, const std::string& sql, InnerResult** result_ptr) {
-    pthread_mutex_lock(&_s_tx_lock);
-    auto entry = _s_tx_pool.find(tx->tx_id);
-    pthread_mutex_unlock(&_s_tx_lock);
-    if (entry == _s_tx_pool.end()) {
+    pthread_mutex_lock(&_tx_lock);
+    auto entry = _tx_pool.find(tx->tx_id);
+    pthread_mutex_unlock(&_tx_lock);
+    if (entry == _tx_pool.end()) {
         RELLAF_DEBUG("no transaction, tx_id : %lu", tx->tx_id);
         return;
     }
     MyThread* thread = entry->second.thread;
 
-    MyContext context;
-    context.sql = sql;
-    context.result = result_ptr;
-
-    int ret = thread->tasks->add_block(&context);
-    if (ret != 0) {
-        RELLAF_DEBUG("add task failed, ret : %d", ret);
-        *result_ptr = nullptr;
-        return;
-    }
     RELLAF_DEBUG("tx latch waiting, txid : %lu", tx->tx_id);
-//    FM_NOTICE("tx sql : %s", sql.c_str());
-    context.latch.wait();
+    *result_ptr = submit(thread->tasks, sql, true);
     RELLAF_DEBUG("tx latch wait done, txid : %lu", tx->tx_id);
 }
 
 void MysqlSimplePool::execute(const std::string& sql, InnerResult** result_ptr) {
-    auto tasks = fetch_thread();
-    if (tasks == nullptr) {
-        RELLAF_DEBUG("fetch mysql thread failed");
+    if (_tasks == nullptr) {
+        RELLAF_DEBUG("mysql pool not connected");
+        *result_ptr = nullptr;
         return;
     }
-    MyContext context;
-    context.sql = sql;
-    context.result = result_ptr;
+    RELLAF_DEBUG("latch waiting");
+    *result_ptr = submit(_tasks, sql, true);
+    RELLAF_DEBUG("latch wait done");
+}
+
+InnerResult* MysqlSimplePool::submit(Queue<MyContext*>* tasks, const std::string& sql,
+        bool timed) {
+    uint64_t deadline_us = timed ? SqlDeadline::deadline_us() : 0;
+    if (deadline_us != 0 && monotonic_us() >= deadline_us) {
+        RELLAF_DEBUG("deadline exceeded before queued : %s", sql.c_str());
+        ++_timeouts;
+        return nullptr;
+    }
+    MyContext* context = new(std::nothrow) MyContext;
+    if (context == nullptr) {
+        return nullptr;
+    }
+    context->sql = sql;
+    context->deadline_us = deadline_us;
+    context->enqueue_us = monotonic_us();
 
-    int ret = tasks->add_block(&context);
+    int ret = tasks->add_block(context, SqlDeadline::timeout_ms(deadline_us));
     if (ret != 0) {
         RELLAF_DEBUG("add task failed, ret : %d", ret);
-        *result_ptr = nullptr;
-        return;
+        if (ret == 1) {
+            ++_timeouts;
+        }
+        delete context;
+        return nullptr;
     }
-    RELLAF_DEBUG("latch waiting");
-    context.latch.wait();
-    RELLAF_DEBUG("latch wait done");
+    // queued while no connection idle
+    if (tasks == _tasks && _active.load(std::memory_order_relaxed) +
+            _broken.load(std::memory_order_relaxed) >= _conns.load(std::memory_order_relaxed)) {
+        grow();
+    }
+
+    if (context->latch.wait(SqlDeadline::timeout_ms(deadline_us)) != 0 && abandon(context)) {
+        RELLAF_DEBUG("deadline exceeded : %s", sql.c_str());
+        ++_timeouts;
+        release(context);
+        return nullptr;
+    }
+    InnerResult* result = context->result;
+    release(context);
+    return result;
+}
+
+bool MysqlSimplePool::abandon(MyContext* context) {
+    pthread_mutex_lock(&context->lock);
+    bool abandoned = context->state != MY_TASK_DONE;
+    bool kill = context->state == MY_TASK_RUNNING && !context->batched;
+    if (abandoned) {
+        context->state = MY_TASK_ABANDONED;
+    }
+    if (kill) {
+        ++context->refs;
+    }
+    pthread_mutex_unlock(&context->lock);
+
+    if (kill && (_kill_tasks == nullptr || _kill_tasks->add_block(context) != 0)) {
+        release(context);
+    }
+    return abandoned;
+}
+
+bool MysqlSimplePool::kill_query(MYSQL* side, MyContext* context) {
+    pthread_mutex_lock(&context->lock);
+    unsigned long conn_id = context->conn_id;
+    if (conn_id == 0) {
+        pthread_mutex_unlock(&context->lock);
+        return true;
+    }
+    std::string sql = "KILL QUERY " + std::to_string(conn_id);
+    bool ok = mysql_real_query(side, sql.c_str(), sql.size()) == 0;
+    unsigned int err = ok ? 0 : mysql_errno(side);
+    pthread_mutex_unlock(&context->lock);
+
+    if (ok) {
+        ++_kills;
+        return true;
+    }
+    RELLAF_DEBUG("kill query of %lu failed : %s", conn_id, mysql_error(side));
+    return !is_conn_error(err);
+}
+
+void* MysqlSimplePool::kill_routine(void* ptr) {
+    MysqlSimplePool* pool = (MysqlSimplePool*) ptr;
+    mysql_thread_init();
+
+    // connected before any kill is needed, not in the way of the statement killed
+    MYSQL side;
+    bool connected = pool->connect(&side);
+    ListNode<MyContext*>* node = nullptr;
+    while (true) {
+        pool->_kill_tasks->pop_block(&node);
+        MyContext* context = node == nullptr ? nullptr : node->_data;
+        delete node;
+        node = nullptr;
+        if (context == nullptr) {
+            break;
+        }
+        // once more on a new connection if the kept one is broken
+        for (int i = 0; i < 2; ++i) {
+            if (!connected) {
+                connected = pool->connect(&side);
+            }
+            if (!connected || pool->kill_query(&side, context)) {
+                break;
+            }
+            close(&side);
+            connected = false;
+        }
+        if (!connected) {
+            RELLAF_DEBUG("kill query failed, side connection failed");
+        }
+        release(context);
+    }
+
+    if (connected) {
+        close(&side);
+    }
+    mysql_thread_end();
+    return nullptr;
 }
 
 ////////////////// sql executor API //////////////////
@@ -407,7 +927,7 @@ SqlResult* MysqlSimplePool::select(const std::string& sql) {
     if (res == nullptr) {
         return nullptr;
     }
-    if (!select(sql, *res, nullptr)) {
+    if (select(sql, *res, nullptr) < 0) {
         delete res;
         return nullptr;
     }
@@ -435,16 +955,15 @@ int MysqlSimplePool::select(const std::string& sql, MyResult& res, SqlTx* tx) {
         return -1;
     }
 
-
-    MYSQL_RES* mysql_res = static_cast<MYSQL_RES*>(result->data);
-    if (!res.init(mysql_res)) {
-        return -1;
-    }
-
+    MYSQL_RES* mysql_res = result->rows ? static_cast<MYSQL_RES*>(result->data) : nullptr;
     int status = result->status;
     delete result;
     if (status != 0) {
-        mysql_free_result(mysql_res);
+        RELLAF_DEBUG("excute sql failed");
+        return -1;
+    }
+    // owned by `res` even if failed
+    if (!res.init(mysql_res)) {
         return -1;
     }
     return (int) (res.row_count());
@@ -462,11 +981,11 @@ int MysqlSimplePool::insert(const std::string& sql, uint64_t& keyid, SqlTx* tx)
         return -1;
     }
 
-    keyid = reinterpret_cast<uint64_t>(result->data);
+    keyid = result->rows ? 0 : reinterpret_cast<uint64_t>(result->data);
     int row_count = result->row_count;
 
     int status = result->status;
-    delete result;
+    free_result(result);
     return status == 0 ? row_count : -1;
 }
 
@@ -485,7 +1004,7 @@ int MysqlSimplePool::insert(const std::string& sql, SqlTx* tx) {
     int row_count = result->row_count;
 
     int status = result->status;
-    delete result;
+    free_result(result);
     return status == 0 ? row_count : -1;
 }
 
@@ -504,7 +1023,7 @@ int MysqlSimplePool::update(const std::string& sql, SqlTx* tx) {
     int row_count = result->row_count;
 
     int status = result->status;
-    delete result;
+    free_result(result);
     return status == 0 ? row_count : -1;
 }
 
@@ -523,12 +1042,14 @@ int MysqlSimplePool::del(const std::string& sql, SqlTx* tx) {
     int row_count = result->row_count;
 
     int status = result->status;
-    delete result;
+    free_result(result);
     return status == 0 ? row_count : -1;
 }
 
 ////////////////// result set /////////////////////
-MyTxEx::MyTxEx() {
+MyTxEx::MyTxEx() : MyTxEx(MysqlSimplePool::instance()) {}
+
+MyTxEx::MyTxEx(MysqlSimplePool& pool) : _acc(pool) {
     if (RELLAF_ATOMIC_CAS(_init, false, true)) {
         _init = _acc.begin(_tx);
     }
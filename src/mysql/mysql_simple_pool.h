@@ -21,7 +21,10 @@
 #include <assert.h>
 #include <string>
 #include <map>
+#include <deque>
+#include <vector>
 #include <functional>
+#include <atomic>
 
 #include "mysql.h"
 
@@ -31,6 +34,7 @@
 #include "common.h"
 
 #include "mysql/mysql_simple_result.h"
+#include "sql_deadline.h"
 
 namespace rellaf {
 
@@ -38,13 +42,39 @@ struct InnerResult {
     int status;
     int row_count;
     std::string message;
+    // MYSQL_RES* if `rows`, otherwise insert id
     void* data;
+    // statement returned a result set, SELECT, SHOW ...
+    bool rows = false;
+};
+
+enum MyTaskState {
+    MY_TASK_QUEUED = 0,
+    MY_TASK_RUNNING,
+    MY_TASK_DONE,
+    // caller gave up, the connection taking it cleans up
+    MY_TASK_ABANDONED
 };
 
 struct MyContext {
     std::string sql;
     Latch latch;
-    InnerResult** result;
+    InnerResult* result = nullptr;
+    // us of monotonic clock when queued
+    uint64_t enqueue_us = 0;
+    // requeued once to another connection after connection lost
+    bool retried = false;
+    // us of monotonic clock the caller gives up at, 0 never
+    uint64_t deadline_us = 0;
+    // guards state and conn_id, held by killer thread while killing the statement
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int state = MY_TASK_QUEUED;
+    // mysql thread id of connection running it, 0 if not running
+    unsigned long conn_id = 0;
+    // sent with others in one round trip, not killed to spare statements of other callers
+    bool batched = false;
+    // held by caller, by the connection taking it and by killer thread, the last one deletes
+    std::atomic<int> refs{2};
 };
 
 class MysqlSimplePool;
@@ -53,7 +83,60 @@ struct MyThread {
     pthread_t tid;
     MysqlSimplePool* inst;
     Queue<MyContext*>* tasks;
-    int status;
+    std::atomic<int> status;
+    // owned by one transaction, with its own task queue, not pinged, resized or reconnected
+    bool dedicated;
+};
+
+struct MysqlPoolOptions {
+    // connections kept even if idle
+    uint32_t min_conns = 3;
+    // connections grown to under load
+    uint32_t max_conns = 3;
+    // tasks queued and not taken by a connection yet beyond are blocked
+    uint32_t task_queue_size = 10;
+    // grow if a task waited in queue longer than it, or queued while no connection idle
+    uint32_t grow_wait_us = 2000;
+    // connections beyond `min_conns` idle longer than it are closed
+    uint32_t shrink_idle_ms = 60000;
+    // idle connections are pinged at this interval, 0 never
+    uint32_t health_check_ms = 10000;
+    // broken connections reconnected in background, the interval doubles on each failure
+    uint32_t reconnect_min_ms = 100;
+    uint32_t reconnect_max_ms = 10000;
+    // seconds, rounded up, 0 default of libmysqlclient
+    uint32_t connect_timeout_ms = 3000;
+    uint32_t read_timeout_ms = 0;
+    uint32_t write_timeout_ms = 0;
+    // queued statements sent in one round trip at most, the batch grows with queue depth,
+    // 1 no pipelining, otherwise connected with CLIENT_MULTI_STATEMENTS
+    uint32_t pipeline_max = 1;
+};
+
+struct MysqlPoolStats {
+    // connection threads, transactions excluded
+    uint32_t conns = 0;
+    // executing a task
+    uint32_t active = 0;
+    // connected and waiting for a task
+    uint32_t idle = 0;
+    // disconnected, reconnecting with backoff
+    uint32_t broken = 0;
+    // tasks queued and not taken yet
+    size_t waiting = 0;
+    uint64_t tasks = 0;
+    // sum of time tasks waited in queue
+    uint64_t wait_us = 0;
+    uint64_t reconnects = 0;
+    uint64_t ping_failures = 0;
+    uint64_t grown = 0;
+    uint64_t shrunk = 0;
+    // round trips of more than one statement, and statements in them
+    uint64_t batches = 0;
+    uint64_t batched = 0;
+    // calls failed by deadline of SqlDeadline, and statements killed of them
+    uint64_t timeouts = 0;
+    uint64_t kills = 0;
 };
 
 struct SqlTx {
@@ -63,19 +146,44 @@ struct SqlTx {
 
 class MyTxEx;
 
+/**
+ * pool of connections to one server, instances are independent of each other
+ */
 class MysqlSimplePool : public SqlExecutor {
+RELLAF_AVOID_COPY(MysqlSimplePool)
+
 public:
+    MysqlSimplePool();
+
+    /**
+     * @brief stop all connection threads
+     */
     virtual ~MysqlSimplePool();
 
+    /**
+     * @brief default pool of process
+     */
     static MysqlSimplePool& instance();
 
     void stop();
 
+    /**
+     * @brief fixed `thread_count` connections
+     */
     bool connect(const std::string& host, uint16_t port, const std::string& username,
             const std::string& password, const std::string& database,
             const std::string& charset = "utf8", uint32_t thread_count = 3,
             uint32_t task_queue_size = 10);
 
+    /**
+     * @brief start `options.min_conns` connection threads, each connects in background
+     */
+    bool connect(const std::string& host, uint16_t port, const std::string& username,
+            const std::string& password, const std::string& database,
+            const std::string& charset, const MysqlPoolOptions& options);
+
+    MysqlPoolStats stats() const;
+
 
     ////////////////// sql executor API //////////////////
     SqlResult* select(const std::string& sql) override;
@@ -102,41 +210,145 @@ public:
 
     bool rollback(SqlTx& tx);
 
-private:
-    MysqlSimplePool();
+    /**
+     * @brief single SELECT, INSERT, UPDATE, DELETE or REPLACE, safe to join a batch
+     */
+    static bool pipelinable(const std::string& sql);
 
+private:
     void execute(const std::string& sql, InnerResult** result_ptr);
 
     void tx_execute(SqlTx* tx, const std::string& sql, InnerResult** result_ptr);
 
-    static bool connect(MYSQL* mysql);
+    /**
+     * @brief queue `sql` to `tasks` and wait, within deadline of SqlDeadline if `timed`,
+     *        a statement still running at deadline is killed
+     * @return nullptr if failed to queue or timeout
+     */
+    InnerResult* submit(Queue<MyContext*>* tasks, const std::string& sql, bool timed);
 
-    static void close(MYSQL* mysql);
+    /**
+     * @brief called by caller at deadline, a running statement is handed to killer thread,
+     *        caller never waits for the kill
+     * @return if given up, otherwise the result came just in time
+     */
+    bool abandon(MyContext* context);
 
-    static void retry(MYSQL* mysql);
+    /**
+     * @brief KILL QUERY of connection running `context` through `side`, skipped if finished,
+     *        the connection waits in `finish_task` until sent
+     * @return false if `side` broken
+     */
+    bool kill_query(MYSQL* side, MyContext* context);
 
-    static void* thd_routine(void*);
+    /**
+     * @brief killer thread, kills statements of abandoned tasks over a kept alive connection
+     */
+    static void* kill_routine(void*);
 
-    Queue<MyContext*>* fetch_thread();
+    /**
+     * @return if `context` to be run by connection, otherwise finished or dropped
+     */
+    bool start_task(MYSQL* mysql, MyContext* context, bool batched = false);
 
-    MyThread* new_thread();
+    /**
+     * @brief hand `result` to caller, freed if caller gave up, drops reference of connection
+     */
+    static void finish_task(MyContext* context, InnerResult* result);
 
-    bool tx_end(SqlTx& tx, const std::string& sql);
+    static bool is_abandoned(MyContext* context);
 
-private:
-    static uint16_t _s_port;
-    static std::string _s_host;
-    static std::string _s_database;
-    static std::string _s_username;
-    static std::string _s_password;
-    static std::string _s_charset;
-    static uint32_t _s_thread_count;
-    static uint32_t _s_task_queue_size;
+    static void release(MyContext* context);
+
+    static InnerResult* new_error(const std::string& message);
+
+    /**
+     * @brief delete `result` with its result set
+     */
+    static void free_result(InnerResult* result);
+
+    bool connect(MYSQL* mysql);
 
-    static std::deque<MyThread*> _s_pool;
+    static void close(MYSQL* mysql);
+
+    static void* thd_routine(void*);
+
+    /**
+     * @return if connection lost while running `context`, the task is requeued or finished
+     */
+    bool run_task(MYSQL* mysql, MyThread* thread, MyContext* context);
+
+    /**
+     * @brief same as `run_task` for a task started already
+     */
+    bool exec_task(MYSQL* mysql, MyThread* thread, MyContext* context);
+
+    /**
+     * @brief run all of `batch` in one round trip, results demultiplexed to each caller,
+     *        statements not run after a failed one are run one by one
+     * @return if connection lost
+     */
+    bool run_batch(MYSQL* mysql, MyThread* thread, const std::vector<MyContext*>& batch);
+
+    /**
+     * @brief queue a SELECT once more after connection lost
+     * @return if requeued, caller MUST not touch `context` any more
+     */
+    bool requeue(MyThread* thread, MyContext* context);
+
+    /**
+     * @brief reconnect with exponential backoff until connected or stopped
+     */
+    bool reconnect(MYSQL* mysql, MyThread* thread);
+
+    /**
+     * @brief start one more connection thread if below max
+     */
+    void grow();
+
+    /**
+     * @brief remove calling connection thread from pool if above min
+     */
+    bool try_shrink(MyThread* thread);
+
+    MyThread* new_thread(bool dedicated);
 
-    static pthread_mutex_t _s_tx_lock;
-    static std::map<uint64_t, SqlTx> _s_tx_pool; // tx_id ==> sql_tx
+    bool tx_end(SqlTx& tx, const std::string& sql);
+
+private:
+    uint16_t _port = 0;
+    std::string _host;
+    std::string _database;
+    std::string _username;
+    std::string _password;
+    std::string _charset;
+    MysqlPoolOptions _options;
+
+    // connection threads share one task queue
+    Queue<MyContext*>* _tasks = nullptr;
+    pthread_mutex_t _pool_lock;
+    std::deque<MyThread*> _pool;
+    bool _stopping = false;
+    // abandoned tasks to be killed, nullptr stops killer thread
+    Queue<MyContext*>* _kill_tasks = nullptr;
+    pthread_t _killer_tid = 0;
+
+    std::atomic<uint32_t> _conns{0};
+    std::atomic<uint32_t> _active{0};
+    std::atomic<uint32_t> _broken{0};
+    std::atomic<uint64_t> _task_count{0};
+    std::atomic<uint64_t> _wait_us{0};
+    std::atomic<uint64_t> _reconnects{0};
+    std::atomic<uint64_t> _ping_failures{0};
+    std::atomic<uint64_t> _grown{0};
+    std::atomic<uint64_t> _shrunk{0};
+    std::atomic<uint64_t> _batches{0};
+    std::atomic<uint64_t> _batched{0};
+    std::atomic<uint64_t> _timeouts{0};
+    std::atomic<uint64_t> _kills{0};
+
+    pthread_mutex_t _tx_lock;
+    std::map<uint64_t, SqlTx> _tx_pool; // tx_id ==> sql_tx
 
     volatile uint64_t _action_idx;
 
@@ -146,8 +358,13 @@ class MyTxEx {
 RELLAF_AVOID_COPY(MyTxEx)
 
 public:
+    /**
+     * @brief transaction on default pool
+     */
     MyTxEx();
 
+    explicit MyTxEx(MysqlSimplePool& pool);
+
     virtual ~MyTxEx();
 
     bool rollback();
@@ -161,7 +378,7 @@ public:
 private:
     bool _init = false;
     bool _is_begin = false;
-    MysqlSimplePool& _acc = MysqlSimplePool::instance();
+    MysqlSimplePool& _acc;
     std::function<int()> _done;
     SqlTx _tx;
 };
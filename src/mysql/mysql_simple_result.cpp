@@ -105,6 +105,8 @@ bool MyResult::to_model(Model* model) const {
                 return -1;
             }
         }
+        // as loaded, not changed
+        ((Object*)model)->clear_dirty();
 
     } else if (is_plain(model)) {
         ((Model*)model)->set_parse(fetch(0));
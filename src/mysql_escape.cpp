@@ -83,25 +83,14 @@ size_t SqlEscape::escape_field_quote(const std::string& from, char quote, char*
 }
 
 bool SqlEscape::escape_field(const std::string& field, std::string& out) {
-
-    char field_buf[1024];
-    bool alloc_flag = false;
-    char* p = field_buf;
-    if (field.size() > 768) { // the rest of space(1024-768-1) for blackslash added after escaped
-        p = (char*)malloc((size_t)(field.size() * 1.5));
-        if (p == nullptr) {
-            out.clear();
-            return false;
-        }
-        alloc_flag = true;
-    }
-    p[0] = '\0';
-    escape_field(field, p);
-
-    out = p;
-    if (alloc_flag) {
-        free(p);
+    // escaped in place, 2 bytes for each at most, plus '\0'
+    out.resize(field.size() * 2 + 1);
+    size_t len = escape_field(field, &out[0]);
+    if (len == (size_t)-1) {
+        out.clear();
+        return false;
     }
+    out.resize(len);
     return true;
 }
 
@@ -0,0 +1,303 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <set>
+#include <new>
+#include "phase_stats.h"
+
+namespace rellaf {
+
+namespace {
+
+// trivial type, no guard on thread local access from operator new
+struct AllocCounter {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+thread_local AllocCounter t_alloc = {0, 0};
+
+struct Counters {
+    std::atomic<uint64_t> count[PhaseStats::PHASE_COUNT];
+    std::atomic<uint64_t> cpu_ns[PhaseStats::PHASE_COUNT];
+    std::atomic<uint64_t> cycles[PhaseStats::PHASE_COUNT];
+    std::atomic<uint64_t> allocs[PhaseStats::PHASE_COUNT];
+    std::atomic<uint64_t> alloc_bytes[PhaseStats::PHASE_COUNT];
+
+    Counters();
+
+    ~Counters();
+
+    void clear();
+};
+
+pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+// counters of live threads
+std::set<Counters*>* s_counters = new std::set<Counters*>;
+// sums of exited threads, wall time in cycles
+PhaseStats::Snapshot s_retired;
+
+Counters::Counters() {
+    clear();
+    pthread_mutex_lock(&s_lock);
+    s_counters->insert(this);
+    pthread_mutex_unlock(&s_lock);
+}
+
+Counters::~Counters() {
+    pthread_mutex_lock(&s_lock);
+    s_counters->erase(this);
+    for (int i = 0; i < PhaseStats::PHASE_COUNT; ++i) {
+        s_retired.count[i] += count[i].load(std::memory_order_relaxed);
+        s_retired.cpu_ns[i] += cpu_ns[i].load(std::memory_order_relaxed);
+        s_retired.wall_ns[i] += cycles[i].load(std::memory_order_relaxed);
+        s_retired.allocs[i] += allocs[i].load(std::memory_order_relaxed);
+        s_retired.alloc_bytes[i] += alloc_bytes[i].load(std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void Counters::clear() {
+    for (int i = 0; i < PhaseStats::PHASE_COUNT; ++i) {
+        count[i] = 0;
+        cpu_ns[i] = 0;
+        cycles[i] = 0;
+        allocs[i] = 0;
+        alloc_bytes[i] = 0;
+    }
+}
+
+Counters& local_counters() {
+    static thread_local Counters counters;
+    return counters;
+}
+
+// written by owner thread only
+inline void accumulate(std::atomic<uint64_t>& counter, uint64_t val) {
+    counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+}
+
+std::atomic<bool> PhaseStats::_s_enabled(false);
+
+const char* PhaseStats::name(Phase phase) {
+    static const char* names[PHASE_COUNT] = {"route", "args", "handler", "serialize",
+                                             "sql_render", "db_wait", "result_decode"};
+    return phase < PHASE_COUNT ? names[phase] : "";
+}
+
+void PhaseStats::set_enabled(bool enabled) {
+    _s_enabled = enabled;
+}
+
+bool PhaseStats::alloc_tracked() {
+#ifdef RELLAF_ALLOC_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PhaseStats::begin(Mark& mark) {
+    mark.thread = pthread_self();
+    mark.allocs = t_alloc.count;
+    mark.alloc_bytes = t_alloc.bytes;
+    mark.cpu_ns = thread_cpu_ns();
+    mark.cycles = cycles();
+}
+
+void PhaseStats::end(Phase phase, const Mark& mark) {
+    uint64_t now_cycles = cycles();
+    uint64_t now_cpu_ns = thread_cpu_ns();
+    if (!pthread_equal(mark.thread, pthread_self())) {
+        return;
+    }
+    Counters& counters = local_counters();
+    accumulate(counters.count[phase], 1);
+    accumulate(counters.cpu_ns[phase], now_cpu_ns - mark.cpu_ns);
+    accumulate(counters.cycles[phase], now_cycles - mark.cycles);
+    accumulate(counters.allocs[phase], t_alloc.count - mark.allocs);
+    accumulate(counters.alloc_bytes[phase], t_alloc.bytes - mark.alloc_bytes);
+}
+
+double PhaseStats::cycles_per_ns() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double ratio = [] {
+        struct timespec begin;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        uint64_t begin_cycles = cycles();
+        uint64_t elapsed = 0;
+        // 10ms, once
+        while (elapsed < 10000000) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            elapsed = (uint64_t)(now.tv_sec - begin.tv_sec) * 1000000000 +
+                      now.tv_nsec - begin.tv_nsec;
+        }
+        return (double)(cycles() - begin_cycles) / elapsed;
+    }();
+    return ratio;
+#else
+    return 1.0;
+#endif
+}
+
+void PhaseStats::snapshot(Snapshot& snapshot) {
+    pthread_mutex_lock(&s_lock);
+    snapshot = s_retired;
+    for (Counters* counters : *s_counters) {
+        for (int i = 0; i < PHASE_COUNT; ++i) {
+            snapshot.count[i] += counters->count[i].load(std::memory_order_relaxed);
+            snapshot.cpu_ns[i] += counters->cpu_ns[i].load(std::memory_order_relaxed);
+            snapshot.wall_ns[i] += counters->cycles[i].load(std::memory_order_relaxed);
+            snapshot.allocs[i] += counters->allocs[i].load(std::memory_order_relaxed);
+            snapshot.alloc_bytes[i] += counters->alloc_bytes[i].load(std::memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    double ratio = cycles_per_ns();
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        snapshot.wall_ns[i] = (uint64_t)(snapshot.wall_ns[i] / ratio);
+    }
+}
+
+void PhaseStats::reset() {
+    pthread_mutex_lock(&s_lock);
+    s_retired = Snapshot();
+    for (Counters* counters : *s_counters) {
+        counters->clear();
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+std::string PhaseStats::dump(bool json) {
+    Snapshot snapshot;
+    PhaseStats::snapshot(snapshot);
+    return json ? snapshot.json() : snapshot.str();
+}
+
+std::string PhaseStats::Snapshot::str() const {
+    std::string out;
+    char buf[256];
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        double calls = count[i] == 0 ? 1 : (double)count[i];
+        snprintf(buf, sizeof(buf),
+                "%s%s count=%lu cpu_us=%.1f wall_us=%.1f avg_cpu_ns=%.0f avg_wall_ns=%.0f "
+                "avg_allocs=%.1f avg_alloc_bytes=%.0f",
+                out.empty() ? "" : "\n", PhaseStats::name((Phase)i), (unsigned long)count[i],
+                cpu_ns[i] / 1000.0, wall_ns[i] / 1000.0, cpu_ns[i] / calls, wall_ns[i] / calls,
+                allocs[i] / calls, alloc_bytes[i] / calls);
+        out += buf;
+    }
+    return out;
+}
+
+std::string PhaseStats::Snapshot::json() const {
+    std::string out = "{";
+    char buf[256];
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        snprintf(buf, sizeof(buf),
+                R"(%s"%s":{"count":%lu,"cpu_ns":%lu,"wall_ns":%lu,"allocs":%lu,"alloc_bytes":%lu})",
+                i == 0 ? "" : ",", PhaseStats::name((Phase)i), (unsigned long)count[i],
+                (unsigned long)cpu_ns[i], (unsigned long)wall_ns[i], (unsigned long)allocs[i],
+                (unsigned long)alloc_bytes[i]);
+        out += buf;
+    }
+    out += "}";
+    return out;
+}
+
+}
+
+#ifdef RELLAF_ALLOC_STATS
+
+// replaced global allocation functions, counted into thread of caller while enabled
+
+static void* rellaf_counted_alloc(size_t size) {
+    if (rellaf::PhaseStats::enabled()) {
+        ++rellaf::t_alloc.count;
+        rellaf::t_alloc.bytes += size;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+    void* ptr = nullptr;
+    while ((ptr = malloc(size)) == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            return nullptr;
+        }
+        handler();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size) {
+    void* ptr = rellaf_counted_alloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return rellaf_counted_alloc(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+#endif
+
+#endif
@@ -19,7 +19,9 @@
 //
 
 #include <assert.h>
+#include <ctype.h>
 #include "sql_builder.h"
+#include "sql_rw_executor.h"
 
 namespace rellaf {
 
@@ -31,6 +33,169 @@ void SqlBuilder::set_executor(SqlExecutor* executor) {
     _executor = executor;
 }
 
+SqlResult* SqlBuilder::select_result(const std::string& method, const std::string& sql) {
+    // read of own writes forced by caller MUST not join a query started earlier
+    bool single_flight = _single_flight && !ReadWriteExecutor::ForcePrimary::active();
+    ReadWriteExecutor::ForcePrimary force_primary(_force_primary);
+    SqlExecutor* executor = this->executor();
+    // the same sql on different shards are different queries
+    const std::string* shard = ShardedExecutor::ShardKey::current();
+    std::string shard_sql;
+    if (shard != nullptr) {
+        shard_sql = *shard + '\n' + sql;
+    }
+    const std::string& key = shard == nullptr ? sql : shard_sql;
+    auto entry = _caches.find(method);
+    if (entry == _caches.end()) {
+        if (single_flight) {
+            return _flight.select(executor, sql, key);
+        }
+        return executor->select(sql);
+    }
+
+    SqlResultCache* cache = entry->second.get();
+    std::shared_ptr<const SqlRows> rows = cache->get(key);
+    if (rows != nullptr) {
+        RELLAF_DEBUG("select cache hit : %s", sql.c_str());
+        return new(std::nothrow) SqlRowsResult(rows);
+    }
+
+    uint64_t version = cache->version();
+    if (single_flight) {
+        rows = _flight.select_rows(executor, sql, key);
+    } else {
+        std::unique_ptr<SqlResult> res(executor->select(sql));
+        if (res != nullptr) {
+            rows = SqlRows::drain(res.get());
+        }
+    }
+    if (rows == nullptr) {
+        return nullptr;
+    }
+    cache->put(key, *rows, version);
+    return new(std::nothrow) SqlRowsResult(rows);
+}
+
+void SqlBuilder::invalidate_caches(const std::string& method) {
+    if (_caches.empty()) {
+        return;
+    }
+    const std::set<std::string>& tables = _tables[method];
+    for (auto& entry : _caches) {
+        const std::set<std::string>& cache_tables = _tables[entry.first];
+        // tables unknown, clear anyway
+        bool shared = tables.empty() || cache_tables.empty();
+        for (auto iter = tables.begin(); !shared && iter != tables.end(); ++iter) {
+            shared = cache_tables.count(*iter) != 0;
+        }
+        if (shared) {
+            RELLAF_DEBUG("%s invalidate result cache of %s", method.c_str(), entry.first.c_str());
+            entry.second->clear();
+        }
+    }
+}
+
+bool SqlBuilder::prepare_update_set(const std::string& method, const Object& model,
+        std::string& sql) {
+    sql.clear();
+    auto entry = _update_tables.find(method);
+    if (entry == _update_tables.end()) {
+        return false;
+    }
+    if (!model.has_dirty()) {
+        return true;
+    }
+
+    sql = "UPDATE " + entry->second + " SET ";
+    const std::vector<ModelMeta::Member>& plains = model.rellaf_meta().plains();
+    for (size_t i = 0; i < plains.size(); ++i) {
+        if (!model.is_dirty(i)) {
+            continue;
+        }
+        std::string val;
+        bool need_quote = false;
+        bool need_escape = false;
+        if (!get_plain_val_str(ModelMeta::plain_of(&model, plains[i]), val,
+                need_quote, need_escape)) {
+            sql.clear();
+            return false;
+        }
+        sql += '`';
+        sql += plains[i].name;
+        sql += "`=";
+        if (!append_sql(sql, val, need_quote, need_escape)) {
+            sql.clear();
+            return false;
+        }
+        sql += ", ";
+    }
+    sql.resize(sql.size() - 2);
+    return true;
+}
+
+void SqlBuilder::parse_tables(const std::string& pattern, std::set<std::string>& tables) {
+    // tokens of identifiers (lower case, quote removed) and commas
+    std::deque<std::string> tokens;
+    std::string token;
+    for (size_t i = 0; i <= pattern.size(); ++i) {
+        char c = i < pattern.size() ? pattern[i] : ' ';
+        if (isalnum(c) || c == '_' || c == '.' || c == '$') {
+            token += (char)tolower(c);
+            continue;
+        }
+        if (c == '`') {
+            continue;
+        }
+        if (!token.empty()) {
+            tokens.emplace_back(token);
+            token.clear();
+        }
+        if (c == ',') {
+            tokens.emplace_back(",");
+        } else if (c == '#' || c == '\'' || c == '"') {
+            // skip placeholder and literal
+            char end = c == '#' ? (i + 1 < pattern.size() && pattern[i + 1] == '[' ? ']' : '}') : c;
+            size_t pos = pattern.find(end, i + 1);
+            if (pos == std::string::npos) {
+                break;
+            }
+            i = pos;
+        }
+    }
+
+    static const std::set<std::string> keywords = {
+            "where", "on", "set", "values", "value", "select", "join", "inner", "left", "right",
+            "outer", "cross", "group", "order", "limit", "having", "union", "as", "using"
+    };
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const std::string& word = tokens[i];
+        if (word != "from" && word != "join" && word != "update" &&
+                word != "into" && word != "insert") {
+            continue;
+        }
+        size_t pos = i + 1;
+        if (word == "insert" && pos < tokens.size() && tokens[pos] == "into") {
+            continue;
+        }
+        while (pos < tokens.size() && tokens[pos] != "," && keywords.count(tokens[pos]) == 0) {
+            tables.insert(tokens[pos]);
+            // skip alias
+            ++pos;
+            if (pos < tokens.size() && tokens[pos] == "as") {
+                ++pos;
+            }
+            if (pos < tokens.size() && tokens[pos] != "," && keywords.count(tokens[pos]) == 0) {
+                ++pos;
+            }
+            // FROM a, b
+            if (word != "from" || pos >= tokens.size() || tokens[pos] != ",") {
+                break;
+            }
+            ++pos;
+        }
+    }
+}
+
 void SqlBuilder::split_section(const std::string& section_str, std::deque<std::string>& sections) {
     sections.clear();
     if (section_str.empty()) {
@@ -175,7 +340,7 @@ bool SqlBuilder::get_list_val(const Model* model, const std::deque<std::string>&
     }
 
     if (is_list(travel)) { // convert to array list
-        for (const Model* m : *((List*) travel)) {
+        for (const Model* m : *((const List*) travel)) {
             if (!is_plain(m)) {
                 continue;
             }
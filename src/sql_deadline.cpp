@@ -0,0 +1,77 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <time.h>
+#include <atomic>
+#include "sql_deadline.h"
+#include "sql_scope.h"
+
+namespace rellaf {
+
+static std::atomic<SqlDeadline::Source> s_source(nullptr);
+
+SqlDeadline::SqlDeadline(uint32_t timeout_ms) : _prev(SqlScope::current().deadline_us) {
+    if (timeout_ms == 0) {
+        return;
+    }
+    uint64_t deadline = now_us() + (uint64_t)timeout_ms * 1000;
+    if (_prev == 0 || deadline < _prev) {
+        SqlScope::current().deadline_us = deadline;
+    }
+}
+
+SqlDeadline::~SqlDeadline() {
+    SqlScope::current().deadline_us = _prev;
+}
+
+void SqlDeadline::set_source(Source source) {
+    s_source.store(source, std::memory_order_release);
+}
+
+uint64_t SqlDeadline::deadline_us() {
+    uint64_t deadline = SqlScope::current().deadline_us;
+    Source source = s_source.load(std::memory_order_acquire);
+    if (source == nullptr) {
+        return deadline;
+    }
+    int64_t left_us = source();
+    if (left_us < 0) {
+        return deadline;
+    }
+    uint64_t outer = now_us() + (uint64_t)left_us;
+    return deadline == 0 || outer < deadline ? outer : deadline;
+}
+
+uint32_t SqlDeadline::timeout_ms(uint64_t deadline_us) {
+    if (deadline_us == 0) {
+        return 0;
+    }
+    uint64_t now = now_us();
+    if (deadline_us <= now) {
+        return 1;
+    }
+    uint64_t left_ms = (deadline_us - now + 999) / 1000;
+    return left_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)left_ms;
+}
+
+uint64_t SqlDeadline::now_us() {
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
+}
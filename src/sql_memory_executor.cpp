@@ -0,0 +1,151 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <ctype.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "sql_memory_executor.h"
+
+namespace rellaf {
+
+MemoryExecutor::MemoryExecutor() {
+    pthread_rwlock_init(&_lock, nullptr);
+}
+
+MemoryExecutor::~MemoryExecutor() {
+    pthread_rwlock_destroy(&_lock);
+}
+
+void MemoryExecutor::add_table(const std::string& name, const std::deque<std::string>& fields,
+        size_t row_count, const RowGenerator& generator) {
+    std::shared_ptr<SqlRows> rows = std::make_shared<SqlRows>();
+    rows->fields = fields;
+    for (size_t i = 0; i < row_count; ++i) {
+        std::vector<std::string> row;
+        row.reserve(fields.size());
+        generator(i, row);
+        row.resize(fields.size());
+        rows->rows.emplace_back(std::move(row));
+    }
+    add_table(name, rows);
+}
+
+void MemoryExecutor::add_table(const std::string& name,
+        const std::shared_ptr<const SqlRows>& rows) {
+    std::string key = name;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    pthread_rwlock_wrlock(&_lock);
+    _tables[key] = rows;
+    pthread_rwlock_unlock(&_lock);
+}
+
+void MemoryExecutor::set_select_latency(uint32_t fixed_us, uint32_t jitter_us) {
+    _select_latency.fixed_us = fixed_us;
+    _select_latency.jitter_us = jitter_us;
+}
+
+void MemoryExecutor::set_execute_latency(uint32_t fixed_us, uint32_t jitter_us) {
+    _execute_latency.fixed_us = fixed_us;
+    _execute_latency.jitter_us = jitter_us;
+}
+
+SqlResult* MemoryExecutor::select(const std::string& sql) {
+    _select_count.fetch_add(1, std::memory_order_relaxed);
+    if (!inject(_select_latency)) {
+        RELLAF_DEBUG("memory executor deadline exceeded : %s", sql.c_str());
+        return nullptr;
+    }
+
+    std::string table = table_of(sql);
+    std::shared_ptr<const SqlRows> rows;
+    pthread_rwlock_rdlock(&_lock);
+    auto entry = _tables.find(table);
+    if (entry != _tables.end()) {
+        rows = entry->second;
+    }
+    pthread_rwlock_unlock(&_lock);
+    if (rows == nullptr) {
+        RELLAF_DEBUG("memory executor no table : %s", sql.c_str());
+        return nullptr;
+    }
+    return new(std::nothrow) SqlRowsResult(rows);
+}
+
+int MemoryExecutor::execute(const std::string& sql, uint64_t& key_id) {
+    key_id = _execute_count.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!inject(_execute_latency)) {
+        RELLAF_DEBUG("memory executor deadline exceeded : %s", sql.c_str());
+        return -1;
+    }
+    return 1;
+}
+
+std::string MemoryExecutor::table_of(const std::string& sql) {
+    size_t len = sql.size();
+    for (size_t i = 0; i + 4 <= len; ++i) {
+        if (strncasecmp(sql.c_str() + i, "FROM", 4) != 0 ||
+            (i > 0 && !isspace((unsigned char)sql[i - 1])) ||
+            (i + 4 < len && !isspace((unsigned char)sql[i + 4]))) {
+            continue;
+        }
+        size_t pos = i + 4;
+        while (pos < len && isspace((unsigned char)sql[pos])) {
+            ++pos;
+        }
+        std::string table;
+        for (; pos < len; ++pos) {
+            char c = sql[pos];
+            if (c == '`') {
+                continue;
+            }
+            if (!isalnum((unsigned char)c) && c != '_' && c != '.' && c != '$') {
+                break;
+            }
+            table += (char)tolower((unsigned char)c);
+        }
+        return table;
+    }
+    return "";
+}
+
+bool MemoryExecutor::inject(const Latency& latency) {
+    static thread_local unsigned int seed = (unsigned int)(uintptr_t)&seed;
+    uint32_t sleep_us = latency.fixed_us.load(std::memory_order_relaxed);
+    uint32_t jitter_us = latency.jitter_us.load(std::memory_order_relaxed);
+    if (jitter_us > 0) {
+        sleep_us += (uint32_t)rand_r(&seed) % (jitter_us + 1);
+    }
+    uint64_t deadline_us = SqlDeadline::deadline_us();
+    if (deadline_us > 0) {
+        uint64_t now_us = SqlDeadline::now_us();
+        if (now_us >= deadline_us) {
+            return false;
+        }
+        if (now_us + sleep_us > deadline_us) {
+            usleep((useconds_t)(deadline_us - now_us));
+            return false;
+        }
+    }
+    if (sleep_us > 0) {
+        usleep(sleep_us);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,191 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <time.h>
+#include <functional>
+#include <iterator>
+#include "sql_result_cache.h"
+#include "varint.h"
+
+namespace rellaf {
+
+static int64_t monotonic_ms() {
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return tspec.tv_sec * 1000 + tspec.tv_nsec / 1000000;
+}
+
+static void append_str(std::string& buf, const std::string& str) {
+    append_varint(buf, str.size());
+    buf += str;
+}
+
+static bool read_str(const std::string& buf, size_t& pos, std::string& str) {
+    uint64_t len = 0;
+    if (!read_varint(buf, pos, len) || len > buf.size() - pos) {
+        return false;
+    }
+    str.assign(buf, pos, len);
+    pos += len;
+    return true;
+}
+
+SqlLruCache::SqlLruCache(int64_t ttl_ms, size_t max_bytes, size_t shard_num) :
+        _ttl_ms(ttl_ms),
+        _shard_num(shard_num == 0 ? 1 : shard_num) {
+    _shard_max_bytes = max_bytes / _shard_num;
+    _shards.reset(new Shard[_shard_num]);
+}
+
+SqlLruCache::~SqlLruCache() {
+    clear();
+}
+
+void SqlLruCache::serialize(const SqlRows& rows, std::string& buf) {
+    buf.clear();
+    append_varint(buf, rows.fields.size());
+    for (auto& field : rows.fields) {
+        append_str(buf, field);
+    }
+    append_varint(buf, rows.rows.size());
+    for (auto& row : rows.rows) {
+        for (auto& val : row) {
+            append_str(buf, val);
+        }
+    }
+}
+
+bool SqlLruCache::parse(const std::string& buf, SqlRows& rows) {
+    size_t pos = 0;
+    uint64_t field_count = 0;
+    if (!read_varint(buf, pos, field_count) || field_count > buf.size()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < field_count; ++i) {
+        std::string field;
+        if (!read_str(buf, pos, field)) {
+            return false;
+        }
+        rows.fields.emplace_back(std::move(field));
+    }
+    uint64_t row_count = 0;
+    if (!read_varint(buf, pos, row_count) || row_count > buf.size()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < row_count; ++i) {
+        std::vector<std::string> row(field_count);
+        for (auto& val : row) {
+            if (!read_str(buf, pos, val)) {
+                return false;
+            }
+        }
+        rows.rows.emplace_back(std::move(row));
+    }
+    return pos == buf.size();
+}
+
+SqlLruCache::Shard& SqlLruCache::shard_of(const std::string& key) {
+    return _shards[std::hash<std::string>()(key) % _shard_num];
+}
+
+void SqlLruCache::erase(Shard& shard, std::list<Entry>::iterator iter) {
+    shard.bytes -= iter->key.size() + iter->buf.size();
+    shard.index.erase(iter->key);
+    shard.lru.erase(iter);
+}
+
+std::shared_ptr<const SqlRows> SqlLruCache::get(const std::string& key) {
+    Shard& shard = shard_of(key);
+    std::string buf;
+
+    pthread_mutex_lock(&shard.mutex);
+    auto entry = shard.index.find(key);
+    if (entry == shard.index.end()) {
+        pthread_mutex_unlock(&shard.mutex);
+        return nullptr;
+    }
+    auto iter = entry->second;
+    if (iter->expire_ms <= monotonic_ms()) {
+        erase(shard, iter);
+        pthread_mutex_unlock(&shard.mutex);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter);
+    buf = iter->buf;
+    pthread_mutex_unlock(&shard.mutex);
+
+    std::shared_ptr<SqlRows> rows = std::make_shared<SqlRows>();
+    if (!parse(buf, *rows)) {
+        RELLAF_DEBUG("parse cached rows failed : %s", key.c_str());
+        return nullptr;
+    }
+    return rows;
+}
+
+void SqlLruCache::put(const std::string& key, const SqlRows& rows, uint64_t version) {
+    std::string buf;
+    serialize(rows, buf);
+    size_t bytes = key.size() + buf.size();
+    if (bytes > _shard_max_bytes) {
+        return;
+    }
+    Shard& shard = shard_of(key);
+    int64_t expire_ms = monotonic_ms() + _ttl_ms;
+
+    pthread_mutex_lock(&shard.mutex);
+    // invalidated while querying
+    if (version != _version) {
+        pthread_mutex_unlock(&shard.mutex);
+        return;
+    }
+    auto entry = shard.index.find(key);
+    if (entry != shard.index.end()) {
+        erase(shard, entry->second);
+    }
+    while (!shard.lru.empty() && shard.bytes + bytes > _shard_max_bytes) {
+        erase(shard, std::prev(shard.lru.end()));
+    }
+    shard.lru.push_front(Entry{key, std::move(buf), expire_ms});
+    shard.index.emplace(key, shard.lru.begin());
+    shard.bytes += bytes;
+    pthread_mutex_unlock(&shard.mutex);
+}
+
+void SqlLruCache::clear() {
+    RELLAF_ATOMIC_INC(_version);
+    for (size_t i = 0; i < _shard_num; ++i) {
+        Shard& shard = _shards[i];
+        pthread_mutex_lock(&shard.mutex);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+}
+
+size_t SqlLruCache::bytes() {
+    size_t total = 0;
+    for (size_t i = 0; i < _shard_num; ++i) {
+        Shard& shard = _shards[i];
+        pthread_mutex_lock(&shard.mutex);
+        total += shard.bytes;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,224 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sql_rw_executor.h"
+#include "sql_scope.h"
+
+namespace rellaf {
+
+ReadWriteExecutor::ForcePrimary::ForcePrimary(bool enable) : _enable(enable) {
+    if (_enable) {
+        ++SqlScope::current().force_primary;
+    }
+}
+
+ReadWriteExecutor::ForcePrimary::~ForcePrimary() {
+    if (_enable) {
+        --SqlScope::current().force_primary;
+    }
+}
+
+bool ReadWriteExecutor::ForcePrimary::active() {
+    return SqlScope::current().force_primary > 0;
+}
+
+ReadWriteExecutor::ReadWriteExecutor(SqlExecutor* primary, const ReadWriteOptions& options) :
+        _primary(primary), _options(options) {
+    pthread_mutex_init(&_mutex, nullptr);
+    pthread_cond_init(&_cond, nullptr);
+}
+
+ReadWriteExecutor::~ReadWriteExecutor() {
+    stop();
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+}
+
+void ReadWriteExecutor::add_replica(SqlExecutor* replica) {
+    if (replica == nullptr) {
+        return;
+    }
+    std::unique_ptr<Replica> r(new(std::nothrow) Replica);
+    if (r == nullptr) {
+        return;
+    }
+    r->executor = replica;
+    _replicas.emplace_back(std::move(r));
+}
+
+void ReadWriteExecutor::set_lag_probe(const LagProbe& probe) {
+    _probe = probe;
+}
+
+bool ReadWriteExecutor::start() {
+    probe();
+    if (_probing || _options.probe_interval_ms == 0 || !_probe || _replicas.empty()) {
+        return true;
+    }
+    _stopping = false;
+    if (pthread_create(&_probe_tid, nullptr, probe_routine, this) != 0) {
+        RELLAF_DEBUG("create lag probe thread failed");
+        return false;
+    }
+    _probing = true;
+    return true;
+}
+
+void ReadWriteExecutor::stop() {
+    if (!_probing) {
+        return;
+    }
+    pthread_mutex_lock(&_mutex);
+    _stopping = true;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_probe_tid, nullptr);
+    _probing = false;
+}
+
+void ReadWriteExecutor::probe() {
+    if (!_probe) {
+        return;
+    }
+    for (auto& replica : _replicas) {
+        int64_t lag = _probe(replica->executor);
+        if (lag < 0) {
+            RELLAF_DEBUG("replica %p unavailable", replica->executor);
+        }
+        replica->lag_ms.store(lag, std::memory_order_relaxed);
+    }
+}
+
+void* ReadWriteExecutor::probe_routine(void* arg) {
+    ReadWriteExecutor* self = (ReadWriteExecutor*)arg;
+    pthread_mutex_lock(&self->_mutex);
+    while (!self->_stopping) {
+        uint32_t interval = self->_options.probe_interval_ms;
+        struct timespec tspec{};
+        clock_gettime(CLOCK_REALTIME, &tspec);
+        tspec.tv_sec += interval / 1000;
+        tspec.tv_nsec += (long)(interval % 1000) * 1000000;
+        if (tspec.tv_nsec >= 1000000000) {
+            tspec.tv_sec += 1;
+            tspec.tv_nsec -= 1000000000;
+        }
+        if (pthread_cond_timedwait(&self->_cond, &self->_mutex, &tspec) != ETIMEDOUT) {
+            continue;
+        }
+        pthread_mutex_unlock(&self->_mutex);
+        self->probe();
+        pthread_mutex_lock(&self->_mutex);
+    }
+    pthread_mutex_unlock(&self->_mutex);
+    return nullptr;
+}
+
+ReadWriteExecutor::Replica* ReadWriteExecutor::pick() {
+    size_t count = _replicas.size();
+    if (count == 0) {
+        return nullptr;
+    }
+    size_t start = _rotate.fetch_add(1, std::memory_order_relaxed) % count;
+    Replica* best = nullptr;
+    int best_outstanding = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Replica* replica = _replicas[(start + i) % count].get();
+        int64_t lag = replica->lag_ms.load(std::memory_order_relaxed);
+        if (lag < 0 || (_options.max_lag_ms > 0 && lag > _options.max_lag_ms)) {
+            continue;
+        }
+        int outstanding = replica->outstanding.load(std::memory_order_relaxed);
+        if (best == nullptr || outstanding < best_outstanding) {
+            best = replica;
+            best_outstanding = outstanding;
+        }
+    }
+    return best;
+}
+
+SqlResult* ReadWriteExecutor::select(const std::string& sql) {
+    if (!ForcePrimary::active() && is_replica_read(sql)) {
+        Replica* replica = pick();
+        if (replica != nullptr) {
+            replica->outstanding.fetch_add(1, std::memory_order_relaxed);
+            SqlResult* res = replica->executor->select(sql);
+            replica->outstanding.fetch_sub(1, std::memory_order_relaxed);
+            replica->reads.fetch_add(1, std::memory_order_relaxed);
+            if (res != nullptr || !_options.fallback_to_primary) {
+                return res;
+            }
+            RELLAF_DEBUG("replica select failed, retry on primary : %s", sql.c_str());
+        } else if (!_options.fallback_to_primary) {
+            RELLAF_DEBUG("no replica available : %s", sql.c_str());
+            return nullptr;
+        }
+    }
+    _primary_reads.fetch_add(1, std::memory_order_relaxed);
+    return _primary->select(sql);
+}
+
+int ReadWriteExecutor::execute(const std::string& sql, uint64_t& key_id) {
+    return _primary->execute(sql, key_id);
+}
+
+int64_t ReadWriteExecutor::mysql_lag_probe(SqlExecutor* replica) {
+    std::unique_ptr<SqlResult> res(replica->select("SHOW SLAVE STATUS"));
+    if (res == nullptr || !res->next()) {
+        return -1;
+    }
+    for (size_t i = 0; i < res->field_count(); ++i) {
+        if (res->field_name(i) != "Seconds_Behind_Master") {
+            continue;
+        }
+        std::string val = res->fetch(i);
+        // NULL if replication stopped
+        if (val.empty() || !isdigit(val[0])) {
+            return -1;
+        }
+        return strtoll(val.c_str(), nullptr, 10) * 1000;
+    }
+    return -1;
+}
+
+bool ReadWriteExecutor::is_replica_read(const std::string& sql) {
+    // lower case, blanks and semicolons folded into one space
+    std::string str;
+    str.reserve(sql.size() + 1);
+    for (char c : sql) {
+        if (isspace(c) || c == ';') {
+            if (!str.empty() && str.back() != ' ') {
+                str += ' ';
+            }
+            continue;
+        }
+        str += (char)tolower(c);
+    }
+    str += ' ';
+
+    if (str.compare(0, 7, "select ") != 0 && str.compare(0, 7, "select(") != 0) {
+        return false;
+    }
+    return str.find(" for update ") == std::string::npos &&
+           str.find(" for share ") == std::string::npos &&
+           str.find(" lock in share mode ") == std::string::npos;
+}
+
+}
@@ -0,0 +1,41 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <atomic>
+#include "sql_scope.h"
+
+namespace rellaf {
+
+static thread_local SqlScopeState tls_state;
+static std::atomic<SqlScope::Provider> s_provider(nullptr);
+
+void SqlScope::set_provider(Provider provider) {
+    s_provider.store(provider, std::memory_order_release);
+}
+
+SqlScopeState& SqlScope::current() {
+    Provider provider = s_provider.load(std::memory_order_acquire);
+    if (provider != nullptr) {
+        SqlScopeState* state = provider();
+        if (state != nullptr) {
+            return *state;
+        }
+    }
+    return tls_state;
+}
+
+}
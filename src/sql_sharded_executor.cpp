@@ -0,0 +1,111 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <ctype.h>
+#include <stdlib.h>
+#include "sql_sharded_executor.h"
+#include "sql_scope.h"
+
+namespace rellaf {
+
+ShardedExecutor::ShardKey::ShardKey(const std::string& key) :
+        _key(key), _prev(SqlScope::current().shard_key), _set(!key.empty()) {
+    if (_set) {
+        SqlScope::current().shard_key = &_key;
+    }
+}
+
+ShardedExecutor::ShardKey::~ShardKey() {
+    if (_set) {
+        SqlScope::current().shard_key = _prev;
+    }
+}
+
+const std::string* ShardedExecutor::ShardKey::current() {
+    return SqlScope::current().shard_key;
+}
+
+void ShardedExecutor::add_shard(SqlExecutor* shard) {
+    if (shard != nullptr) {
+        _shards.push_back(shard);
+    }
+}
+
+void ShardedExecutor::set_selector(const Selector& selector) {
+    _selector = selector;
+}
+
+size_t ShardedExecutor::default_selector(const std::string& key, size_t shard_count) {
+    bool integer = !key.empty() && key.size() <= 19;
+    for (size_t i = 0; integer && i < key.size(); ++i) {
+        integer = isdigit(key[i]) || (i == 0 && key[i] == '-' && key.size() > 1);
+    }
+    if (integer) {
+        int64_t val = strtoll(key.c_str(), nullptr, 10);
+        return (size_t)((uint64_t)(val < 0 ? -val : val) % shard_count);
+    }
+    // stable across processes, unlike std::hash
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : key) {
+        hash ^= (uint8_t)c;
+        hash *= 1099511628211ULL;
+    }
+    return (size_t)(hash % shard_count);
+}
+
+SqlExecutor* ShardedExecutor::shard(const std::string& key) const {
+    if (_shards.empty()) {
+        return nullptr;
+    }
+    size_t idx = _selector ? _selector(key, _shards.size()) :
+                 default_selector(key, _shards.size());
+    if (idx >= _shards.size()) {
+        RELLAF_DEBUG("shard index %zu of key %s out of range", idx, key.c_str());
+        return nullptr;
+    }
+    return _shards[idx];
+}
+
+SqlExecutor* ShardedExecutor::current_shard() const {
+    const std::string* key = ShardKey::current();
+    if (key != nullptr) {
+        return shard(*key);
+    }
+    if (_shards.size() == 1) {
+        return _shards.front();
+    }
+    RELLAF_DEBUG("no shard key");
+    return nullptr;
+}
+
+SqlResult* ShardedExecutor::select(const std::string& sql) {
+    SqlExecutor* executor = current_shard();
+    if (executor == nullptr) {
+        return nullptr;
+    }
+    return executor->select(sql);
+}
+
+int ShardedExecutor::execute(const std::string& sql, uint64_t& key_id) {
+    SqlExecutor* executor = current_shard();
+    if (executor == nullptr) {
+        return -1;
+    }
+    return executor->execute(sql, key_id);
+}
+
+}
@@ -0,0 +1,182 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include "sql_single_flight.h"
+#include "sql_deadline.h"
+
+namespace rellaf {
+
+std::shared_ptr<SqlRows> SqlRows::drain(SqlResult* result) {
+    std::shared_ptr<SqlRows> rows = std::make_shared<SqlRows>();
+    size_t field_count = result->field_count();
+    for (size_t i = 0; i < field_count; ++i) {
+        rows->fields.emplace_back(result->field_name(i));
+    }
+    while (result->next()) {
+        std::vector<std::string> row;
+        row.reserve(field_count);
+        for (size_t i = 0; i < field_count; ++i) {
+            row.emplace_back(result->fetch(i));
+        }
+        rows->rows.emplace_back(std::move(row));
+    }
+    return rows;
+}
+
+size_t SqlRowsResult::row_count() const {
+    return _rows->rows.size();
+}
+
+size_t SqlRowsResult::field_count() const {
+    return _rows->fields.size();
+}
+
+std::string SqlRowsResult::field_name(size_t index) const {
+    assert(index < _rows->fields.size());
+    return _rows->fields[index];
+}
+
+bool SqlRowsResult::next() {
+    if (_next >= _rows->rows.size()) {
+        return false;
+    }
+    ++_next;
+    return true;
+}
+
+std::string SqlRowsResult::fetch(size_t index) const {
+    assert(_next > 0 && index < _rows->fields.size());
+    return _rows->rows[_next - 1][index];
+}
+
+bool SqlRowsResult::to_model(Model* model) const {
+    if (field_count() == 0 || _next == 0) {
+        return true;
+    }
+
+    const std::vector<std::string>& row = _rows->rows[_next - 1];
+    if (model->rellaf_type() == ModelTypeEnum::e().OBJECT) {
+        for (size_t i = 0; i < field_count(); ++i) {
+            if (!((Object*)model)->set_plain(_rows->fields[i], row[i])) {
+                RELLAF_DEBUG("set result key %s failed", _rows->fields[i].c_str());
+            }
+        }
+        // as loaded, not changed
+        ((Object*)model)->clear_dirty();
+    } else if (is_plain(model)) {
+        model->set_parse(row[0]);
+    }
+    return true;
+}
+
+SqlResult* SqlSingleFlight::select(SqlExecutor* executor, const std::string& sql) {
+    return select(executor, sql, sql);
+}
+
+SqlResult* SqlSingleFlight::select(SqlExecutor* executor, const std::string& sql,
+        const std::string& key) {
+    std::shared_ptr<const SqlRows> rows = select_rows(executor, sql, key);
+    if (rows == nullptr) {
+        return nullptr;
+    }
+    return new(std::nothrow) SqlRowsResult(rows);
+}
+
+std::shared_ptr<const SqlRows> SqlSingleFlight::select_rows(SqlExecutor* executor,
+        const std::string& sql) {
+    return select_rows(executor, sql, sql);
+}
+
+std::shared_ptr<const SqlRows> SqlSingleFlight::select_rows(SqlExecutor* executor,
+        const std::string& sql, const std::string& key) {
+    std::shared_ptr<Call> call;
+    bool leader = false;
+
+    pthread_mutex_lock(&_lock);
+    auto entry = _calls.find(key);
+    if (entry == _calls.end()) {
+        call = std::make_shared<Call>();
+        _calls.emplace(key, call);
+        leader = true;
+    } else {
+        call = entry->second;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    if (leader) {
+        std::shared_ptr<const SqlRows> rows;
+        std::unique_ptr<SqlResult> res(executor->select(sql));
+        if (res != nullptr) {
+            rows = SqlRows::drain(res.get());
+        }
+
+        // callers come after this query new a flight
+        pthread_mutex_lock(&_lock);
+        _calls.erase(key);
+        pthread_mutex_unlock(&_lock);
+
+        pthread_mutex_lock(&call->mutex);
+        call->rows = rows;
+        call->done = true;
+        pthread_cond_broadcast(&call->cond);
+        pthread_mutex_unlock(&call->mutex);
+    } else {
+        // followers wait no longer than their own deadline
+        uint64_t deadline_us = SqlDeadline::deadline_us();
+        struct timespec abstime;
+        if (deadline_us > 0) {
+            uint64_t now_us = SqlDeadline::now_us();
+            uint64_t left_us = deadline_us > now_us ? deadline_us - now_us : 0;
+            clock_gettime(CLOCK_REALTIME, &abstime);
+            abstime.tv_sec += left_us / 1000000;
+            abstime.tv_nsec += (left_us % 1000000) * 1000;
+            if (abstime.tv_nsec >= 1000000000) {
+                abstime.tv_sec += 1;
+                abstime.tv_nsec -= 1000000000;
+            }
+        }
+        pthread_mutex_lock(&call->mutex);
+        while (!call->done) {
+            if (deadline_us == 0) {
+                pthread_cond_wait(&call->cond, &call->mutex);
+            } else if (pthread_cond_timedwait(&call->cond, &call->mutex, &abstime) == ETIMEDOUT) {
+                break;
+            }
+        }
+        bool done = call->done;
+        pthread_mutex_unlock(&call->mutex);
+        if (!done) {
+            RELLAF_DEBUG("select coalesced deadline exceeded : %s", sql.c_str());
+            return nullptr;
+        }
+        RELLAF_DEBUG("select coalesced : %s", sql.c_str());
+    }
+
+    return call->rows;
+}
+
+size_t SqlSingleFlight::in_flight() {
+    pthread_mutex_lock(&_lock);
+    size_t count = _calls.size();
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+}
@@ -0,0 +1,65 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// base 128 varint and zigzag helpers
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace rellaf {
+
+inline void append_varint(std::string& buf, uint64_t val) {
+    char tmp[10];
+    size_t len = 0;
+    while (val >= 0x80) {
+        tmp[len++] = (char)(val | 0x80);
+        val >>= 7;
+    }
+    tmp[len++] = (char)val;
+    buf.append(tmp, len);
+}
+
+/**
+ * @return false if truncated or longer than 10 bytes
+ */
+inline bool read_varint(const char* buf, size_t len, size_t& pos, uint64_t& val) {
+    val = 0;
+    for (int shift = 0; shift < 64 && pos < len; shift += 7) {
+        uint8_t byte = (uint8_t)buf[pos++];
+        val |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool read_varint(const std::string& buf, size_t& pos, uint64_t& val) {
+    return read_varint(buf.data(), buf.size(), pos, val);
+}
+
+inline uint64_t zigzag_encode(int64_t val) {
+    return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t val) {
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+}
@@ -0,0 +1,418 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+// mysql.h not included, handles are opaque here, so the fake fits any client version.
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <map>
+#include <set>
+#include <string>
+#include "mysql_fake.h"
+
+namespace rellaf {
+namespace test {
+
+// errmsg.h and mysqld_error.h
+static const unsigned int CR_CONN_HOST_ERROR = 2003;
+static const unsigned int CR_SERVER_LOST = 2013;
+static const unsigned int ER_PARSE_ERROR = 1064;
+static const unsigned int ER_QUERY_INTERRUPTED = 1317;
+static const unsigned long CLIENT_MULTI_STATEMENTS = 1UL << 16;
+
+static const uint64_t SLOW_MAX_US = 1000000;
+static const uint64_t LATE_US = 100000;
+
+struct FakeConn {
+    bool connected = false;
+    bool multi = false;
+    unsigned long id = 0;
+    unsigned int err = 0;
+    std::string message;
+    // running a statement which KILL QUERY interrupts
+    bool killable = false;
+    bool killed = false;
+    // statements of last query, and the one whose result is current
+    std::vector<std::string> stmts;
+    size_t cur = 0;
+};
+
+struct FakeResult {
+    int dummy = 0;
+};
+
+// guards all below
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<const void*, FakeConn> s_conns;
+static std::set<const FakeResult*> s_results;
+static std::vector<uint64_t> s_connect_times;
+static unsigned long s_next_id = 0;
+static int s_fail_connects = 0;
+static int s_lose_queries = 0;
+static int s_fail_pings = 0;
+static int s_connects = 0;
+static int s_queries = 0;
+static int s_kills = 0;
+static int s_pings = 0;
+static int s_stored = 0;
+static int s_bad_frees = 0;
+
+static uint64_t monotonic_us() {
+    struct timespec tspec;
+    clock_gettime(CLOCK_MONOTONIC, &tspec);
+    return (uint64_t)tspec.tv_sec * 1000000 + tspec.tv_nsec / 1000;
+}
+
+static void set_error(FakeConn& conn, unsigned int err, const char* message) {
+    conn.err = err;
+    conn.message = message;
+    if (err == CR_SERVER_LOST) {
+        conn.connected = false;
+    }
+}
+
+/**
+ * @brief run statement `cur` of `mysql`, `s_lock` held and released while it runs
+ * @return 0 if succeeded
+ */
+static int run_stmt(const void* mysql) {
+    FakeConn& conn = s_conns[mysql];
+    const std::string stmt = conn.stmts[conn.cur];
+    ++s_queries;
+    if (stmt.find("SLOW") != std::string::npos) {
+        conn.killable = true;
+        conn.killed = false;
+        uint64_t start_us = monotonic_us();
+        while (!conn.killed && monotonic_us() - start_us < SLOW_MAX_US) {
+            pthread_mutex_unlock(&s_lock);
+            usleep(2000);
+            pthread_mutex_lock(&s_lock);
+        }
+        conn.killable = false;
+        if (conn.killed) {
+            set_error(conn, ER_QUERY_INTERRUPTED, "Query execution was interrupted");
+            return 1;
+        }
+    } else if (stmt.find("LATE") != std::string::npos) {
+        pthread_mutex_unlock(&s_lock);
+        usleep(LATE_US);
+        pthread_mutex_lock(&s_lock);
+    }
+    if (stmt.find("FAIL") != std::string::npos) {
+        set_error(conn, ER_PARSE_ERROR, "You have an error in your SQL syntax");
+        return 1;
+    }
+    return 0;
+}
+
+void MysqlFake::reset() {
+    pthread_mutex_lock(&s_lock);
+    s_connect_times.clear();
+    s_fail_connects = 0;
+    s_lose_queries = 0;
+    s_fail_pings = 0;
+    s_connects = 0;
+    s_queries = 0;
+    s_kills = 0;
+    s_pings = 0;
+    s_stored = 0;
+    s_bad_frees = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+#define MYSQL_FAKE_SET(_name_, _var_)       \
+void MysqlFake::_name_(int count) {         \
+    pthread_mutex_lock(&s_lock);            \
+    _var_ = count;                          \
+    pthread_mutex_unlock(&s_lock);          \
+}
+
+MYSQL_FAKE_SET(fail_connects, s_fail_connects)
+MYSQL_FAKE_SET(lose_queries, s_lose_queries)
+MYSQL_FAKE_SET(fail_pings, s_fail_pings)
+
+#define MYSQL_FAKE_GET(_name_, _expr_)      \
+int MysqlFake::_name_() {                   \
+    pthread_mutex_lock(&s_lock);            \
+    int val = (int)(_expr_);                \
+    pthread_mutex_unlock(&s_lock);          \
+    return val;                             \
+}
+
+MYSQL_FAKE_GET(connects, s_connects)
+MYSQL_FAKE_GET(queries, s_queries)
+MYSQL_FAKE_GET(kills, s_kills)
+MYSQL_FAKE_GET(pings, s_pings)
+MYSQL_FAKE_GET(stored_results, s_stored)
+MYSQL_FAKE_GET(open_results, s_results.size())
+MYSQL_FAKE_GET(bad_frees, s_bad_frees)
+
+int MysqlFake::open_conns() {
+    pthread_mutex_lock(&s_lock);
+    int count = 0;
+    for (auto& entry : s_conns) {
+        count += entry.second.connected ? 1 : 0;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+std::vector<uint64_t> MysqlFake::connect_times() {
+    pthread_mutex_lock(&s_lock);
+    std::vector<uint64_t> times = s_connect_times;
+    pthread_mutex_unlock(&s_lock);
+    return times;
+}
+
+}
+}
+
+using rellaf::test::FakeConn;
+using rellaf::test::FakeResult;
+using namespace rellaf::test;
+
+extern "C" {
+
+int mysql_server_init(int argc, char** argv, char** groups) {
+    return 0;
+}
+
+// a function in some client versions, a macro of `mysql_server_init` in others
+int mysql_library_init(int argc, char** argv, char** groups) {
+    return 0;
+}
+
+bool mysql_thread_init() {
+    return false;
+}
+
+void mysql_thread_end() {}
+
+void* mysql_init(void* mysql) {
+    if (mysql == nullptr) {
+        return nullptr;
+    }
+    pthread_mutex_lock(&s_lock);
+    s_conns[mysql] = FakeConn();
+    pthread_mutex_unlock(&s_lock);
+    return mysql;
+}
+
+int mysql_options(void* mysql, int option, const void* arg) {
+    return 0;
+}
+
+void* mysql_real_connect(void* mysql, const char* host, const char* user, const char* passwd,
+        const char* db, unsigned int port, const char* unix_socket, unsigned long flags) {
+    pthread_mutex_lock(&s_lock);
+    FakeConn& conn = s_conns[mysql];
+    ++s_connects;
+    s_connect_times.push_back(monotonic_us());
+    bool ok = s_fail_connects == 0;
+    if (ok) {
+        conn.connected = true;
+        conn.multi = (flags & CLIENT_MULTI_STATEMENTS) != 0;
+        conn.id = ++s_next_id;
+        conn.err = 0;
+    } else {
+        --s_fail_connects;
+        set_error(conn, CR_CONN_HOST_ERROR, "Can't connect to MySQL server");
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ok ? mysql : nullptr;
+}
+
+void mysql_close(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    s_conns.erase(mysql);
+    pthread_mutex_unlock(&s_lock);
+}
+
+unsigned int mysql_errno(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    unsigned int err = s_conns[mysql].err;
+    pthread_mutex_unlock(&s_lock);
+    return err;
+}
+
+const char* mysql_error(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    // node of map stays, changed only by the thread owning the connection
+    const char* message = s_conns[mysql].message.c_str();
+    pthread_mutex_unlock(&s_lock);
+    return message;
+}
+
+unsigned long mysql_thread_id(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    unsigned long id = s_conns[mysql].id;
+    pthread_mutex_unlock(&s_lock);
+    return id;
+}
+
+int mysql_real_query(void* mysql, const char* query, unsigned long length) {
+    std::string sql(query, length);
+    pthread_mutex_lock(&s_lock);
+    FakeConn& conn = s_conns[mysql];
+    conn.err = 0;
+    conn.message.clear();
+    if (!conn.connected) {
+        set_error(conn, CR_SERVER_LOST, "Lost connection to MySQL server during query");
+        pthread_mutex_unlock(&s_lock);
+        return 1;
+    }
+
+    if (sql.compare(0, 11, "KILL QUERY ") == 0) {
+        unsigned long id = strtoul(sql.c_str() + 11, nullptr, 10);
+        ++s_kills;
+        for (auto& entry : s_conns) {
+            // nothing to kill if the statement finished already
+            if (entry.second.id == id && entry.second.killable) {
+                entry.second.killed = true;
+            }
+        }
+        pthread_mutex_unlock(&s_lock);
+        return 0;
+    }
+
+    if (s_lose_queries > 0) {
+        --s_lose_queries;
+        ++s_queries;
+        set_error(conn, CR_SERVER_LOST, "Lost connection to MySQL server during query");
+        pthread_mutex_unlock(&s_lock);
+        return 1;
+    }
+
+    conn.stmts.clear();
+    conn.cur = 0;
+    for (size_t pos = 0;;) {
+        size_t end = sql.find(";\n", pos);
+        conn.stmts.push_back(sql.substr(pos, end - pos));
+        if (end == std::string::npos) {
+            break;
+        }
+        pos = end + 2;
+    }
+    if (conn.stmts.size() > 1 && !conn.multi) {
+        set_error(conn, ER_PARSE_ERROR, "You have an error in your SQL syntax");
+        pthread_mutex_unlock(&s_lock);
+        return 1;
+    }
+    int ret = run_stmt(mysql);
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+int mysql_next_result(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    FakeConn& conn = s_conns[mysql];
+    int ret = -1;
+    if (conn.cur + 1 < conn.stmts.size()) {
+        ++conn.cur;
+        ret = run_stmt(mysql) == 0 ? 0 : 1;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+unsigned int mysql_field_count(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    FakeConn& conn = s_conns[mysql];
+    const std::string& stmt = conn.cur < conn.stmts.size() ? conn.stmts[conn.cur] : "";
+    unsigned int count = stmt.compare(0, 6, "SELECT") == 0 || stmt.compare(0, 4, "SHOW") == 0;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+void* mysql_store_result(void* mysql) {
+    FakeResult* result = new FakeResult;
+    pthread_mutex_lock(&s_lock);
+    s_results.insert(result);
+    ++s_stored;
+    pthread_mutex_unlock(&s_lock);
+    return result;
+}
+
+void mysql_free_result(void* result) {
+    if (result == nullptr) {
+        return;
+    }
+    pthread_mutex_lock(&s_lock);
+    bool stored = s_results.erase((const FakeResult*)result) == 1;
+    if (!stored) {
+        ++s_bad_frees;
+    }
+    pthread_mutex_unlock(&s_lock);
+    if (stored) {
+        delete (FakeResult*)result;
+    }
+}
+
+void* mysql_fetch_fields(void* result) {
+    // no field, never read
+    return result;
+}
+
+unsigned int mysql_num_fields(void* result) {
+    return 0;
+}
+
+unsigned long long mysql_num_rows(void* result) {
+    return 0;
+}
+
+char** mysql_fetch_row(void* result) {
+    return nullptr;
+}
+
+unsigned long long mysql_insert_id(void* mysql) {
+    return 7;
+}
+
+unsigned long long mysql_affected_rows(void* mysql) {
+    return 1;
+}
+
+bool mysql_autocommit(void* mysql, bool mode) {
+    return false;
+}
+
+bool mysql_commit(void* mysql) {
+    return false;
+}
+
+bool mysql_rollback(void* mysql) {
+    return false;
+}
+
+int mysql_ping(void* mysql) {
+    pthread_mutex_lock(&s_lock);
+    FakeConn& conn = s_conns[mysql];
+    ++s_pings;
+    if (s_fail_pings > 0) {
+        --s_fail_pings;
+        set_error(conn, CR_SERVER_LOST, "Lost connection to MySQL server");
+    }
+    int ret = conn.connected ? 0 : 1;
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+}
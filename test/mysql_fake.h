@@ -0,0 +1,83 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+// libmysqlclient replaced at link time, connection pool tested without a server
+//
+// Statements containing "SLOW" run until killed by KILL QUERY or 1s passed, "LATE" ones run
+// 100ms ignoring kills, "FAIL" ones fail with a syntax error, others return at once.
+// SELECT and SHOW return an empty result set. Statements joined by ";\n" are run as one
+// query only on a connection made with CLIENT_MULTI_STATEMENTS.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace rellaf {
+namespace test {
+
+class MysqlFake {
+public:
+    /**
+     * @brief forget scripted failures and counters, connections kept
+     */
+    static void reset();
+
+    /**
+     * @brief next `count` connects fail
+     */
+    static void fail_connects(int count);
+
+    /**
+     * @brief next `count` statements lose the connection, as the server gone
+     */
+    static void lose_queries(int count);
+
+    /**
+     * @brief next `count` pings fail
+     */
+    static void fail_pings(int count);
+
+    // connects tried
+    static int connects();
+
+    // connected and not closed yet
+    static int open_conns();
+
+    // statements run, KILL QUERY excluded
+    static int queries();
+
+    // KILL QUERY received
+    static int kills();
+
+    static int pings();
+
+    // result sets stored, and not freed yet
+    static int stored_results();
+
+    static int open_results();
+
+    // results freed twice or never stored
+    static int bad_frees();
+
+    /**
+     * @return us of monotonic clock of each connect tried since `reset`
+     */
+    static std::vector<uint64_t> connect_times();
+};
+
+}
+}
@@ -0,0 +1,371 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include "model.h"
+#include "model_binary.h"
+
+namespace rellaf {
+namespace test {
+
+class TestBinary : public testing::Test {
+protected:
+    TestBinary() = default;
+
+    ~TestBinary() override = default;
+
+    void SetUp() override {}
+};
+
+class Empty : public Object {
+rellaf_model_dcl(Empty);
+};
+
+rellaf_model_def(Empty);
+
+class Item : public Object {
+rellaf_model_dcl(Item);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_str(name, "");
+};
+
+rellaf_model_def(Item);
+
+class All : public Object {
+rellaf_model_dcl(All);
+
+rellaf_model_def_char(c, 'a');
+rellaf_model_def_int16(i16, 0);
+rellaf_model_def_int(i, 0);
+rellaf_model_def_int64(i64, 0);
+rellaf_model_def_uint16(u16, 0);
+rellaf_model_def_uint32(u32, 0);
+rellaf_model_def_uint64(u64, 0);
+rellaf_model_def_bool(b, false);
+rellaf_model_def_float(f, 0);
+rellaf_model_def_double(d, 0);
+rellaf_model_def_str(s, "");
+rellaf_model_def_list(ints, Plain<int>);
+rellaf_model_def_list(items, Item);
+rellaf_model_def_object(item, Item);
+rellaf_model_def_object(empty, Empty);
+rellaf_model_def_object(any, Model);
+};
+
+rellaf_model_def(All);
+
+class Nest : public Object {
+rellaf_model_dcl(Nest);
+
+rellaf_model_def_int(level, 0);
+rellaf_model_def_object(next, Nest);
+};
+
+rellaf_model_def(Nest);
+
+static void fill(All& all) {
+    all.set_c('z');
+    all.set_i16(-12345);
+    all.set_i(-1);
+    all.set_i64(INT64_MIN);
+    all.set_u16(65535);
+    all.set_u32(4000000000U);
+    all.set_u64(UINT64_MAX);
+    all.set_b(true);
+    all.set_f(3.25f);
+    all.set_d(-1.0e300);
+    all.set_s(std::string(300, 'x') + std::string("\0\x80\xff", 3));
+
+    for (int i = -2; i < 200; ++i) {
+        all.ints().push_back(Plain<int>(i * 1000));
+    }
+    Item item;
+    item.set_id(1);
+    item.set_name("first");
+    all.items().push_back(item);
+    all.items().emplace_back(nullptr);
+    item.set_id(2);
+    item.set_name("");
+    all.items().push_back(item);
+
+    item.set_id(3);
+    item.set_name("member");
+    all.set_item(&item);
+    Empty empty;
+    all.set_empty(&empty);
+}
+
+TEST_F(TestBinary, test_plain) {
+    Plain<int64_t> val(-300);
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&val, buf));
+    ASSERT_EQ(buf.size(), 2u);
+
+    Plain<int64_t> decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.value(), -300);
+
+    Plain<std::string> str("hello");
+    buf.clear();
+    ASSERT_TRUE(model_to_binary(&str, buf));
+    Plain<std::string> str_decoded;
+    ASSERT_TRUE(binary_to_model(buf, &str_decoded));
+    ASSERT_EQ(str_decoded.value(), "hello");
+
+    // trailing bytes
+    buf += 'x';
+    ASSERT_FALSE(binary_to_model(buf, &str_decoded));
+}
+
+TEST_F(TestBinary, test_empty) {
+    Empty empty;
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&empty, buf));
+    ASSERT_TRUE(buf.empty());
+
+    Empty decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+}
+
+TEST_F(TestBinary, test_round_trip) {
+    All all;
+    fill(all);
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&all, buf));
+
+    All decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.debug_str(), all.debug_str());
+    ASSERT_EQ(decoded.c(), 'z');
+    ASSERT_EQ(decoded.i64(), INT64_MIN);
+    ASSERT_EQ(decoded.u64(), UINT64_MAX);
+    ASSERT_EQ(decoded.f(), 3.25f);
+    ASSERT_EQ(decoded.d(), -1.0e300);
+    ASSERT_EQ(decoded.s(), all.s());
+    ASSERT_EQ(decoded.ints().size(), 202u);
+    ASSERT_EQ(decoded.ints().at<Plain<int>>(0)->value(), -2000);
+    ASSERT_EQ(decoded.items().size(), 3u);
+    ASSERT_EQ(decoded.items().at<Item>(0)->name(), "first");
+    ASSERT_EQ(decoded.items().at(1), nullptr);
+    ASSERT_EQ(decoded.items().at<Item>(2)->id(), 2);
+    ASSERT_NE(decoded.item(), nullptr);
+    ASSERT_EQ(decoded.item()->name(), "member");
+    ASSERT_NE(decoded.empty(), nullptr);
+    ASSERT_EQ(decoded.any(), nullptr);
+
+    // encoding is stable
+    std::string again;
+    ASSERT_TRUE(model_to_binary(&decoded, again));
+    ASSERT_EQ(again, buf);
+
+    // decode into a used one, members overwritten, nulls reset
+    All empty_all;
+    std::string empty_buf;
+    ASSERT_TRUE(model_to_binary(&empty_all, empty_buf));
+    ASSERT_TRUE(binary_to_model(empty_buf, &decoded));
+    ASSERT_EQ(decoded.debug_str(), empty_all.debug_str());
+    ASSERT_EQ(decoded.item(), nullptr);
+    ASSERT_TRUE(decoded.items().empty());
+}
+
+TEST_F(TestBinary, test_list) {
+    List list;
+    for (int i = 0; i < 10; ++i) {
+        list.push_back(Plain<std::string>(std::to_string(i)));
+    }
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&list, buf));
+
+    // standalone list decodes by the type of existing items
+    List decoded;
+    decoded.push_back(Plain<std::string>());
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.size(), 10u);
+    ASSERT_EQ(decoded.at<Plain<std::string>>(9)->value(), "9");
+
+    List unknown;
+    ASSERT_FALSE(binary_to_model(buf, &unknown));
+}
+
+TEST_F(TestBinary, test_nest) {
+    Nest root;
+    Nest* cur = &root;
+    for (int i = 1; i < 10; ++i) {
+        Nest next;
+        next.set_level(i);
+        cur->set_next(&next);
+        cur = cur->next();
+    }
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&root, buf));
+    Nest decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.debug_str(), root.debug_str());
+
+    // too deep
+    for (int i = 10; i < 100; ++i) {
+        Nest next;
+        next.set_level(i);
+        cur->set_next(&next);
+        cur = cur->next();
+    }
+    buf.clear();
+    ASSERT_FALSE(model_to_binary(&root, buf));
+}
+
+TEST_F(TestBinary, test_unknown_field) {
+    Item item;
+    item.set_id(7);
+    item.set_name("seven");
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&item, buf));
+    // field id 10 of every wire type
+    buf += (char)((10 << 3) | 0);
+    buf += (char)0x96;
+    buf += (char)0x01;
+    buf += (char)((10 << 3) | 1);
+    buf += std::string(8, 'a');
+    buf += (char)((10 << 3) | 2);
+    buf += (char)3;
+    buf += "abc";
+    buf += (char)((10 << 3) | 5);
+    buf += std::string(4, 'b');
+
+    Item decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.id(), 7);
+    ASSERT_EQ(decoded.name(), "seven");
+
+    // unknown wire type
+    buf += (char)((10 << 3) | 3);
+    ASSERT_FALSE(binary_to_model(buf, &decoded));
+
+    // truncated
+    std::string truncated;
+    ASSERT_TRUE(model_to_binary(&item, truncated));
+    truncated.resize(truncated.size() - 1);
+    ASSERT_FALSE(binary_to_model(truncated, &decoded));
+}
+
+// two versions of one class, `name` removed, `age`, `tags` and `owner` added
+class ItemV2 : public Object {
+rellaf_model_dcl(ItemV2);
+
+rellaf_model_def_int(age, 18);
+rellaf_model_def_int(id, 0);
+rellaf_model_def_list(tags, Plain<std::string>);
+rellaf_model_def_object(owner, Item);
+};
+
+rellaf_model_def(ItemV2);
+
+// `name` changed to int
+class ItemV3 : public Object {
+rellaf_model_dcl(ItemV3);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_int(name, 0);
+};
+
+rellaf_model_def(ItemV3);
+
+TEST_F(TestBinary, test_versions) {
+    Item item;
+    item.set_id(7);
+    item.set_name("seven");
+    std::string buf;
+    ASSERT_TRUE(model_to_binary(&item, buf));
+
+    ItemV2 v2;
+    ASSERT_TRUE(binary_to_model(buf, &v2));
+    ASSERT_EQ(v2.id(), 7);
+    ASSERT_EQ(v2.age(), 18);
+    ASSERT_TRUE(v2.tags().empty());
+    ASSERT_EQ(v2.owner(), nullptr);
+
+    v2.set_age(30);
+    v2.tags().push_back(Plain<std::string>("a"));
+    Item owner;
+    owner.set_name("owner");
+    v2.set_owner(&owner);
+    v2.set_id(8);
+    buf.clear();
+    ASSERT_TRUE(model_to_binary(&v2, buf));
+
+    // added ones skipped, removed one kept
+    Item v1;
+    v1.set_name("old");
+    ASSERT_TRUE(binary_to_model(buf, &v1));
+    ASSERT_EQ(v1.id(), 8);
+    ASSERT_EQ(v1.name(), "old");
+
+    ItemV2 decoded;
+    ASSERT_TRUE(binary_to_model(buf, &decoded));
+    ASSERT_EQ(decoded.debug_str(), v2.debug_str());
+
+    // wire type changed
+    buf.clear();
+    ASSERT_TRUE(model_to_binary(&item, buf));
+    ItemV3 v3;
+    ASSERT_FALSE(binary_to_model(buf, &v3));
+}
+
+TEST_F(TestBinary, test_fuzz) {
+    All all;
+    fill(all);
+    std::string valid;
+    ASSERT_TRUE(model_to_binary(&all, valid));
+
+    unsigned int seed = 20181024;
+    for (int round = 0; round < 20000; ++round) {
+        std::string buf;
+        if (round % 2 == 0) {
+            // random bytes
+            size_t len = (size_t)(rand_r(&seed) % 64);
+            for (size_t i = 0; i < len; ++i) {
+                buf += (char)(rand_r(&seed) & 0xFF);
+            }
+        } else {
+            // mutated valid one
+            buf = valid;
+            int count = rand_r(&seed) % 4 + 1;
+            for (int i = 0; i < count; ++i) {
+                size_t pos = (size_t)rand_r(&seed) % buf.size();
+                buf[pos] = (char)(rand_r(&seed) & 0xFF);
+            }
+            if (rand_r(&seed) % 4 == 0) {
+                buf.resize((size_t)rand_r(&seed) % buf.size());
+            }
+        }
+        All decoded;
+        // MUST not crash, result does not matter
+        binary_to_model(buf, &decoded);
+
+        Nest nest;
+        binary_to_model(buf, &nest);
+    }
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
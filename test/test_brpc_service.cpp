@@ -680,6 +680,7 @@ rellaf_brpc_http_dcl(TestSerivceImpl, TestRequest, TestResponse);
 rellaf_brpc_http_def_post(hi1, "/hi1", hi1, HelloRet, Params, Vars, HelloRequest);
 
 rellaf_brpc_http_def_post_body(hi2, "/hi2", hi2, HelloRet, HelloRequest);
+rellaf_brpc_http_lazy_body(hi2, hi2);
 
 rellaf_brpc_http_def_post_param(hi3, "/hi3", hi3, HelloRet, HelloRequest);
 
@@ -715,10 +716,36 @@ rellaf_brpc_http_def_get_pathvar(hi10, "/hi10", hi10, HelloRet, HelloRequest) {
         return ret;
     }
 
+rellaf_brpc_http_def_get_param(hi11, "/hi11", hi11, HelloRet, HelloRequest) {
+        HelloRet ret;
+        ret.set_status(p.id() * 1000 + RELLAF_ATOMIC_INC(_hi11_count));
+        return ret;
+    }
+
+rellaf_brpc_http_cache_get(hi11, hi11, 60000, 1024 * 1024);
+
+// bound fields are dirty, as `rellaf_sql_update_dirty` expects
+rellaf_brpc_http_def_get_param(hi12, "/hi12", hi12, HelloRet, HelloRequest) {
+        HelloRet ret;
+        ret.set_status(p.is_dirty("id") * 10 + p.is_dirty("name"));
+        return ret;
+    }
+
+rellaf_brpc_http_def_get_pathvar(hi13, "/hi13/{id}", hi13, HelloRet, HelloRequest) {
+        HelloRet ret;
+        ret.set_status(v.id() * 10 + v.is_dirty("id"));
+        return ret;
+    }
+
+public:
+    static volatile int _hi11_count;
+
 };
 
 rellaf_brpc_http_def(TestSerivceImpl);
 
+volatile int TestSerivceImpl::_hi11_count = 0;
+
 HelloRet TestSerivceImpl::hi1(HttpContext& context, const Params& params, const Vars& vars,
         const HelloRequest& request) {
     HelloRet ret;
@@ -764,6 +791,152 @@ TEST_F(TestBrpcService, echo_service) {
     http_test_st_body_item("", 200, "111", false);
 }
 
+TEST_F(TestBrpcService, http_client) {
+    HttpClientOptions options;
+    options.connection_type = brpc::CONNECTION_TYPE_SINGLE;
+    options.timeout_ms = 500;
+    HttpClient client(options);
+
+    for (int i = 0; i < 3; ++i) {
+        HttpResponse response;
+        client.post("127.0.0.1:8123/hi2", {}, "{}", response);
+        ASSERT_EQ(response.status, 200);
+        client.get("http://127.0.0.1:8123/hi9", {{"id", "1"}}, response);
+        ASSERT_EQ(response.status, 200);
+    }
+    // same host and port share one channel
+    ASSERT_EQ(client.channel_count(), 1u);
+
+    HttpResponse response;
+    ASSERT_EQ(client.get("", {}, response), -1);
+    ASSERT_EQ(client.channel_count(), 1u);
+}
+
+TEST_F(TestBrpcService, http_client_model) {
+    HttpClient client;
+
+    HelloRequest request;
+    request.set_id(1);
+    request.set_name("rellaf");
+    HelloRet ret;
+    ret.set_status(0);
+    HttpResponse response;
+    ASSERT_EQ(client.post("127.0.0.1:8123/hi2", {}, &request, &ret, response), 0);
+    ASSERT_EQ(response.status, 200);
+    ASSERT_EQ(ret.status(), 200);
+
+    ret.set_status(0);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi9", {{"id", "1"}}, &ret, response), 0);
+    ASSERT_EQ(ret.status(), 200);
+}
+
+TEST_F(TestBrpcService, http_client_batch) {
+    HttpClient client;
+
+    std::vector<HttpRequest> requests(5);
+    for (auto& request : requests) {
+        request.api = "127.0.0.1:8123/hi9";
+    }
+    requests[3].api = "";
+    requests[4].api = "127.0.0.1:8123/not_exist";
+
+    std::vector<HttpResponse> responses;
+    ASSERT_EQ(client.batch(requests, responses, 1000), 3);
+    ASSERT_EQ(responses.size(), requests.size());
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(responses[i].error_code, 0);
+        ASSERT_EQ(responses[i].status, 200);
+    }
+    ASSERT_NE(responses[3].error_code, 0);
+    ASSERT_EQ(responses[4].status, 404);
+
+    // first 1 of 3
+    requests.resize(3);
+    int succeeded = client.batch(requests, responses, 1000, 1);
+    ASSERT_GE(succeeded, 1);
+    ASSERT_EQ(responses.size(), 3u);
+
+    ASSERT_EQ(client.batch({}, responses), 0);
+    ASSERT_TRUE(responses.empty());
+}
+
+TEST_F(TestBrpcService, response_cache) {
+    ResponseCache* cache = FunctionMapper::instance().fetch_cache("hi11-GET-hi11");
+    ASSERT_NE(cache, nullptr);
+    ASSERT_EQ(FunctionMapper::instance().fetch_cache("hi9-GET-hi9"), nullptr);
+
+    HttpClient client;
+    HelloRet ret;
+    HttpResponse response;
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi11", {{"id", "1"}}, &ret, response), 0);
+    ASSERT_FALSE(response.body.empty());
+    int first = ret.status();
+    ASSERT_EQ(first / 1000, 1);
+    ASSERT_EQ(cache->miss_count(), 1);
+
+    // hit, handler not invoked, query params not bound are not part of key
+    ret.set_status(0);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi11", {{"id", "1"}}, &ret, response), 0);
+    ASSERT_FALSE(response.body.empty());
+    ASSERT_EQ(ret.status(), first);
+    ret.set_status(0);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi11", {{"id", "1"}, {"x", "2"}}, &ret, response), 0);
+    ASSERT_EQ(ret.status(), first);
+    ASSERT_EQ(cache->hit_count(), 2);
+    ASSERT_EQ(TestSerivceImpl::_hi11_count, 1);
+
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi11", {{"id", "2"}}, &ret, response), 0);
+    ASSERT_EQ(ret.status() / 1000, 2);
+    ASSERT_EQ(cache->miss_count(), 2);
+    ASSERT_GT(cache->bytes(), 0u);
+
+    cache->clear();
+    ASSERT_EQ(cache->bytes(), 0u);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi11", {{"id", "1"}}, &ret, response), 0);
+    ASSERT_NE(ret.status(), first);
+}
+
+TEST_F(TestBrpcService, bind_dirty) {
+    HttpClient client;
+    HelloRet ret;
+    HttpResponse response;
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi12", {{"id", "1"}}, &ret, response), 0);
+    ASSERT_EQ(ret.status(), 10);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi12", {{"name", "a"}}, &ret, response), 0);
+    ASSERT_EQ(ret.status(), 1);
+    ASSERT_EQ(client.get("127.0.0.1:8123/hi13/7", {}, &ret, response), 0);
+    ASSERT_EQ(ret.status(), 71);
+}
+
+TEST_F(TestBrpcService, phase_stats) {
+    PhaseStats::reset();
+    HttpClient client;
+    HttpResponse response;
+    // disabled, nothing recorded
+    ASSERT_EQ(client.post("127.0.0.1:8123/hi2", {}, "{}", response), 0);
+    PhaseStats::Snapshot snapshot;
+    PhaseStats::snapshot(snapshot);
+    ASSERT_EQ(snapshot.count[PhaseStats::ROUTE], 0u);
+
+    PhaseStats::set_enabled(true);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(client.post("127.0.0.1:8123/hi2", {}, "{}", response), 0);
+        ASSERT_EQ(response.status, 200);
+    }
+    PhaseStats::set_enabled(false);
+    PhaseStats::snapshot(snapshot);
+    for (int i = PhaseStats::ROUTE; i <= PhaseStats::SERIALIZE; ++i) {
+        ASSERT_EQ(snapshot.count[i], 3u);
+    }
+    ASSERT_EQ(snapshot.count[PhaseStats::DB_WAIT], 0u);
+    ASSERT_NE(PhaseStats::dump(true).find("\"handler\":{\"count\":3"), std::string::npos);
+    ASSERT_FALSE(snapshot.str().empty());
+
+    PhaseStats::reset();
+    PhaseStats::snapshot(snapshot);
+    ASSERT_EQ(snapshot.count[PhaseStats::HANDLER], 0u);
+}
+
 }
 }
 
@@ -19,8 +19,8 @@
 
 namespace rellaf {
 
-template<class K, class V>
-static bool map_keys_equal_set(const std::map<K, V>& map, const std::set<K>& set) {
+template<class Map>
+static bool map_keys_equal_set(const Map& map, const std::set<typename Map::key_type>& set) {
     if (map.size() != set.size()) {
         return false;
     }
@@ -15,6 +15,7 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <sstream>
 #include "gtest/gtest.h"
 #include "json/json.h"
 #include "model.h"
@@ -246,6 +247,131 @@ TEST_F(TestJson, test_compex) {
     ASSERT_STREQ(json_str.c_str(), json2str(json).c_str());
 }
 
+TEST_F(TestJson, test_stream_buffer) {
+    Obj obj;
+    obj.set_id(233);
+    obj.set_name("rellaf");
+
+    std::string json_str;
+    ASSERT_TRUE(model_to_json(&obj, json_str));
+    std::ostringstream os;
+    ASSERT_TRUE(model_to_json(&obj, os));
+    ASSERT_STREQ(os.str().c_str(), json_str.c_str());
+
+    // not null terminated
+    std::string buf = json_str + "garbage";
+    Obj parsed;
+    ASSERT_TRUE(json_to_model(buf.data(), json_str.size(), &parsed));
+    ASSERT_EQ(parsed.id(), 233);
+    ASSERT_EQ(parsed.name(), "rellaf");
+
+    ASSERT_TRUE(json_to_model(nullptr, 0, &parsed));
+    ASSERT_FALSE(json_to_model(buf.data(), 3, &parsed));
+}
+
+class LazyInner : public Object {
+rellaf_model_dcl(LazyInner);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_str(name, "");
+};
+
+rellaf_model_def(LazyInner);
+
+class Lazy : public Object {
+rellaf_model_dcl(Lazy);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_str(name, "dft");
+rellaf_model_def_double(score, 0);
+rellaf_model_def_bool(flag, false);
+rellaf_model_def_list(ids, Plain<int>);
+rellaf_model_def_list(inners, LazyInner);
+rellaf_model_def_object(inner, LazyInner);
+};
+
+rellaf_model_def(Lazy);
+
+TEST_F(TestJson, test_lazy) {
+    std::string body = R"({"id" : 12, "name": "a \"quoted\" name", "unknown": {"x": [1, "]"]},
+        "score": 1.5, "flag": true, "ids": [1, 2, null, 3],
+        "inners": [{"id": 1, "name": "x"}, {"id": 2}],
+        "inner": {"id": 7, "name": "in"}, "id": 13})";
+
+    Lazy lazy;
+    ASSERT_TRUE(json_to_model_lazy(body, &lazy));
+    ASSERT_TRUE(lazy.is_lazy());
+    // the last duplicated key wins
+    ASSERT_EQ(lazy.id(), 13);
+    ASSERT_EQ(lazy.name(), "a \"quoted\" name");
+    ASSERT_EQ(((Plain<double>*)lazy.get_plain("score"))->value(), 1.5);
+    ASSERT_TRUE(lazy.is_lazy());
+
+    // set before loaded, not overwritten later
+    lazy.set_flag(false);
+    ASSERT_FALSE(lazy.flag());
+
+    ASSERT_EQ(lazy.ids().size(), 4u);
+    ASSERT_EQ(lazy.ids().at<Plain<int>>(3)->value(), 3);
+    ASSERT_EQ(lazy.ids().at(2), nullptr);
+    ASSERT_EQ(lazy.inners().size(), 2u);
+    ASSERT_EQ(lazy.inners().at<LazyInner>(0)->name(), "x");
+
+    // nested object is lazy too
+    ASSERT_NE(lazy.inner(), nullptr);
+    ASSERT_TRUE(lazy.inner()->is_lazy());
+    ASSERT_EQ(lazy.inner()->id(), 7);
+    ASSERT_FALSE(lazy.is_lazy());
+    ASSERT_EQ(lazy.inner()->name(), "in");
+    ASSERT_FALSE(lazy.inner()->is_lazy());
+
+    // the same as eager except that eager one creates neither list items nor null objects
+    Lazy eager;
+    ASSERT_TRUE(json_to_model(body, &eager));
+    eager.set_flag(false);
+    eager.ids().clear();
+    lazy.ids().clear();
+    eager.inners().clear();
+    lazy.inners().clear();
+    lazy.set_inner(nullptr);
+    ASSERT_EQ(lazy.debug_str(), eager.debug_str());
+}
+
+TEST_F(TestJson, test_lazy_copy) {
+    Lazy lazy;
+    ASSERT_TRUE(json_to_model_lazy(R"({"id": 5, "inner": {"id": 6}})", &lazy));
+    Lazy copy(lazy);
+    ASSERT_FALSE(copy.is_lazy());
+    ASSERT_FALSE(lazy.is_lazy());
+    ASSERT_EQ(copy.id(), 5);
+    ASSERT_EQ(copy.inner()->id(), 6);
+    ASSERT_EQ(copy.name(), "dft");
+
+    std::string json_str;
+    ASSERT_TRUE(json_to_model_lazy(R"({"id": 8})", &lazy));
+    ASSERT_TRUE(model_to_json(&lazy, json_str));
+    Lazy parsed;
+    ASSERT_TRUE(json_to_model(json_str, &parsed));
+    ASSERT_EQ(parsed.id(), 8);
+}
+
+TEST_F(TestJson, test_lazy_malformed) {
+    Lazy lazy;
+    ASSERT_TRUE(json_to_model_lazy("", &lazy));
+    ASSERT_TRUE(json_to_model_lazy(" {} ", &lazy));
+    ASSERT_FALSE(lazy.is_lazy());
+    for (const char* body : {"[1]", "{", "{\"id\" 1}", "{\"id\": }", "{\"id\": 1,}",
+            "{\"id\": [1}", "{\"id\": \"1}", "{\"id\": 1} x", "{\"id\": {]}"}) {
+        Lazy bad;
+        ASSERT_FALSE(json_to_model_lazy(body, &bad)) << body;
+        ASSERT_FALSE(bad.is_lazy());
+    }
+    // value not validated until accessed
+    ASSERT_TRUE(json_to_model_lazy("{\"id\": 1x, \"name\": \"n\"}", &lazy));
+    ASSERT_EQ(lazy.name(), "n");
+    ASSERT_EQ(lazy.id(), 0);
+}
+
 } // namespace
 } // namespace
 
@@ -0,0 +1,214 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <unistd.h>
+#include <fstream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "log.h"
+
+namespace rellaf {
+namespace test {
+
+class TestLog : public testing::Test {
+protected:
+    TestLog() = default;
+
+    ~TestLog() override = default;
+
+    void SetUp() override {
+        _path = "test_log_" + std::to_string(getpid()) + ".log";
+        _level = Logger::level();
+    }
+
+    void TearDown() override {
+        Logger::instance().flush();
+        Logger::instance().open(LoggerOptions());
+        Logger::set_level(_level);
+        for (const char* suffix : {"", ".1", ".2", ".3"}) {
+            unlink((_path + suffix).c_str());
+        }
+    }
+
+    std::string read(const std::string& path) {
+        std::ifstream in(path);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    std::string _path;
+    int _level = 0;
+};
+
+static int count_lines(const std::string& content) {
+    int count = 0;
+    for (char c : content) {
+        count += c == '\n' ? 1 : 0;
+    }
+    return count;
+}
+
+TEST_F(TestLog, test_filter) {
+    int calls = 0;
+    auto eval = [&calls]() {
+        return ++calls;
+    };
+    Logger::set_level(RELLAF_LOG_LEVEL_ERROR);
+    FLOG(INFO) << eval();
+    FLOG(WARNING) << eval();
+    ASSERT_EQ(calls, 0);
+
+    LoggerOptions options;
+    options.path = _path;
+    ASSERT_TRUE(Logger::instance().open(options));
+    FLOG(ERROR) << eval();
+    ASSERT_EQ(calls, 1);
+
+    Logger::set_level(RELLAF_LOG_LEVEL_DEBUG);
+    FLOG(DEBUG) << eval();
+#if RELLAF_LOG_MIN_LEVEL > RELLAF_LOG_LEVEL_DEBUG
+    // compiled out
+    ASSERT_EQ(calls, 1);
+#else
+    ASSERT_EQ(calls, 2);
+#endif
+    Logger::instance().flush();
+    ASSERT_EQ(count_lines(read(_path)), calls);
+}
+
+TEST_F(TestLog, test_format) {
+    LoggerOptions options;
+    options.path = _path;
+    ASSERT_TRUE(Logger::instance().open(options));
+    Logger::set_level(RELLAF_LOG_LEVEL_INFO);
+
+    std::string str = "s";
+    FLOG(INFO) << "a" << str << ':' << 1 << -2 << (uint64_t)UINT64_MAX << INT64_MIN << 3.5 << true
+               << std::vector<int>{1, 2} << std::map<std::string, int>{{"k", 1}}
+               << std::make_pair(1, "b");
+    auto nested = []() {
+        FLOG(WARNING) << "nested";
+        return 7;
+    };
+    FLOG(ERROR) << "outer " << nested();
+    Logger::instance().flush();
+
+    std::string content = read(_path);
+    ASSERT_EQ(count_lines(content), 3);
+    ASSERT_EQ(content[0], 'I');
+    ASSERT_NE(content.find("test_log.cpp:"), std::string::npos);
+    ASSERT_NE(content.find(
+            "] as:1-218446744073709551615-92233720368547758083.51[1,2]{(k:1)}<1,b>\n"),
+            std::string::npos);
+    // nested line finished first
+    size_t nested_pos = content.find("] nested\n");
+    size_t outer_pos = content.find("] outer 7\n");
+    ASSERT_NE(nested_pos, std::string::npos);
+    ASSERT_NE(outer_pos, std::string::npos);
+    ASSERT_LT(nested_pos, outer_pos);
+    ASSERT_EQ(content[content.rfind('\n', outer_pos) + 1], 'E');
+}
+
+TEST_F(TestLog, test_rotate) {
+    LoggerOptions options;
+    options.path = _path;
+    options.rotate_bytes = 1024;
+    options.max_files = 2;
+    ASSERT_TRUE(Logger::instance().open(options));
+    Logger::set_level(RELLAF_LOG_LEVEL_INFO);
+    for (int i = 0; i < 200; ++i) {
+        FLOG(INFO) << "line " << i;
+        if (i % 10 == 0) {
+            Logger::instance().flush();
+        }
+    }
+    Logger::instance().flush();
+    ASSERT_EQ(access((_path + ".1").c_str(), F_OK), 0);
+    ASSERT_EQ(access((_path + ".2").c_str(), F_OK), 0);
+    ASSERT_EQ(access((_path + ".3").c_str(), F_OK), -1);
+    // rotated right after the last batch, or not
+    ASSERT_NE((read(_path + ".1") + read(_path)).find("] line 199\n"), std::string::npos);
+}
+
+TEST_F(TestLog, test_concurrent) {
+    LoggerOptions options;
+    options.path = _path;
+    ASSERT_TRUE(Logger::instance().open(options));
+    Logger::set_level(RELLAF_LOG_LEVEL_INFO);
+
+    const int thread_num = 4;
+    const int line_num = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < line_num; ++i) {
+                FLOG(INFO) << "thread " << t << " line " << i;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Logger::instance().flush();
+
+    std::string content = read(_path);
+    ASSERT_EQ(count_lines(content) + (int)Logger::instance().dropped(), thread_num * line_num);
+    // in order within a thread
+    size_t first = content.find("] thread 0 line 0\n");
+    size_t last = content.find("] thread 0 line " + std::to_string(line_num - 1) + "\n");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(last, std::string::npos);
+    ASSERT_LT(first, last);
+}
+
+// lines and flushes racing with exit are neither blocked nor lost
+TEST_F(TestLog, test_exit) {
+    // re-executed in a child with a fresh logger, pid differs there
+    testing::GTEST_FLAG(death_test_style) = "threadsafe";
+    const char* path = "test_log_exit.log";
+    ASSERT_EXIT({
+        // killed by SIGALRM if hung
+        alarm(10);
+        LoggerOptions options;
+        options.path = path;
+        Logger::instance().open(options);
+        Logger::set_level(RELLAF_LOG_LEVEL_INFO);
+        for (int t = 0; t < 4; ++t) {
+            std::thread([]() {
+                for (int i = 0;; ++i) {
+                    FLOG(INFO) << "exit " << i;
+                    if (i % 16 == 0) {
+                        Logger::instance().flush();
+                    }
+                }
+            }).detach();
+        }
+        usleep(20000);
+        FLOG(INFO) << "exiting";
+        exit(0);
+    }, testing::ExitedWithCode(0), "");
+    std::string content = read(path);
+    unlink(path);
+    ASSERT_NE(content.find("] exiting\n"), std::string::npos);
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -17,10 +17,14 @@
 // TODO... valgrind mem check
 // TODO... split file, static connect check
 
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "gtest/gtest.h"
 #include "test_common.h"
 #include "common.h"
 #include "model.h"
+#include "field_binder.h"
 
 namespace rellaf {
 namespace test {
@@ -429,6 +433,219 @@ TEST_F(TestModel, test_plain) {
     }
 }
 
+TEST_F(TestModel, test_field_binder) {
+    const FieldBinder& binder = FieldBinder::of<Obj>();
+    ASSERT_EQ(binder.size(), Obj::plain_names().size());
+    ASSERT_EQ(&binder, &FieldBinder::of<Obj>());
+    ASSERT_TRUE(FieldBinder::of<Void>().empty());
+    ASSERT_TRUE(FieldBinder::of<Plain<int>>().empty());
+
+    Obj object;
+    for (auto& entry : object.get_plains()) {
+        ASSERT_EQ(binder.field(&object, entry.first), entry.second);
+    }
+    ASSERT_EQ(binder.field(&object, "not_exist"), nullptr);
+    ASSERT_EQ(binder.field(&object, ""), nullptr);
+    ASSERT_EQ(binder.field(&object, "val_in", 6), nullptr);
+
+    ASSERT_TRUE(binder.set_plain(&object, "val_int", "-222"));
+    ASSERT_TRUE(binder.set_plain(&object, "val_uint64", "222"));
+    ASSERT_TRUE(binder.set_plain(&object, "val_str", "bbb"));
+    ASSERT_FALSE(binder.set_plain(&object, "not_exist", "1"));
+    ASSERT_TRUE(object.is_dirty("val_int"));
+    ASSERT_TRUE(object.is_dirty("val_str"));
+    ASSERT_FALSE(object.is_dirty("val_int16"));
+    ASSERT_EQ(object.val_int(), -222);
+    ASSERT_EQ(object.val_uint64(), 222);
+    ASSERT_EQ(object.val_str(), "bbb");
+    ASSERT_EQ(object.val_int16(), -111);
+
+    // another instance of same class
+    Obj other;
+    ASSERT_TRUE(binder.set_plain(&other, "val_double", "2.5"));
+    ASSERT_DOUBLE_EQ(other.val_double(), 2.5);
+    ASSERT_DOUBLE_EQ(object.val_double(), 1.0001);
+}
+
+TEST_F(TestModel, test_share) {
+    Obj object;
+    SubModel sub;
+    object.set_val_object(&sub);
+    SubObj item;
+    object.val_list().push_back(item);
+    object.val_list().push_back(item);
+
+    // copy shares subtrees
+    Obj copy(object);
+    const Obj& const_object = object;
+    const Obj& const_copy = copy;
+    ASSERT_EQ(const_copy.val_object(), const_object.val_object());
+    ASSERT_EQ(const_copy.val_list().at(0), const_object.val_list().at(0));
+
+    // mutation detaches
+    copy.val_object()->set_sub_model_id(222);
+    ASSERT_NE(const_copy.val_object(), const_object.val_object());
+    ASSERT_EQ(const_object.val_object()->sub_model_id(), 111);
+    copy.val_list().at<SubObj>(1)->set_list_id(222);
+    ASSERT_EQ(const_copy.val_list().at(0), const_object.val_list().at(0));
+    ASSERT_NE(const_copy.val_list().at(1), const_object.val_list().at(1));
+    ASSERT_EQ(object.val_list().at<SubObj>(1)->list_id(), 111);
+    copy.val_list().pop_back();
+    ASSERT_EQ(copy.val_list().size(), 1u);
+    ASSERT_EQ(object.val_list().size(), 2u);
+
+    // shared from cached
+    std::shared_ptr<SubModel> cached = std::make_shared<SubModel>();
+    cached->set_sub_model_id(333);
+    copy.set_val_object(std::shared_ptr<const SubModel>(cached));
+    ASSERT_EQ(const_copy.val_object(), cached.get());
+    ASSERT_EQ(const_copy.val_object_shared().get(), cached.get());
+    copy.val_object()->set_sub_model_id(444);
+    ASSERT_EQ(cached->sub_model_id(), 333);
+    copy.val_list().push_back(std::shared_ptr<const Model>(cached));
+    ASSERT_EQ(const_copy.val_list().at(1), cached.get());
+    object.val_list().push_back(copy.val_list().share(0));
+    ASSERT_EQ(const_object.val_list().at(2), const_copy.val_list().at(0));
+
+    // read only through const views, detached through non-const ones
+    Obj shared(object);
+    const Obj& const_shared = shared;
+    ASSERT_EQ(const_shared.get_objects().find("val_object")->second, const_object.val_object());
+    for (const Model* m : const_shared.val_list()) {
+        ASSERT_EQ(m, const_object.val_list().at(0));
+        break;
+    }
+    Object* detached = shared.get_objects().find("val_object")->second;
+    ASSERT_NE(detached, const_object.val_object());
+    ((SubModel*)detached)->set_sub_model_id(555);
+    ASSERT_EQ(const_object.val_object()->sub_model_id(), 111);
+    for (Model* m : shared.val_list()) {
+        ((SubObj*)m)->set_list_id(555);
+    }
+    ASSERT_EQ(const_object.val_list().at<SubObj>(0)->list_id(), 111);
+    ASSERT_EQ(const_shared.val_list().at<SubObj>(2)->list_id(), 555);
+
+    // move
+    Obj moved;
+    moved = std::move(copy);
+    ASSERT_EQ(moved.val_object()->sub_model_id(), 444);
+    ASSERT_EQ(moved.val_list().size(), 2u);
+    ASSERT_EQ(copy.val_object(), nullptr);
+    ASSERT_TRUE(copy.val_list().empty());
+}
+
+// ten int members named `_p_`0 to `_p_`9
+#define DEF_TEN_INT(_p_)                                                                   \
+rellaf_model_def_int(_p_##0, 0); rellaf_model_def_int(_p_##1, 0);                         \
+rellaf_model_def_int(_p_##2, 0); rellaf_model_def_int(_p_##3, 0);                         \
+rellaf_model_def_int(_p_##4, 0); rellaf_model_def_int(_p_##5, 0);                         \
+rellaf_model_def_int(_p_##6, 0); rellaf_model_def_int(_p_##7, 0);                         \
+rellaf_model_def_int(_p_##8, 0); rellaf_model_def_int(_p_##9, 0)
+
+// more plain members than one word of dirty flags
+class WideObj : public Object {
+rellaf_model_dcl(WideObj);
+
+DEF_TEN_INT(a);
+DEF_TEN_INT(b);
+DEF_TEN_INT(c);
+DEF_TEN_INT(d);
+DEF_TEN_INT(e);
+DEF_TEN_INT(f);
+DEF_TEN_INT(g);
+};
+
+rellaf_model_def(WideObj);
+
+TEST_F(TestModel, test_dirty) {
+    Obj obj;
+    ASSERT_FALSE(obj.has_dirty());
+    obj.set_val_int(1);
+    obj.set_plain("val_str", "bbb");
+    ASSERT_TRUE(obj.has_dirty());
+    ASSERT_TRUE(obj.is_dirty("val_int"));
+    ASSERT_TRUE(obj.is_dirty("val_str"));
+    ASSERT_FALSE(obj.is_dirty("val_int64"));
+    ASSERT_FALSE(obj.is_dirty("val_list"));
+    ASSERT_FALSE(obj.is_dirty("none"));
+    ASSERT_TRUE(obj.is_dirty((size_t)obj.rellaf_meta().plain_index("val_int")));
+
+    // copied with values
+    Obj copy = obj;
+    ASSERT_TRUE(copy.is_dirty("val_int"));
+    copy.clear_dirty();
+    ASSERT_FALSE(copy.has_dirty());
+    ASSERT_EQ(copy.val_int(), 1);
+    ASSERT_TRUE(obj.has_dirty());
+    obj.clear();
+    ASSERT_FALSE(obj.has_dirty());
+
+    WideObj wide;
+    wide.set_g9(1);
+    wide.set_a0(1);
+    ASSERT_TRUE(wide.is_dirty("g9"));
+    ASSERT_TRUE(wide.is_dirty("a0"));
+    ASSERT_FALSE(wide.is_dirty("g8"));
+    ASSERT_FALSE(wide.is_dirty((size_t)1000));
+    wide.set_a0(0);
+    wide.clear_dirty();
+    wide.set_g8(1);
+    ASSERT_TRUE(wide.has_dirty());
+    ASSERT_FALSE(wide.is_dirty("a0"));
+    WideObj wide_copy(wide);
+    ASSERT_TRUE(wide_copy.is_dirty("g8"));
+}
+
+// used by test_concurrent only, so members are recorded while threads racing
+class RaceObj : public Object {
+rellaf_model_dcl(RaceObj);
+
+rellaf_model_def_int(id, 7);
+rellaf_model_def_str(name, "race");
+rellaf_model_def_list(items, SubObj);
+rellaf_model_def_object(sub, SubModel);
+};
+
+rellaf_model_def(RaceObj);
+
+TEST_F(TestModel, test_concurrent) {
+    const int thread_num = 8;
+    std::atomic<bool> start(false);
+    std::atomic<int> failed(0);
+    std::vector<const ModelMeta*> metas(thread_num, nullptr);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; ++i) {
+        threads.emplace_back([&, i]() {
+            while (!start.load()) {
+            }
+            for (int j = 0; j < 1000; ++j) {
+                RaceObj obj;
+                std::unique_ptr<Object> sub(obj.create_object("sub"));
+                if (!obj.set_plain("id", std::to_string(j)) || obj.id() != j ||
+                        obj.get_plains().size() != 2 || !obj.is_list_member("items") ||
+                        sub == nullptr || obj.name_default() != "race") {
+                    ++failed;
+                }
+                SubObj item;
+                obj.items().push_back(item);
+                RaceObj copy(obj);
+                if (copy.items().size() != 1) {
+                    ++failed;
+                }
+            }
+            metas[i] = &RaceObj::rellaf_class_meta();
+        });
+    }
+    start = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(failed.load(), 0);
+    for (const ModelMeta* meta : metas) {
+        ASSERT_EQ(meta, metas[0]);
+    }
+}
+
 }
 }
 
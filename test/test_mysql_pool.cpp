@@ -0,0 +1,324 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+#include <unistd.h>
+#include <functional>
+#include <memory>
+#include <thread>
+#include "gtest/gtest.h"
+#include "mysql/fqueue.hpp"
+#include "mysql/mysql_simple_pool.h"
+#include "sql_deadline.h"
+#include "mysql_fake.h"
+
+namespace rellaf {
+namespace test {
+
+class TestMysqlPool : public testing::Test {
+protected:
+    TestMysqlPool() = default;
+
+    ~TestMysqlPool() override = default;
+
+    void SetUp() override {
+        MysqlFake::reset();
+    }
+
+    /**
+     * @brief connect `pool` to the fake, wait all connections and the killer's made
+     */
+    bool connect(MysqlSimplePool& pool, const MysqlPoolOptions& options) {
+        if (!pool.connect("127.0.0.1", 3306, "rellaf", "rellaf", "rellaf", "utf8", options)) {
+            return false;
+        }
+        int conns = (int)options.min_conns + 1;
+        bool ok = wait_for([conns]() {
+            return MysqlFake::open_conns() == conns;
+        });
+        MysqlFake::reset();
+        return ok;
+    }
+
+    static bool wait_for(const std::function<bool()>& cond, int timeout_ms = 2000) {
+        for (int i = 0; i < timeout_ms; ++i) {
+            if (cond()) {
+                return true;
+            }
+            usleep(1000);
+        }
+        return cond();
+    }
+};
+
+TEST_F(TestMysqlPool, test_pipelinable) {
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("SELECT a FROM t WHERE id=1"));
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("select a from t"));
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("INSERT INTO t(a) VALUES (1)"));
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("update t SET a=1"));
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("DELETE FROM t"));
+    ASSERT_TRUE(MysqlSimplePool::pipelinable("REPLACE INTO t(a) VALUES (1)"));
+
+    // more than one statement, or not a plain statement
+    ASSERT_FALSE(MysqlSimplePool::pipelinable("SELECT 1; SELECT 2"));
+    ASSERT_FALSE(MysqlSimplePool::pipelinable("SELECT a FROM t WHERE b=';'"));
+    ASSERT_FALSE(MysqlSimplePool::pipelinable("BEGIN"));
+    ASSERT_FALSE(MysqlSimplePool::pipelinable("SHOW SLAVE STATUS"));
+    ASSERT_FALSE(MysqlSimplePool::pipelinable("SET autocommit=0"));
+    ASSERT_FALSE(MysqlSimplePool::pipelinable(""));
+}
+
+TEST_F(TestMysqlPool, test_try_pop_block) {
+    Queue<int> queue(0, true);
+    ListNode<int>* node = nullptr;
+    ASSERT_EQ(queue.try_pop_block(nullptr), -1);
+    ASSERT_EQ(queue.try_pop_block(&node), 1);
+    ASSERT_EQ(node, nullptr);
+
+    ASSERT_EQ(queue.add_block(1), 0);
+    ASSERT_EQ(queue.add_block(2), 0);
+    ASSERT_EQ(queue.try_pop_block(&node), 0);
+    ASSERT_NE(node, nullptr);
+    ASSERT_EQ(node->_data, 1);
+    delete node;
+    ASSERT_EQ(queue.size(), 1u);
+    ASSERT_EQ(queue.try_pop_block(&node), 0);
+    ASSERT_EQ(node->_data, 2);
+    delete node;
+    ASSERT_EQ(queue.try_pop_block(&node), 1);
+
+    // frees a slot of a full queue
+    Queue<int> bounded(1, true);
+    ASSERT_EQ(bounded.add_block(1), 0);
+    ASSERT_EQ(bounded.add_block(2, 10), 1);
+    std::thread adder([&]() {
+        ASSERT_EQ(bounded.add_block(3), 0);
+    });
+    usleep(10000);
+    ASSERT_EQ(bounded.try_pop_block(&node), 0);
+    ASSERT_EQ(node->_data, 1);
+    delete node;
+    adder.join();
+    ASSERT_EQ(bounded.try_pop_block(&node), 0);
+    ASSERT_EQ(node->_data, 3);
+    delete node;
+}
+
+TEST_F(TestMysqlPool, test_deadline_in_queue) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 1;
+    options.max_conns = 1;
+    ASSERT_TRUE(connect(pool, options));
+
+    // passed before queued
+    {
+        SqlDeadline deadline(1);
+        usleep(2000);
+        ASSERT_EQ(pool.select("SELECT 1"), nullptr);
+    }
+    ASSERT_EQ(pool.stats().timeouts, 1u);
+
+    // the only connection busy
+    std::thread busy([&pool]() {
+        ASSERT_EQ(pool.execute("UPDATE LATE"), 1);
+    });
+    ASSERT_TRUE(wait_for([]() {
+        return MysqlFake::queries() == 1;
+    }));
+    {
+        SqlDeadline deadline(20);
+        ASSERT_EQ(pool.select("SELECT 1"), nullptr);
+    }
+    busy.join();
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().waiting == 0;
+    }));
+    usleep(10000);
+    // dropped by the connection without a round trip, nothing to kill
+    ASSERT_EQ(MysqlFake::queries(), 1);
+    ASSERT_EQ(MysqlFake::kills(), 0);
+    ASSERT_EQ(pool.stats().timeouts, 2u);
+
+    std::unique_ptr<SqlResult> res(pool.select("SELECT 1"));
+    ASSERT_NE(res, nullptr);
+    ASSERT_EQ(MysqlFake::queries(), 2);
+}
+
+TEST_F(TestMysqlPool, test_kill_on_timeout) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 1;
+    options.max_conns = 1;
+    ASSERT_TRUE(connect(pool, options));
+
+    {
+        SqlDeadline deadline(30);
+        ASSERT_EQ(pool.select("SELECT SLOW"), nullptr);
+    }
+    // interrupted long before it ends by itself
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().kills == 1 && pool.stats().active == 0;
+    }, 500));
+    ASSERT_EQ(MysqlFake::kills(), 1);
+    ASSERT_EQ(MysqlFake::open_results(), 0);
+    ASSERT_EQ(MysqlFake::bad_frees(), 0);
+    ASSERT_EQ(pool.stats().timeouts, 1u);
+
+    std::unique_ptr<SqlResult> res(pool.select("SELECT 1"));
+    ASSERT_NE(res, nullptr);
+}
+
+TEST_F(TestMysqlPool, test_late_result) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 1;
+    options.max_conns = 1;
+    ASSERT_TRUE(connect(pool, options));
+
+    {
+        SqlDeadline deadline(20);
+        ASSERT_EQ(pool.select("SELECT LATE"), nullptr);
+    }
+    // not interrupted by the kill, result set came after the caller gave up is freed
+    ASSERT_TRUE(wait_for([]() {
+        return MysqlFake::stored_results() == 1 && MysqlFake::open_results() == 0;
+    }));
+    ASSERT_EQ(MysqlFake::bad_frees(), 0);
+    ASSERT_EQ(pool.stats().timeouts, 1u);
+
+    std::unique_ptr<SqlResult> res(pool.select("SELECT 1"));
+    ASSERT_NE(res, nullptr);
+    res.reset();
+    ASSERT_EQ(MysqlFake::open_results(), 0);
+}
+
+TEST_F(TestMysqlPool, test_requeue) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 2;
+    options.max_conns = 2;
+    options.reconnect_min_ms = 10;
+    ASSERT_TRUE(connect(pool, options));
+
+    // run again by the other connection
+    MysqlFake::lose_queries(1);
+    std::unique_ptr<SqlResult> res(pool.select("SELECT 1"));
+    ASSERT_NE(res, nullptr);
+    res.reset();
+    ASSERT_EQ(MysqlFake::queries(), 2);
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().reconnects == 1 && pool.stats().broken == 0;
+    }));
+
+    // once only
+    MysqlFake::lose_queries(2);
+    ASSERT_EQ(pool.select("SELECT 1"), nullptr);
+    ASSERT_EQ(MysqlFake::queries(), 4);
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().reconnects == 3 && pool.stats().broken == 0;
+    }));
+
+    // not safe to run again
+    MysqlFake::lose_queries(1);
+    ASSERT_EQ(pool.execute("UPDATE t SET a=1"), -1);
+    ASSERT_EQ(MysqlFake::queries(), 5);
+    ASSERT_EQ(MysqlFake::open_results(), 0);
+}
+
+TEST_F(TestMysqlPool, test_ping_reconnect) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 2;
+    options.max_conns = 2;
+    options.health_check_ms = 30;
+    options.reconnect_min_ms = 20;
+    options.reconnect_max_ms = 1000;
+    ASSERT_TRUE(connect(pool, options));
+
+    // found broken by ping while idle, no request made
+    MysqlFake::fail_pings(1);
+    MysqlFake::fail_connects(3);
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().broken == 1;
+    }));
+    ASSERT_EQ(pool.stats().ping_failures, 1u);
+
+    // served by the other one meanwhile
+    {
+        SqlDeadline deadline(100);
+        std::unique_ptr<SqlResult> res(pool.select("SELECT 1"));
+        ASSERT_NE(res, nullptr);
+    }
+    ASSERT_EQ(pool.stats().broken, 1u);
+
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().reconnects == 1 && pool.stats().broken == 0;
+    }, 3000));
+    // backoff doubles from `reconnect_min_ms` on each failure
+    std::vector<uint64_t> times = MysqlFake::connect_times();
+    ASSERT_EQ(times.size(), 4u);
+    for (size_t i = 1; i < times.size(); ++i) {
+        ASSERT_GE(times[i] - times[i - 1], ((uint64_t)options.reconnect_min_ms << i) * 1000);
+    }
+    ASSERT_EQ(MysqlFake::open_conns(), 3);
+}
+
+TEST_F(TestMysqlPool, test_grow_shrink) {
+    MysqlSimplePool pool;
+    MysqlPoolOptions options;
+    options.min_conns = 1;
+    options.max_conns = 3;
+    options.grow_wait_us = 1000;
+    options.shrink_idle_ms = 100;
+    options.health_check_ms = 0;
+    options.task_queue_size = 16;
+    ASSERT_TRUE(connect(pool, options));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 6; ++i) {
+        threads.emplace_back([&pool]() {
+            ASSERT_EQ(pool.execute("UPDATE LATE"), 1);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // up to max only, some may be shrunk already
+    MysqlPoolStats stats = pool.stats();
+    ASSERT_EQ(stats.grown, 2u);
+    ASSERT_LE(stats.conns, 3u);
+    ASSERT_EQ(MysqlFake::queries(), 6);
+
+    // idle ones beyond min closed
+    ASSERT_TRUE(wait_for([&pool]() {
+        return pool.stats().conns == 1;
+    }));
+    ASSERT_EQ(pool.stats().shrunk, 2u);
+
+    // shrunk threads detached and maybe still exiting, only the left one joined
+    pool.stop();
+    ASSERT_TRUE(wait_for([]() {
+        return MysqlFake::open_conns() == 0;
+    }));
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,177 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include "gtest/gtest.h"
+#include "model.h"
+#include "brpc/pb_to_model.h"
+#include "test_model.pb.h"
+
+namespace rellaf {
+namespace test {
+
+class TestPb : public testing::Test {
+protected:
+    TestPb() = default;
+
+    ~TestPb() override = default;
+
+    void SetUp() override {}
+};
+
+class Item : public Object {
+rellaf_model_dcl(Item);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_str(name, "");
+};
+
+rellaf_model_def(Item);
+
+class Mod : public Object {
+rellaf_model_dcl(Mod);
+
+rellaf_model_def_int(id, 0);
+rellaf_model_def_int64(big, 0);
+rellaf_model_def_uint64(ubig, 0);
+rellaf_model_def_bool(flag, false);
+rellaf_model_def_float(ratio, 0);
+rellaf_model_def_double(score, 0);
+rellaf_model_def_str(name, "");
+rellaf_model_def_str(data, "");
+rellaf_model_def_int16(color, 0);
+rellaf_model_def_list(nums, Plain<int>);
+rellaf_model_def_list(tags, Plain<std::string>);
+rellaf_model_def_list(items, Item);
+rellaf_model_def_object(item, Item);
+rellaf_model_def_object(none, Item);
+rellaf_model_def_int(mismatch, 0);
+rellaf_model_def_str(model_only, "keep");
+};
+
+rellaf_model_def(Mod);
+
+TEST_F(TestPb, test_model_to_pb) {
+    Mod mod;
+    mod.set_id(-1);
+    mod.set_big(INT64_MIN);
+    mod.set_ubig(UINT64_MAX);
+    mod.set_flag(true);
+    mod.set_ratio(0.5f);
+    mod.set_score(-2.25);
+    mod.set_name("name");
+    mod.set_data(std::string("\0\1", 2));
+    mod.set_color(2);
+    mod.set_mismatch(9);
+    for (int i = 0; i < 3; ++i) {
+        mod.nums().push_back(Plain<int>(i));
+        mod.tags().push_back(Plain<std::string>(std::to_string(i)));
+    }
+    Item item;
+    item.set_id(1);
+    item.set_name("one");
+    mod.items().push_back(item);
+    mod.items().emplace_back(nullptr);
+    mod.set_item(&item);
+
+    TestModel msg;
+    msg.add_nums(100);
+    msg.set_pb_only(7);
+    ASSERT_TRUE(model_to_pb(&mod, &msg));
+    ASSERT_EQ(msg.id(), -1);
+    ASSERT_EQ(msg.big(), INT64_MIN);
+    ASSERT_EQ(msg.ubig(), UINT64_MAX);
+    ASSERT_TRUE(msg.flag());
+    ASSERT_EQ(msg.ratio(), 0.5f);
+    ASSERT_EQ(msg.score(), -2.25);
+    ASSERT_EQ(msg.name(), "name");
+    ASSERT_EQ(msg.data(), std::string("\0\1", 2));
+    ASSERT_EQ(msg.color(), GREEN);
+    ASSERT_EQ(msg.nums_size(), 3);
+    ASSERT_EQ(msg.nums(2), 2);
+    ASSERT_EQ(msg.tags(1), "1");
+    ASSERT_EQ(msg.items_size(), 2);
+    ASSERT_EQ(msg.items(0).name(), "one");
+    ASSERT_FALSE(msg.items(1).has_id());
+    ASSERT_TRUE(msg.has_item());
+    ASSERT_EQ(msg.item().id(), 1);
+    ASSERT_FALSE(msg.has_none());
+    // incompatible type skipped, unknown member untouched
+    ASSERT_FALSE(msg.has_mismatch());
+    ASSERT_EQ(msg.pb_only(), 7);
+
+    Plain<int> plain(1);
+    ASSERT_FALSE(model_to_pb(&plain, &msg));
+}
+
+TEST_F(TestPb, test_pb_to_model) {
+    TestModel msg;
+    msg.set_id(42);
+    msg.set_big(-42);
+    msg.set_ubig(42);
+    msg.set_flag(true);
+    msg.set_ratio(1.5f);
+    msg.set_score(3.5);
+    msg.set_name("pb");
+    msg.set_color(RED);
+    msg.set_mismatch("x");
+    msg.add_nums(5);
+    msg.add_nums(6);
+    msg.add_tags("a");
+    TestItem* pb_item = msg.add_items();
+    pb_item->set_id(3);
+    pb_item->set_name("three");
+    msg.mutable_item()->set_id(4);
+
+    Mod mod;
+    mod.nums().push_back(Plain<int>(100));
+    Item none;
+    mod.set_none(&none);
+    ASSERT_TRUE(pb_to_model(msg, &mod));
+    ASSERT_EQ(mod.id(), 42);
+    ASSERT_EQ(mod.big(), -42);
+    ASSERT_EQ(mod.ubig(), 42u);
+    ASSERT_TRUE(mod.flag());
+    ASSERT_EQ(mod.ratio(), 1.5f);
+    ASSERT_EQ(mod.score(), 3.5);
+    ASSERT_EQ(mod.name(), "pb");
+    ASSERT_EQ(mod.color(), RED);
+    ASSERT_EQ(mod.mismatch(), 0);
+    ASSERT_EQ(mod.model_only(), "keep");
+    ASSERT_EQ(mod.nums().size(), 2u);
+    ASSERT_EQ(mod.nums().at<Plain<int>>(1)->value(), 6);
+    ASSERT_EQ(mod.tags().at<Plain<std::string>>(0)->value(), "a");
+    ASSERT_EQ(mod.items().size(), 1u);
+    ASSERT_EQ(mod.items().at<Item>(0)->name(), "three");
+    ASSERT_NE(mod.item(), nullptr);
+    ASSERT_EQ(mod.item()->id(), 4);
+    ASSERT_EQ(mod.none(), nullptr);
+
+    // round trip
+    TestModel again;
+    ASSERT_TRUE(model_to_pb(&mod, &again));
+    Mod mod2;
+    ASSERT_TRUE(pb_to_model(again, &mod2));
+    ASSERT_EQ(mod2.debug_str(), mod.debug_str());
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,219 @@
+// Copyright 2018 Fankux
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Author: Fankux (fankux@gmail.com)
+//
+
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include "gtest/gtest.h"
+#include "model.h"
+#include "model_snapshot.h"
+
+namespace rellaf {
+namespace test {
+
+class TestSnapshot : public testing::Test {
+protected:
+    TestSnapshot() = default;
+
+    ~TestSnapshot() override = default;
+
+    void SetUp() override {
+        _path = "test_snapshot_" + std::to_string(getpid()) + ".snap";
+    }
+
+    void TearDown() override {
+        unlink(_path.c_str());
+    }
+
+    std::string _path;
+};
+
+class Row : public Object {
+rellaf_model_dcl(Row);
+
+rellaf_model_def_int64(id, 0);
+rellaf_model_def_str(name, "");
+rellaf_model_def_bool(valid, false);
+rellaf_model_def_char(level, 'a');
+rellaf_model_def_uint16(port, 0);
+rellaf_model_def_float(ratio, 0);
+rellaf_model_def_double(score, 0);
+rellaf_model_def_list(tags, Plain<std::string>);
+};
+
+rellaf_model_def(Row);
+
+class Other : public Object {
+rellaf_model_dcl(Other);
+
+rellaf_model_def_int(id, 0);
+};
+
+rellaf_model_def(Other);
+
+static void fill(Row& row, int64_t i) {
+    row.set_id(i);
+    row.set_name(i % 3 == 0 ? "" : "name_" + std::to_string(i));
+    row.set_valid(i % 2 == 0);
+    row.set_level((char)('a' + i % 26));
+    row.set_port((uint16_t)(i * 7));
+    row.set_ratio(i / 4.0f);
+    row.set_score(i * 1.5);
+}
+
+TEST_F(TestSnapshot, test_write_read) {
+    const int64_t count = 10000;
+    SnapshotWriter writer;
+    Row row;
+    ASSERT_TRUE(writer.open(_path, &row));
+    for (int64_t i = 0; i < count; ++i) {
+        fill(row, i);
+        ASSERT_TRUE(writer.append(&row));
+    }
+    Other other;
+    ASSERT_FALSE(writer.append(&other));
+    ASSERT_EQ(writer.row_count(), (uint64_t)count);
+    ASSERT_TRUE(writer.finish());
+    ASSERT_EQ(access((_path + ".tmp").c_str(), F_OK), -1);
+
+    SnapshotView view;
+    ASSERT_TRUE(view.open(_path));
+    ASSERT_EQ(view.row_count(), (uint64_t)count);
+    // plain members only, in name order
+    ASSERT_EQ(view.column_count(), 7u);
+    ASSERT_EQ(view.column_name(0), "id");
+    ASSERT_EQ(view.column("tags"), -1);
+
+    int id_col = view.column("id");
+    ASSERT_GE(id_col, 0);
+    const int64_t* ids = view.values<int64_t>((size_t)id_col);
+    ASSERT_NE(ids, nullptr);
+    ASSERT_EQ(view.values<int>((size_t)id_col), nullptr);
+    int64_t sum = 0;
+    for (int64_t i = 0; i < count; ++i) {
+        sum += ids[i];
+    }
+    ASSERT_EQ(sum, count * (count - 1) / 2);
+
+    const double* scores = view.values<double>((size_t)view.column("score"));
+    ASSERT_NE(scores, nullptr);
+    ASSERT_EQ(scores[100], 150.0);
+
+    const char* data = nullptr;
+    size_t len = 0;
+    int name_col = view.column("name");
+    ASSERT_TRUE(view.str((size_t)name_col, 7, data, len));
+    ASSERT_EQ(std::string(data, len), "name_7");
+    ASSERT_TRUE(view.str((size_t)name_col, 9, data, len));
+    ASSERT_EQ(len, 0u);
+    ASSERT_FALSE(view.str((size_t)name_col, (uint64_t)count, data, len));
+    ASSERT_FALSE(view.str((size_t)id_col, 0, data, len));
+
+    for (int64_t i : {0L, 1L, 4097L, count - 1}) {
+        Row expect;
+        fill(expect, i);
+        Row got;
+        ASSERT_TRUE(view.to_model((uint64_t)i, &got));
+        ASSERT_EQ(got.debug_str(), expect.debug_str());
+    }
+    // members with the same name and type only
+    Other got;
+    ASSERT_TRUE(view.to_model(5, &got));
+    ASSERT_EQ(got.id(), 0);
+}
+
+TEST_F(TestSnapshot, test_list) {
+    List list;
+    for (int64_t i = 0; i < 100; ++i) {
+        Row row;
+        fill(row, i);
+        list.push_back(row);
+    }
+    list.emplace_back(nullptr);
+
+    SnapshotWriter writer;
+    ASSERT_TRUE(writer.open(_path, list.at<Row>(0)));
+    ASSERT_TRUE(writer.append(list));
+    ASSERT_TRUE(writer.finish());
+
+    SnapshotView view;
+    ASSERT_TRUE(view.open(_path));
+    ASSERT_EQ(view.row_count(), 100u);
+    Row got;
+    ASSERT_TRUE(view.to_model(99, &got));
+    ASSERT_EQ(got.debug_str(), list.at<Row>(99)->debug_str());
+}
+
+TEST_F(TestSnapshot, test_empty) {
+    SnapshotWriter writer;
+    Row row;
+    ASSERT_TRUE(writer.open(_path, &row));
+    ASSERT_TRUE(writer.finish());
+    ASSERT_FALSE(writer.finish());
+
+    SnapshotView view;
+    ASSERT_TRUE(view.open(_path));
+    ASSERT_EQ(view.row_count(), 0u);
+    ASSERT_FALSE(view.to_model(0, &row));
+}
+
+TEST_F(TestSnapshot, test_corrupted) {
+    SnapshotView view;
+    ASSERT_FALSE(view.open(_path));
+
+    SnapshotWriter writer;
+    Row row;
+    ASSERT_TRUE(writer.open(_path, &row));
+    for (int64_t i = 0; i < 10; ++i) {
+        fill(row, i);
+        ASSERT_TRUE(writer.append(&row));
+    }
+    ASSERT_TRUE(writer.finish());
+
+    std::string content;
+    {
+        std::ifstream in(_path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    // truncated at every length MUST be rejected or stay in bound
+    for (size_t len = 0; len < content.size(); ++len) {
+        {
+            std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+            out.write(content.data(), len);
+        }
+        if (view.open(_path)) {
+            for (uint64_t i = 0; i < view.row_count(); ++i) {
+                view.to_model(i, &row);
+            }
+        }
+    }
+    std::string bad = content;
+    bad[0] = 'X';
+    {
+        std::ofstream out(_path, std::ios::binary | std::ios::trunc);
+        out.write(bad.data(), bad.size());
+    }
+    ASSERT_FALSE(view.open(_path));
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -15,9 +15,16 @@
 // Author: Fankux (fankux@gmail.com)
 //
 
+#include <unistd.h>
+#include <thread>
 #include "gtest/gtest.h"
 #include "common.h"
 #include "sql_builder.h"
+#include "sql_memory_executor.h"
+#include "sql_rw_executor.h"
+#include "sql_scope.h"
+#include "load_runner.h"
+#include "phase_stats.h"
 
 namespace rellaf {
 namespace test {
@@ -184,6 +191,8 @@ rellaf_singleton(TestBuilder);
 
 rellaf_sql_select(select, "SELECT a, b, c FROM table WHERE cond=#{cond}", Ret);
 
+rellaf_sql_cache(select, 60000, 1024 * 1024);
+
 rellaf_sql_select(select_single, "SELECT a, b, c FROM table WHERE cond=#{a.cond}", Ret);
 
 rellaf_sql_select(select_multi,
@@ -207,10 +216,30 @@ rellaf_sql_update(update,
 rellaf_sql_delete(del,
         "DELETE FROM table WHERE a=#{a} AND b=#{b} AND c=#{c}");
 
+rellaf_sql_update_dirty(update_dirty, "table", "b=#{b}");
+
+rellaf_sql_update_dirty(update_dirty_by, "table", "a=#{a} AND b=#{b.b}");
+
 public:
     void test_split_sections(const std::string& section_str, std::deque<std::string>& sections) {
         return split_section(section_str, sections);
     }
+
+    static void test_parse_tables(const std::string& pattern, std::set<std::string>& tables) {
+        parse_tables(pattern, tables);
+    }
+};
+
+class ShardBuilder : public SqlBuilder {
+rellaf_sql_select(select, "SELECT a, b FROM user WHERE b=#{b}", Ret);
+
+rellaf_sql_cache(select, 60000, 1024 * 1024);
+
+rellaf_sql_select_list(select_list, "SELECT a, b FROM user WHERE a=#{a.a} AND b=#{b.b}", Ret);
+
+rellaf_sql_insert(insert, "INSERT user(a, b) VALUES (#{a}, #{b})");
+
+rellaf_sql_update_dirty(update_dirty, "user", "b=#{b}");
 };
 
 static bool deque_equal(const std::deque<std::string>& a, const std::deque<std::string>& b) {
@@ -332,6 +361,663 @@ TEST_F(TestSqlPattern, test_sql_mapper) {
             R"(SELECT a FROM table WHERE cond='str\' cond' AND id IN ('1','2'))");
 }
 
+// every select sleeps a while then returns the same rows
+class SlowExecutor : public SqlExecutor {
+public:
+    SqlResult* select(const std::string& sql) override {
+        RELLAF_ATOMIC_INC(select_count);
+        usleep(delay_ms * 1000);
+        std::shared_ptr<SqlRows> rows = std::make_shared<SqlRows>();
+        rows->fields = {"a", "b", "c"};
+        rows->rows.push_back({"aaa", "1", "1.5"});
+        rows->rows.push_back({"bbb", "2", "2.5"});
+        return new SqlRowsResult(rows);
+    }
+
+    int execute(const std::string& sql, uint64_t& key_id) override {
+        return 0;
+    }
+
+    volatile int select_count = 0;
+    int delay_ms = 200;
+};
+
+TEST_F(TestSqlPattern, test_single_flight) {
+    Arg arg;
+    Arg argb;
+    Plain<int> id = 1;
+    argb.ids().push_back(id);
+
+    SlowExecutor executor;
+    TestBuilder& bd = TestBuilder::instance();
+    SqlBuilder::set_executor(&executor);
+    bd.set_single_flight(true);
+
+    const int thread_num = 8;
+    std::vector<std::vector<Ret>> results(thread_num);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; ++i) {
+        threads.emplace_back([&, i]() {
+            Arg a = arg;
+            Arg b = argb;
+            bd.select_list(results[i], a.tag("a"), b.tag("b"));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_LT(executor.select_count, thread_num);
+    for (auto& result : results) {
+        ASSERT_EQ(result.size(), 2u);
+        ASSERT_EQ(result[0].a(), "aaa");
+        ASSERT_EQ(result[1].b(), 2);
+        ASSERT_FLOAT_EQ(result[1].c(), 2.5);
+    }
+    // own copy of each caller
+    results[0][0].set_a("ccc");
+    ASSERT_EQ(results[1][0].a(), "aaa");
+
+    // not coalesced if not concurrent
+    int count = executor.select_count;
+    Ret ret;
+    ASSERT_EQ(bd.select(ret, id), 1);
+    ASSERT_EQ(ret.a(), "aaa");
+    ASSERT_EQ(executor.select_count, count + 1);
+
+    bd.set_single_flight(false);
+    SqlBuilder::set_executor(nullptr);
+}
+
+TEST_F(TestSqlPattern, test_parse_tables) {
+    std::set<std::string> tables;
+    TestBuilder::test_parse_tables("SELECT a FROM `Table` WHERE cond=#{cond}", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"table"}));
+
+    tables.clear();
+    TestBuilder::test_parse_tables(
+            "SELECT a FROM t1 x, db.t2 AS y LEFT JOIN t3 ON x.id=t3.id WHERE s='FROM t4'", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"t1", "db.t2", "t3"}));
+
+    tables.clear();
+    TestBuilder::test_parse_tables("INSERT INTO t1(a, b) VALUES (#{a}, #{b})", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"t1"}));
+
+    tables.clear();
+    TestBuilder::test_parse_tables("INSERT t1(a) VALUES (#{a})", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"t1"}));
+
+    tables.clear();
+    TestBuilder::test_parse_tables("UPDATE t1 SET a=#{a} WHERE id IN (#[ids])", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"t1"}));
+
+    tables.clear();
+    TestBuilder::test_parse_tables("DELETE FROM t1 WHERE a=#{a}", tables);
+    ASSERT_EQ(tables, std::set<std::string>({"t1"}));
+}
+
+TEST_F(TestSqlPattern, test_result_cache) {
+    SlowExecutor executor;
+    executor.delay_ms = 0;
+    TestBuilder& bd = TestBuilder::instance();
+    SqlBuilder::set_executor(&executor);
+
+    Plain<int> id = 11;
+    Plain<int> idb = 12;
+    Ret ret;
+    ASSERT_EQ(bd.select(ret, id), 1);
+    ASSERT_EQ(ret.a(), "aaa");
+    ASSERT_EQ(executor.select_count, 1);
+
+    Ret cached;
+    ASSERT_EQ(bd.select(cached, id), 1);
+    ASSERT_EQ(cached.a(), "aaa");
+    ASSERT_EQ(cached.b(), 1);
+    ASSERT_FLOAT_EQ(cached.c(), 1.5);
+    ASSERT_EQ(executor.select_count, 1);
+
+    ASSERT_EQ(bd.select(ret, idb), 1);
+    ASSERT_EQ(executor.select_count, 2);
+
+    // methods not cached
+    std::vector<Ret> results;
+    Arg arg;
+    Arg argb;
+    argb.ids().push_back(id);
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 2);
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 4);
+    ASSERT_EQ(executor.select_count, 4);
+
+    // writes invalidate
+    Plain<int> idc = 13;
+    ASSERT_EQ(bd.del(id.tag("a"), idb.tag("b"), idc.tag("c")), 0);
+    ASSERT_EQ(bd.select(ret, id), 1);
+    ASSERT_EQ(executor.select_count, 5);
+
+    SqlRows rows;
+    rows.fields = {"a", "b"};
+    rows.rows.push_back({"", "\x01\x80"});
+    rows.rows.push_back({std::string(300, 'x'), "2"});
+    std::string buf;
+    SqlLruCache::serialize(rows, buf);
+    SqlRows parsed;
+    ASSERT_TRUE(SqlLruCache::parse(buf, parsed));
+    ASSERT_EQ(parsed.fields, rows.fields);
+    ASSERT_EQ(parsed.rows, rows.rows);
+    SqlRows broken;
+    ASSERT_FALSE(SqlLruCache::parse(buf.substr(0, buf.size() - 1), broken));
+
+    SqlBuilder::set_executor(nullptr);
+}
+
+TEST_F(TestSqlPattern, test_update_dirty) {
+    TestBuilder& bd = TestBuilder::instance();
+    std::string sql;
+    Ret ret;
+    ret.set_b(3);
+    ASSERT_EQ(bd.update_dirty_sql(sql, ret), 0);
+    ASSERT_STREQ(sql.c_str(), R"(UPDATE table SET `b`=3 WHERE b=3)");
+
+    ret.set_a("x'y");
+    ASSERT_EQ(bd.update_dirty_sql(sql, ret), 0);
+    ASSERT_STREQ(sql.c_str(), R"(UPDATE table SET `a`='x\'y', `b`=3 WHERE b=3)");
+
+    Plain<std::string> key("k");
+    Ret cond;
+    cond.set_b(7);
+    ASSERT_EQ(bd.update_dirty_by_sql(sql, ret, key.tag("a"), cond.tag("b")), 0);
+    ASSERT_STREQ(sql.c_str(), R"(UPDATE table SET `a`='x\'y', `b`=3 WHERE a='k' AND b=7)");
+
+    // nothing dirty, nothing rendered
+    Ret clean;
+    ASSERT_EQ(bd.update_dirty_sql(sql, clean), 0);
+    ASSERT_TRUE(sql.empty());
+
+    SlowExecutor executor;
+    executor.delay_ms = 0;
+    SqlBuilder::set_executor(&executor);
+    Plain<int> id = 21;
+    ASSERT_EQ(bd.select(clean, id), 1);
+    ASSERT_FALSE(clean.has_dirty());
+    ASSERT_EQ(executor.select_count, 1);
+
+    ASSERT_EQ(bd.update_dirty(ret), 0);
+    ASSERT_FALSE(ret.has_dirty());
+    // same table, cache invalidated
+    ASSERT_EQ(bd.select(clean, id), 1);
+    ASSERT_EQ(executor.select_count, 2);
+
+    SqlBuilder::set_executor(nullptr);
+}
+
+TEST_F(TestSqlPattern, test_memory_executor) {
+    ASSERT_EQ(MemoryExecutor::table_of("SELECT a FROM `Table` WHERE a=1"), "table");
+    ASSERT_EQ(MemoryExecutor::table_of("select a from db.t1, t2"), "db.t1");
+    ASSERT_EQ(MemoryExecutor::table_of("SELECT from_a FROM\nt3"), "t3");
+    ASSERT_EQ(MemoryExecutor::table_of("UPDATE t SET a=1"), "");
+
+    MemoryExecutor executor;
+    executor.add_table("Table", {"a", "b", "c"}, 3, [](size_t idx, std::vector<std::string>& row) {
+        row.emplace_back("row" + std::to_string(idx));
+        row.emplace_back(std::to_string(idx));
+    });
+    TestBuilder& bd = TestBuilder::instance();
+    SqlBuilder::set_executor(&executor);
+
+    std::vector<Ret> results;
+    Arg arg;
+    Arg argb;
+    Plain<int> id = 31;
+    argb.ids().push_back(id);
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 3);
+    ASSERT_EQ(results[2].a(), "row2");
+    ASSERT_EQ(results[2].b(), 2);
+    ASSERT_FLOAT_EQ(results[2].c(), 0);
+    ASSERT_EQ(executor.select_count(), 1u);
+
+    uint64_t key_id = 0;
+    ASSERT_EQ(executor.execute("INSERT t1(a) VALUES (1)", key_id), 1);
+    ASSERT_EQ(key_id, 1u);
+    ASSERT_EQ(executor.execute("INSERT t1(a) VALUES (1)", key_id), 1);
+    ASSERT_EQ(key_id, 2u);
+    ASSERT_EQ(executor.select("SELECT a FROM none"), nullptr);
+
+    executor.set_select_latency(20000, 0);
+    LoadRunner runner(2, 10000, 3);
+    LoadRunner::Report report = runner.run([&](int idx) {
+        std::unique_ptr<SqlResult> res(executor.select("SELECT a FROM table"));
+        return res != nullptr && res->row_count() == 3;
+    });
+    ASSERT_EQ(report.calls, 6u);
+    ASSERT_EQ(report.errors, 0u);
+    ASSERT_GE(report.p50_us, 20000);
+    ASSERT_LT(report.seconds, 5);
+
+    SqlBuilder::set_executor(nullptr);
+}
+
+TEST_F(TestSqlPattern, test_latency_histogram) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.99), 0u);
+    for (uint64_t i = 1; i <= 100000; ++i) {
+        histogram.add(i * 10);
+    }
+    ASSERT_EQ(histogram.count(), 100000u);
+    ASSERT_EQ(histogram.min(), 10u);
+    ASSERT_EQ(histogram.max(), 1000000u);
+    for (double ratio : {0.5, 0.99, 0.999}) {
+        double expect = ratio * 1000000;
+        ASSERT_NEAR(histogram.percentile(ratio), expect, expect * 0.016);
+    }
+    ASSERT_EQ(histogram.percentile(1), 1000000u);
+
+    LatencyHistogram other;
+    other.add(5);
+    other.add(UINT64_MAX);
+    histogram.merge(other);
+    ASSERT_EQ(histogram.min(), 5u);
+    ASSERT_EQ(histogram.max(), UINT64_MAX);
+    ASSERT_EQ(histogram.percentile(0), 5u);
+}
+
+TEST_F(TestSqlPattern, test_phase_stats) {
+    MemoryExecutor executor;
+    executor.add_table("Table", {"a", "b"}, 10, [](size_t idx, std::vector<std::string>& row) {
+        row.emplace_back("row" + std::to_string(idx));
+        row.emplace_back(std::to_string(idx));
+    });
+    executor.set_select_latency(2000, 0);
+    TestBuilder& bd = TestBuilder::instance();
+    SqlBuilder::set_executor(&executor);
+
+    std::vector<Ret> results;
+    Arg arg;
+    Arg argb;
+    Plain<int> id = 31;
+    argb.ids().push_back(id);
+    PhaseStats::reset();
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 10);
+    PhaseStats::Snapshot snapshot;
+    PhaseStats::snapshot(snapshot);
+    ASSERT_EQ(snapshot.count[PhaseStats::SQL_RENDER], 0u);
+
+    PhaseStats::set_enabled(true);
+    for (int i = 0; i < 2; ++i) {
+        std::vector<Ret> fresh;
+        ASSERT_EQ(bd.select_list(fresh, arg.tag("a"), argb.tag("b")), 10);
+    }
+    PhaseStats::set_enabled(false);
+    PhaseStats::snapshot(snapshot);
+    ASSERT_EQ(snapshot.count[PhaseStats::SQL_RENDER], 2u);
+    ASSERT_EQ(snapshot.count[PhaseStats::DB_WAIT], 2u);
+    ASSERT_EQ(snapshot.count[PhaseStats::RESULT_DECODE], 2u);
+    ASSERT_EQ(snapshot.count[PhaseStats::HANDLER], 0u);
+    // sleeping costs wall time, not cpu
+    ASSERT_GE(snapshot.wall_ns[PhaseStats::DB_WAIT], 2 * 2000000u);
+    ASSERT_LT(snapshot.cpu_ns[PhaseStats::DB_WAIT], snapshot.wall_ns[PhaseStats::DB_WAIT]);
+    if (PhaseStats::alloc_tracked()) {
+        // at least growth of result vector
+        ASSERT_GE(snapshot.allocs[PhaseStats::RESULT_DECODE], 2u);
+        ASSERT_GT(snapshot.alloc_bytes[PhaseStats::RESULT_DECODE], 0u);
+    } else {
+        ASSERT_EQ(snapshot.allocs[PhaseStats::RESULT_DECODE], 0u);
+    }
+    ASSERT_NE(PhaseStats::dump().find("db_wait count=2"), std::string::npos);
+    ASSERT_NE(PhaseStats::dump(true).find(R"("result_decode":{"count":2,)"), std::string::npos);
+
+    PhaseStats::reset();
+    PhaseStats::snapshot(snapshot);
+    ASSERT_EQ(snapshot.count[PhaseStats::DB_WAIT], 0u);
+    SqlBuilder::set_executor(nullptr);
+}
+
+
+TEST_F(TestSqlPattern, test_read_write_split) {
+    ASSERT_TRUE(ReadWriteExecutor::is_replica_read("  select a FROM t"));
+    ASSERT_TRUE(ReadWriteExecutor::is_replica_read("SELECT(1)"));
+    ASSERT_FALSE(ReadWriteExecutor::is_replica_read("SELECT a FROM t WHERE id=1 FOR\nUPDATE;"));
+    ASSERT_FALSE(ReadWriteExecutor::is_replica_read("select a from t lock in share mode"));
+    ASSERT_FALSE(ReadWriteExecutor::is_replica_read("SHOW SLAVE STATUS"));
+    ASSERT_FALSE(ReadWriteExecutor::is_replica_read("UPDATE t SET a=1"));
+
+    auto generator = [](size_t idx, std::vector<std::string>& row) {
+        row.emplace_back("row" + std::to_string(idx));
+        row.emplace_back(std::to_string(idx));
+    };
+    MemoryExecutor primary;
+    MemoryExecutor replicas[2];
+    primary.add_table("Table", {"a", "b"}, 3, generator);
+    for (auto& replica : replicas) {
+        replica.add_table("Table", {"a", "b"}, 3, generator);
+    }
+    std::atomic<int64_t> lags[2];
+    lags[0] = 0;
+    lags[1] = 0;
+
+    ReadWriteOptions options;
+    options.max_lag_ms = 500;
+    options.probe_interval_ms = 0;
+    ReadWriteExecutor executor(&primary, options);
+    executor.add_replica(&replicas[0]);
+    executor.add_replica(&replicas[1]);
+    executor.set_lag_probe([&](SqlExecutor* replica) {
+        return lags[replica == &replicas[0] ? 0 : 1].load();
+    });
+    ASSERT_TRUE(executor.start());
+
+    // idle replicas take turns
+    for (int i = 0; i < 4; ++i) {
+        std::unique_ptr<SqlResult> res(executor.select("SELECT a FROM table"));
+        ASSERT_NE(res, nullptr);
+    }
+    ASSERT_EQ(replicas[0].select_count(), 2u);
+    ASSERT_EQ(replicas[1].select_count(), 2u);
+    ASSERT_EQ(primary.select_count(), 0u);
+    uint64_t key_id = 0;
+    ASSERT_EQ(executor.execute("INSERT t(a) VALUES (1)", key_id), 1);
+    ASSERT_EQ(primary.execute_count(), 1u);
+    std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table FOR UPDATE"));
+    ASSERT_EQ(primary.select_count(), 1u);
+
+    // least outstanding, replica 0 busy
+    replicas[0].set_select_latency(100000, 0);
+    std::thread slow([&]() {
+        std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table"));
+    });
+    while (replicas[0].select_count() + replicas[1].select_count() < 5) {
+        usleep(1000);
+    }
+    for (int i = 0; i < 4; ++i) {
+        std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table"));
+    }
+    slow.join();
+    replicas[0].set_select_latency(0, 0);
+    ASSERT_EQ(replicas[0].select_count() + replicas[1].select_count(), 9u);
+    ASSERT_GE(replicas[1].select_count(), 6u);
+
+    // lagging or failed replicas skipped, primary at last
+    lags[0] = 1000;
+    executor.probe();
+    ASSERT_EQ(executor.replica_lag_ms(0), 1000);
+    uint64_t count = replicas[1].select_count();
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table"));
+    }
+    ASSERT_EQ(replicas[1].select_count(), count + 3);
+    lags[1] = -1;
+    executor.probe();
+    std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table"));
+    ASSERT_EQ(primary.select_count(), 2u);
+    ASSERT_EQ(executor.primary_reads(), 2u);
+    lags[0] = 0;
+    lags[1] = 0;
+    executor.probe();
+
+    // forced by call and by builder
+    {
+        ReadWriteExecutor::ForcePrimary force;
+        std::unique_ptr<SqlResult>(executor.select("SELECT a FROM table"));
+    }
+    ASSERT_EQ(primary.select_count(), 3u);
+    TestBuilder& bd = TestBuilder::instance();
+    SqlBuilder::set_executor(&executor);
+    std::vector<Ret> results;
+    Arg arg;
+    Arg argb;
+    Plain<int> id = 31;
+    argb.ids().push_back(id);
+    bd.set_force_primary(true);
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 3);
+    ASSERT_EQ(primary.select_count(), 4u);
+    bd.set_force_primary(false);
+    results.clear();
+    ASSERT_EQ(bd.select_list(results, arg.tag("a"), argb.tag("b")), 3);
+    ASSERT_EQ(primary.select_count(), 4u);
+
+    // probing thread
+    ReadWriteOptions probing = options;
+    probing.probe_interval_ms = 10;
+    ReadWriteExecutor probed(&primary, probing);
+    probed.add_replica(&replicas[0]);
+    probed.set_lag_probe([&](SqlExecutor* replica) {
+        return lags[0].load();
+    });
+    ASSERT_TRUE(probed.start());
+    lags[0] = 2000;
+    for (int i = 0; i < 500 && probed.replica_lag_ms(0) != 2000; ++i) {
+        usleep(2000);
+    }
+    ASSERT_EQ(probed.replica_lag_ms(0), 2000);
+    probed.stop();
+
+    SqlBuilder::set_executor(nullptr);
+}
+
+// answers SHOW SLAVE STATUS like a replica, nothing else
+class ShowExecutor : public SqlExecutor {
+public:
+    SqlResult* select(const std::string& sql) override {
+        if (sql.compare(0, 4, "SHOW") != 0) {
+            return nullptr;
+        }
+        std::shared_ptr<SqlRows> rows = std::make_shared<SqlRows>();
+        rows->fields = {"Slave_IO_State", "Seconds_Behind_Master", "Last_Error"};
+        if (replica) {
+            rows->rows.push_back({"Waiting for master to send event", lag, ""});
+        }
+        return new SqlRowsResult(rows);
+    }
+
+    int execute(const std::string& sql, uint64_t& key_id) override {
+        return 0;
+    }
+
+    bool replica = true;
+    std::string lag = "3";
+};
+
+TEST_F(TestSqlPattern, test_mysql_lag_probe) {
+    ShowExecutor replica;
+    ASSERT_EQ(ReadWriteExecutor::mysql_lag_probe(&replica), 3000);
+    // replication stopped
+    replica.lag = "";
+    ASSERT_EQ(ReadWriteExecutor::mysql_lag_probe(&replica), -1);
+    replica.lag = "0";
+    ASSERT_EQ(ReadWriteExecutor::mysql_lag_probe(&replica), 0);
+    // not a replica
+    replica.replica = false;
+    ASSERT_EQ(ReadWriteExecutor::mysql_lag_probe(&replica), -1);
+    replica.replica = true;
+
+    MemoryExecutor primary;
+    ReadWriteOptions options;
+    options.probe_interval_ms = 0;
+    ReadWriteExecutor executor(&primary, options);
+    executor.add_replica(&replica);
+    executor.set_lag_probe(ReadWriteExecutor::mysql_lag_probe);
+    ASSERT_TRUE(executor.start());
+    ASSERT_EQ(executor.replica_lag_ms(0), 0);
+    replica.lag = "2";
+    executor.probe();
+    ASSERT_EQ(executor.replica_lag_ms(0), 2000);
+}
+
+
+TEST_F(TestSqlPattern, test_sharded_executor) {
+    ASSERT_EQ(ShardedExecutor::default_selector("7", 4), 3u);
+    ASSERT_EQ(ShardedExecutor::default_selector("-7", 4), 3u);
+    ASSERT_EQ(ShardedExecutor::default_selector("abc", 4),
+            ShardedExecutor::default_selector("abc", 4));
+    ASSERT_LT(ShardedExecutor::default_selector("99999999999999999999", 4), 4u);
+
+    // shard i holds i + 1 rows
+    MemoryExecutor shards[2];
+    for (size_t i = 0; i < 2; ++i) {
+        shards[i].add_table("user", {"a", "b"}, i + 1,
+                [i](size_t idx, std::vector<std::string>& row) {
+            row.emplace_back("shard" + std::to_string(i));
+            row.emplace_back(std::to_string(idx));
+        });
+    }
+    ShardedExecutor executor;
+    ASSERT_EQ(executor.shard("1"), nullptr);
+    executor.add_shard(&shards[0]);
+    executor.add_shard(&shards[1]);
+    ASSERT_EQ(executor.shard("3"), &shards[1]);
+    ASSERT_EQ(executor.select("SELECT a FROM user"), nullptr);
+    {
+        ShardedExecutor::ShardKey key("2");
+        ShardedExecutor::ShardKey inner("");
+        std::unique_ptr<SqlResult> res(executor.select("SELECT a FROM user"));
+        ASSERT_NE(res, nullptr);
+        ASSERT_EQ(res->row_count(), 1u);
+    }
+    ASSERT_EQ(ShardedExecutor::ShardKey::current(), nullptr);
+
+    // bound builders, the global executor untouched
+    MemoryExecutor global;
+    SqlBuilder::set_executor(&global);
+    ShardBuilder dao;
+    dao.bind_executor(&executor);
+    ShardBuilder other;
+    ASSERT_EQ(other.executor(), &global);
+    dao.set_shard_key("b");
+
+    Ret ret;
+    ret.set_b(3);
+    ASSERT_EQ(dao.select(ret, ret), 1);
+    ASSERT_EQ(ret.a(), "shard1");
+    ASSERT_EQ(shards[1].select_count(), 1u);
+    // cached per shard
+    ret.set_b(3);
+    ASSERT_EQ(dao.select(ret, ret), 1);
+    ASSERT_EQ(shards[1].select_count(), 1u);
+    ret.set_b(4);
+    ASSERT_EQ(dao.select(ret, ret), 1);
+    ASSERT_EQ(ret.a(), "shard0");
+    ASSERT_EQ(shards[0].select_count(), 2u);
+
+    Ret a;
+    Ret b;
+    b.set_b(5);
+    std::vector<Ret> results;
+    dao.set_shard_key("b.b");
+    ASSERT_EQ(dao.select_list(results, a.tag("a"), b.tag("b")), 2);
+    ASSERT_EQ(results[0].a(), "shard1");
+
+    dao.set_shard_key("b");
+    ASSERT_EQ(dao.insert(b), 1);
+    ASSERT_EQ(shards[1].execute_count(), 1u);
+    b.set_a("x");
+    ASSERT_EQ(dao.update_dirty(b), 1);
+    ASSERT_EQ(shards[1].execute_count(), 2u);
+    ASSERT_EQ(shards[0].execute_count(), 0u);
+
+    // no key, no shard
+    dao.set_shard_key("");
+    ASSERT_EQ(dao.insert(b), -1);
+    ASSERT_EQ(global.execute_count(), 0u);
+
+    SqlBuilder::set_executor(nullptr);
+}
+
+TEST_F(TestSqlPattern, test_sql_deadline) {
+    ASSERT_EQ(SqlDeadline::deadline_us(), 0u);
+    ASSERT_EQ(SqlDeadline::timeout_ms(0), 0u);
+    {
+        SqlDeadline outer(1000);
+        uint64_t deadline_us = SqlDeadline::deadline_us();
+        ASSERT_GT(deadline_us, SqlDeadline::now_us());
+        ASSERT_LE(SqlDeadline::timeout_ms(deadline_us), 1000u);
+        ASSERT_GE(SqlDeadline::timeout_ms(SqlDeadline::now_us()), 1u);
+        {
+            // never extends outer
+            SqlDeadline inner(5000);
+            ASSERT_EQ(SqlDeadline::deadline_us(), deadline_us);
+            SqlDeadline none(0);
+            ASSERT_EQ(SqlDeadline::deadline_us(), deadline_us);
+        }
+        {
+            SqlDeadline inner(10);
+            ASSERT_LT(SqlDeadline::deadline_us(), deadline_us);
+        }
+        ASSERT_EQ(SqlDeadline::deadline_us(), deadline_us);
+    }
+    ASSERT_EQ(SqlDeadline::deadline_us(), 0u);
+
+    MemoryExecutor executor;
+    executor.add_table("t", {"a"}, 1, [](size_t idx, std::vector<std::string>& row) {
+        row.emplace_back("a");
+    });
+    executor.set_select_latency(50000, 0);
+    {
+        SqlDeadline deadline(10);
+        uint64_t begin_us = SqlDeadline::now_us();
+        ASSERT_EQ(executor.select("SELECT a FROM t"), nullptr);
+        uint64_t cost_us = SqlDeadline::now_us() - begin_us;
+        ASSERT_GE(cost_us, 9000u);
+        ASSERT_LT(cost_us, 50000u);
+
+        // expired, fail without waiting
+        usleep(1000);
+        uint64_t key_id = 0;
+        begin_us = SqlDeadline::now_us();
+        ASSERT_EQ(executor.execute("INSERT t(a) VALUES (1)", key_id), -1);
+        ASSERT_LT(SqlDeadline::now_us() - begin_us, 5000u);
+    }
+    std::unique_ptr<SqlResult> res(executor.select("SELECT a FROM t"));
+    ASSERT_NE(res, nullptr);
+
+    // waiter of a slow flight gives up alone, the leader still gets rows
+    executor.set_select_latency(100000, 0);
+    SqlSingleFlight flight;
+    std::shared_ptr<const SqlRows> leader_rows;
+    std::thread leader([&]() {
+        leader_rows = flight.select_rows(&executor, "SELECT a FROM t");
+    });
+    while (flight.in_flight() == 0) {
+        usleep(100);
+    }
+    {
+        SqlDeadline deadline(10);
+        ASSERT_EQ(flight.select_rows(&executor, "SELECT a FROM t"), nullptr);
+    }
+    leader.join();
+    ASSERT_NE(leader_rows, nullptr);
+    ASSERT_EQ(executor.select_count(), 3u);
+}
+
+static SqlScopeState s_coroutine_scope;
+static bool s_in_coroutine = false;
+
+TEST_F(TestSqlPattern, test_sql_scope_provider) {
+    // scopes of a coroutine kept in its own storage, not in thread of the moment
+    SqlScope::set_provider([]() {
+        return s_in_coroutine ? &s_coroutine_scope : nullptr;
+    });
+    s_in_coroutine = true;
+    {
+        SqlDeadline deadline(1000);
+        ShardedExecutor::ShardKey key("7");
+        ReadWriteExecutor::ForcePrimary force;
+        ASSERT_NE(s_coroutine_scope.deadline_us, 0u);
+        ASSERT_EQ(*s_coroutine_scope.shard_key, "7");
+        ASSERT_EQ(s_coroutine_scope.force_primary, 1);
+
+        s_in_coroutine = false;
+        ASSERT_EQ(SqlDeadline::deadline_us(), 0u);
+        ASSERT_EQ(ShardedExecutor::ShardKey::current(), nullptr);
+        ASSERT_FALSE(ReadWriteExecutor::ForcePrimary::active());
+        s_in_coroutine = true;
+        ASSERT_EQ(SqlDeadline::deadline_us(), s_coroutine_scope.deadline_us);
+        ASSERT_TRUE(ReadWriteExecutor::ForcePrimary::active());
+    }
+    ASSERT_EQ(s_coroutine_scope.deadline_us, 0u);
+    ASSERT_EQ(s_coroutine_scope.shard_key, nullptr);
+    ASSERT_EQ(s_coroutine_scope.force_primary, 0);
+    s_in_coroutine = false;
+    SqlScope::set_provider(nullptr);
+}
+
 }
 }
 